@@ -32,15 +32,15 @@ int main(int argc, char** argv) {
         if (strcmp(buffer, "exit") == 0 || strcmp(buffer, "quit") == 0) break;
         if (strlen(buffer) == 0) continue;
 
-        CypherResult* res = execute_cypher(gdb, buffer);
+        CypherCursor* cursor = cypher_execute_cursor(gdb, buffer);
         if (json_output) {
-            char* json = cypher_result_to_d3_json(res);
+            char* json = cypher_cursor_to_d3_json(cursor);
             printf("%s\n", json);
             free_d3_json(json);
         } else {
-            print_cypher_result(res);
+            print_cypher_cursor(cursor);
         }
-        free_cypher_result(res);
+        cypher_cursor_close(cursor);
     }
 
     graphdb_close(gdb);
@@ -0,0 +1,804 @@
+// cypher_ast.c
+#include "cypher_ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+/*******************************
+ * Arena
+ *******************************/
+
+#define ARENA_ALIGN 16
+
+struct CypherArenaChunk {
+    struct CypherArenaChunk* next;
+    size_t used;
+    size_t size;
+    _Alignas(ARENA_ALIGN) char data[];
+};
+
+CypherArena* cypher_arena_create(size_t chunk_size) {
+    CypherArena* arena = (CypherArena*)calloc(1, sizeof(CypherArena));
+    arena->chunk_size = chunk_size > 0 ? chunk_size : 4096;
+    return arena;
+}
+
+static _Thread_local size_t arena_allocated;
+
+size_t cypher_arena_allocated(void) {
+    return arena_allocated;
+}
+
+void* cypher_arena_alloc(CypherArena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_allocated += size;
+    CypherArenaChunk* chunk = arena->chunks;
+    if (!chunk || chunk->used + size > chunk->size) {
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = (CypherArenaChunk*)malloc(sizeof(CypherArenaChunk) + chunk_size);
+        chunk->next = arena->chunks;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+    }
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+char* cypher_arena_strndup(CypherArena* arena, const char* s, size_t len) {
+    char* copy = (char*)cypher_arena_alloc(arena, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static void arena_free_chunks(CypherArena* arena) {
+    CypherArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        CypherArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
+
+static size_t arena_capacity(const CypherArena* arena) {
+    size_t total = 0;
+    for (CypherArenaChunk* chunk = arena->chunks; chunk; chunk = chunk->next) total += chunk->size;
+    return total;
+}
+
+void cypher_arena_reset(CypherArena* arena) {
+    if (!arena->chunks) return;
+    if (arena->chunks->next) {
+        size_t total = arena_capacity(arena);
+        arena_free_chunks(arena);
+        CypherArenaChunk* chunk = (CypherArenaChunk*)malloc(sizeof(CypherArenaChunk) + total);
+        chunk->next = NULL;
+        chunk->size = total;
+        arena->chunks = chunk;
+    }
+    arena->chunks->used = 0;
+}
+
+void cypher_arena_destroy(CypherArena* arena) {
+    if (!arena) return;
+    arena_free_chunks(arena);
+    free(arena);
+}
+
+// Reset arenas kept for reuse by the thread that released them
+#define ARENA_POOL_SIZE 8
+#define ARENA_POOL_CHUNK 16384
+#define ARENA_POOL_MAX_BYTES (1 << 20) // bigger arenas are freed, not kept
+
+typedef struct {
+    CypherArena* arenas[ARENA_POOL_SIZE];
+    int count;
+} ArenaPool;
+
+static pthread_key_t arena_pool_key;
+static pthread_once_t arena_pool_once = PTHREAD_ONCE_INIT;
+
+static void arena_pool_free(void* arg) {
+    ArenaPool* pool = (ArenaPool*)arg;
+    for (int i = 0; i < pool->count; i++) cypher_arena_destroy(pool->arenas[i]);
+    free(pool);
+}
+
+static void arena_pool_init(void) {
+    pthread_key_create(&arena_pool_key, arena_pool_free);
+}
+
+static ArenaPool* arena_pool(void) {
+    pthread_once(&arena_pool_once, arena_pool_init);
+    ArenaPool* pool = (ArenaPool*)pthread_getspecific(arena_pool_key);
+    if (!pool) {
+        pool = (ArenaPool*)calloc(1, sizeof(ArenaPool));
+        pthread_setspecific(arena_pool_key, pool);
+    }
+    return pool;
+}
+
+CypherArena* cypher_arena_acquire(void) {
+    ArenaPool* pool = arena_pool();
+    if (pool->count > 0) return pool->arenas[--pool->count];
+    return cypher_arena_create(ARENA_POOL_CHUNK);
+}
+
+void cypher_arena_release(CypherArena* arena) {
+    if (!arena) return;
+    ArenaPool* pool = arena_pool();
+    if (pool->count == ARENA_POOL_SIZE || arena_capacity(arena) > ARENA_POOL_MAX_BYTES) {
+        cypher_arena_destroy(arena);
+        return;
+    }
+    cypher_arena_reset(arena);
+    pool->arenas[pool->count++] = arena;
+}
+
+void* cypher_arena_grow(CypherArena* arena, void* items, int count, int* capacity, size_t elem_size) {
+    if (count < *capacity) return items;
+    int grown = *capacity ? *capacity * 2 : 4;
+    void* bigger = cypher_arena_alloc(arena, elem_size * grown);
+    if (count > 0) memcpy(bigger, items, elem_size * count);
+    *capacity = grown;
+    return bigger;
+}
+
+/*******************************
+ * Lexer
+ *******************************/
+
+typedef enum {
+    TOK_EOF,
+    TOK_IDENT,
+    TOK_STRING,
+    TOK_NUMBER,
+    TOK_LPAREN,
+    TOK_RPAREN,
+    TOK_LBRACKET,
+    TOK_RBRACKET,
+    TOK_LBRACE,
+    TOK_RBRACE,
+    TOK_COLON,
+    TOK_COMMA,
+    TOK_DOT,
+    TOK_DOTDOT,
+    TOK_EQ,
+    TOK_DASH,
+    TOK_LT,
+    TOK_GT,
+    TOK_STAR,
+    TOK_SEMICOLON,
+    TOK_PARAM,
+    TOK_ERROR
+} TokenType;
+
+typedef struct {
+    TokenType type;
+    const char* start; // for strings and quoted identifiers: the text inside the quotes
+    size_t len;
+    int offset;
+    int escaped;       // string contains backslash escapes
+} Token;
+
+typedef struct {
+    const char* src;
+    const char* pos;
+    CypherArena* arena;
+    Token tok;  // current token
+    Token next; // one token of lookahead
+    ParsedQuery* query;
+    int param_capacity;
+    CypherParseError* err;
+    int failed;
+} Parser;
+
+static void lex(Parser* p, Token* t) {
+    const char* s = p->pos;
+    for (;;) {
+        while (isspace((unsigned char)*s)) s++;
+        if (s[0] != '/' || s[1] != '/') break;
+        while (*s && *s != '\n') s++;
+    }
+    const char* end = s + 1;
+    t->start = s;
+    t->offset = (int)(s - p->src);
+    t->escaped = 0;
+    char c = *s;
+    if (c == '\0') {
+        t->type = TOK_EOF;
+        end = s;
+    } else if (isalpha((unsigned char)c) || c == '_') {
+        while (isalnum((unsigned char)*end) || *end == '_') end++;
+        t->type = TOK_IDENT;
+    } else if (isdigit((unsigned char)c)) {
+        while (isdigit((unsigned char)*end)) end++;
+        // "1..3" is a range, not a decimal
+        if (end[0] == '.' && isdigit((unsigned char)end[1])) {
+            end++;
+            while (isdigit((unsigned char)*end)) end++;
+        }
+        t->type = TOK_NUMBER;
+    } else if (c == '\'' || c == '"' || c == '`') {
+        while (*end && *end != c) {
+            if (*end == '\\' && end[1] && c != '`') {
+                t->escaped = 1;
+                end++;
+            }
+            end++;
+        }
+        if (*end != c) {
+            t->type = TOK_ERROR;
+        } else {
+            // Token text excludes the quotes; backticks quote identifiers
+            t->type = c == '`' ? TOK_IDENT : TOK_STRING;
+            t->start = s + 1;
+            t->len = end - s - 1;
+            p->pos = end + 1;
+            return;
+        }
+    } else if (c == '$' && (isalnum((unsigned char)s[1]) || s[1] == '_')) {
+        while (isalnum((unsigned char)*end) || *end == '_') end++;
+        t->type = TOK_PARAM;
+        t->start = s + 1;
+        t->len = end - s - 1;
+        p->pos = end;
+        return;
+    } else if (c == '.' && s[1] == '.') {
+        t->type = TOK_DOTDOT;
+        end = s + 2;
+    } else {
+        switch (c) {
+            case '(': t->type = TOK_LPAREN; break;
+            case ')': t->type = TOK_RPAREN; break;
+            case '[': t->type = TOK_LBRACKET; break;
+            case ']': t->type = TOK_RBRACKET; break;
+            case '{': t->type = TOK_LBRACE; break;
+            case '}': t->type = TOK_RBRACE; break;
+            case ':': t->type = TOK_COLON; break;
+            case ',': t->type = TOK_COMMA; break;
+            case '.': t->type = TOK_DOT; break;
+            case '=': t->type = TOK_EQ; break;
+            case '-': t->type = TOK_DASH; break;
+            case '<': t->type = TOK_LT; break;
+            case '>': t->type = TOK_GT; break;
+            case '*': t->type = TOK_STAR; break;
+            case ';': t->type = TOK_SEMICOLON; break;
+            default: t->type = TOK_ERROR; break;
+        }
+    }
+    t->len = end - s;
+    p->pos = end;
+}
+
+static void advance(Parser* p) {
+    p->tok = p->next;
+    lex(p, &p->next);
+}
+
+/*******************************
+ * Errors
+ *******************************/
+
+static void parse_error(Parser* p, const Token* t, const char* fmt, ...) {
+    if (p->failed) return;
+    p->failed = 1;
+    if (!p->err) return;
+    p->err->offset = t->offset;
+    p->err->line = 1;
+    p->err->column = 1;
+    for (int i = 0; i < t->offset; i++) {
+        if (p->src[i] == '\n') {
+            p->err->line++;
+            p->err->column = 1;
+        } else {
+            p->err->column++;
+        }
+    }
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(p->err->message, sizeof(p->err->message), fmt, args);
+    va_end(args);
+}
+
+// Short description of a token for messages: end of query, or its source text
+static const char* describe(const Token* t, char* buf, size_t size) {
+    if (t->type == TOK_EOF) return "end of query";
+    if (t->type == TOK_ERROR && (*t->start == '\'' || *t->start == '"' || *t->start == '`')) return "unterminated string";
+    // Strings and parameters point past their opening quote or '$'
+    const char* text = t->type == TOK_STRING || t->type == TOK_PARAM ? t->start - 1 : t->start;
+    size_t len = t->type == TOK_STRING ? t->len + 2 : t->type == TOK_PARAM ? t->len + 1 : t->len;
+    if (len > 24) len = 24;
+    snprintf(buf, size, "'%.*s'", (int)len, text);
+    return buf;
+}
+
+static void unexpected(Parser* p, const char* expected) {
+    char buf[32];
+    parse_error(p, &p->tok, "expected %s but found %s", expected, describe(&p->tok, buf, sizeof(buf)));
+}
+
+static int accept(Parser* p, TokenType type) {
+    if (p->tok.type != type) return 0;
+    advance(p);
+    return 1;
+}
+
+static int expect(Parser* p, TokenType type, const char* what) {
+    if (accept(p, type)) return 1;
+    unexpected(p, what);
+    return 0;
+}
+
+static int is_keyword(const Token* t, const char* keyword) {
+    return t->type == TOK_IDENT && t->len == strlen(keyword) && strncasecmp(t->start, keyword, t->len) == 0;
+}
+
+static int accept_keyword(Parser* p, const char* keyword) {
+    if (!is_keyword(&p->tok, keyword)) return 0;
+    advance(p);
+    return 1;
+}
+
+static int expect_keyword(Parser* p, const char* keyword) {
+    if (accept_keyword(p, keyword)) return 1;
+    unexpected(p, keyword);
+    return 0;
+}
+
+/*******************************
+ * Parser
+ *******************************/
+
+static char* token_text(Parser* p, const Token* t) {
+    if (!t->escaped) return cypher_arena_strndup(p->arena, t->start, t->len);
+    char* out = (char*)cypher_arena_alloc(p->arena, t->len + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < t->len; i++) {
+        char c = t->start[i];
+        if (c == '\\' && i + 1 < t->len) {
+            c = t->start[++i];
+            if (c == 'n') c = '\n';
+            else if (c == 't') c = '\t';
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static char* parse_ident(Parser* p, const char* what) {
+    if (p->tok.type != TOK_IDENT) {
+        unexpected(p, what);
+        return NULL;
+    }
+    char* text = token_text(p, &p->tok);
+    advance(p);
+    return text;
+}
+
+// 'string', "string", number (optionally negative), bare word such as true,
+// or $param. Parameters return NULL and set *param to their 1-based index.
+static char* parse_value(Parser* p, int* param) {
+    *param = 0;
+    if (p->tok.type == TOK_PARAM) {
+        ParsedQuery* pq = p->query;
+        for (int i = 0; i < pq->param_count && !*param; i++) {
+            if (strlen(pq->params[i]) == p->tok.len && strncmp(pq->params[i], p->tok.start, p->tok.len) == 0) *param = i + 1;
+        }
+        if (!*param) {
+            pq->params = (char**)cypher_arena_grow(p->arena, pq->params, pq->param_count, &p->param_capacity, sizeof(char*));
+            pq->params[pq->param_count++] = token_text(p, &p->tok);
+            *param = pq->param_count;
+        }
+        advance(p);
+        return NULL;
+    }
+    if (p->tok.type == TOK_DASH && p->next.type == TOK_NUMBER) {
+        char* text = (char*)cypher_arena_alloc(p->arena, p->next.len + 2);
+        text[0] = '-';
+        memcpy(text + 1, p->next.start, p->next.len);
+        advance(p);
+        advance(p);
+        return text;
+    }
+    if (p->tok.type != TOK_STRING && p->tok.type != TOK_NUMBER && p->tok.type != TOK_IDENT) {
+        unexpected(p, "a value");
+        return NULL;
+    }
+    char* text = token_text(p, &p->tok);
+    advance(p);
+    return text;
+}
+
+static int parse_int(Parser* p, int* out) {
+    if (p->tok.type != TOK_NUMBER || memchr(p->tok.start, '.', p->tok.len)) {
+        unexpected(p, "an integer");
+        return 0;
+    }
+    *out = atoi(p->tok.start);
+    advance(p);
+    return 1;
+}
+
+// SKIP / LIMIT argument: a non-negative integer or $param
+static void parse_count(Parser* p, int* out, int* param) {
+    if (p->tok.type == TOK_PARAM) {
+        parse_value(p, param);
+        return;
+    }
+    parse_int(p, out);
+}
+
+// (var:Label {key: 'value'})
+static void parse_node(Parser* p, NodePattern* np) {
+    if (!expect(p, TOK_LPAREN, "'('")) return;
+    if (p->tok.type == TOK_IDENT) np->var = parse_ident(p, "a variable");
+    if (accept(p, TOK_COLON)) np->label = parse_ident(p, "a label");
+    if (!p->failed && accept(p, TOK_LBRACE)) {
+        np->prop_key = parse_ident(p, "a property name");
+        if (!p->failed && expect(p, TOK_COLON, "':'")) np->prop_value = parse_value(p, &np->prop_param);
+        if (!p->failed && p->tok.type == TOK_COMMA) {
+            parse_error(p, &p->tok, "only one property per node pattern is supported");
+            return;
+        }
+        if (!p->failed) expect(p, TOK_RBRACE, "'}'");
+    }
+    if (!p->failed) expect(p, TOK_RPAREN, "')'");
+}
+
+// -[var:TYPE*min..max]->, <-[...]-, -[...]-, or the bare forms -->, <--, --
+static void parse_rel(Parser* p, RelPattern* rp) {
+    int left = accept(p, TOK_LT);
+    if (!expect(p, TOK_DASH, "'-'")) return;
+    rp->min_hops = 1;
+    rp->max_hops = 1;
+    if (accept(p, TOK_LBRACKET)) {
+        if (p->tok.type == TOK_IDENT) rp->var = parse_ident(p, "a variable");
+        // An empty type after ':' matches any type
+        if (accept(p, TOK_COLON) && p->tok.type == TOK_IDENT) rp->type = parse_ident(p, "a relationship type");
+        if (accept(p, TOK_STAR)) {
+            int has_min = p->tok.type == TOK_NUMBER;
+            if (has_min && !parse_int(p, &rp->min_hops)) return;
+            if (accept(p, TOK_DOTDOT)) {
+                rp->max_hops = -1;
+                if (p->tok.type == TOK_NUMBER && !parse_int(p, &rp->max_hops)) return;
+            } else {
+                rp->max_hops = has_min ? rp->min_hops : -1;
+            }
+            if (rp->max_hops != -1 && rp->max_hops < rp->min_hops) {
+                parse_error(p, &p->tok, "relationship length %d..%d is empty", rp->min_hops, rp->max_hops);
+                return;
+            }
+        }
+        if (!expect(p, TOK_RBRACKET, "']'")) return;
+    }
+    if (!expect(p, TOK_DASH, "'-'")) return;
+    if (p->tok.type == TOK_GT) {
+        if (left) {
+            parse_error(p, &p->tok, "a relationship cannot point both ways");
+            return;
+        }
+        advance(p);
+        rp->direction = '>';
+    } else {
+        rp->direction = left ? '<' : 0;
+    }
+}
+
+// [path =] (node) (-[rel]- (node))*
+static PathPattern* parse_pattern(Parser* p) {
+    PathPattern* path = (PathPattern*)cypher_arena_alloc(p->arena, sizeof(PathPattern));
+    if (p->tok.type == TOK_IDENT && p->next.type == TOK_EQ) {
+        path->path_var = parse_ident(p, "a path variable");
+        advance(p);
+    }
+    int node_cap = 0, rel_cap = 0;
+    path->nodes = (NodePattern*)cypher_arena_grow(p->arena, NULL, 0, &node_cap, sizeof(NodePattern));
+    parse_node(p, &path->nodes[0]);
+    path->count = 1;
+    while (!p->failed && (p->tok.type == TOK_DASH || p->tok.type == TOK_LT)) {
+        path->rels = (RelPattern*)cypher_arena_grow(p->arena, path->rels, path->count - 1, &rel_cap, sizeof(RelPattern));
+        parse_rel(p, &path->rels[path->count - 1]);
+        if (p->failed) break;
+        path->nodes = (NodePattern*)cypher_arena_grow(p->arena, path->nodes, path->count, &node_cap, sizeof(NodePattern));
+        parse_node(p, &path->nodes[path->count]);
+        path->count++;
+    }
+    return p->failed ? NULL : path;
+}
+
+static int pattern_repeats_node(const PathPattern* path) {
+    for (int h = 0; h < path->count; h++) {
+        for (int k = h + 1; k < path->count; k++) {
+            const char* a = path->nodes[h].var;
+            if (a && path->nodes[k].var && strcmp(a, path->nodes[k].var) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+// pattern (, pattern)*, the parts chained by placeholder relationships.
+// Parts are joined on their shared variables, so they take neither a path
+// variable nor variable-length relationships; neither does a single pattern
+// that names a node variable twice.
+static PathPattern* parse_match(Parser* p) {
+    const Token start = p->tok;
+    PathPattern* path = parse_pattern(p);
+    if (!path) return NULL;
+    if (p->tok.type != TOK_COMMA) {
+        if (!pattern_repeats_node(path)) return path;
+        for (int r = 0; r < path->count - 1; r++) {
+            if (path->rels[r].min_hops != 1 || path->rels[r].max_hops != 1) {
+                parse_error(p, &start, "variable-length relationships are not supported in a pattern that repeats a variable");
+                return NULL;
+            }
+        }
+        return path;
+    }
+    const Token first = p->tok;
+    PathPattern** parts = NULL;
+    int part_count = 0, capacity = 0;
+    parts = (PathPattern**)cypher_arena_grow(p->arena, parts, part_count, &capacity, sizeof(PathPattern*));
+    parts[part_count++] = path;
+    int total = path->count;
+    while (accept(p, TOK_COMMA)) {
+        const Token start = p->tok;
+        PathPattern* part = parse_pattern(p);
+        if (!part) return NULL;
+        if (part->path_var || path->path_var) {
+            parse_error(p, part->path_var ? &start : &first, "a path variable cannot name a multi-part pattern");
+            return NULL;
+        }
+        parts = (PathPattern**)cypher_arena_grow(p->arena, parts, part_count, &capacity, sizeof(PathPattern*));
+        parts[part_count++] = part;
+        total += part->count;
+    }
+    PathPattern* joined = (PathPattern*)cypher_arena_alloc(p->arena, sizeof(PathPattern));
+    joined->nodes = (NodePattern*)cypher_arena_alloc(p->arena, total * sizeof(NodePattern));
+    joined->rels = (RelPattern*)cypher_arena_alloc(p->arena, (total - 1) * sizeof(RelPattern));
+    for (int i = 0; i < part_count; i++) {
+        const PathPattern* part = parts[i];
+        for (int r = 0; r < part->count - 1; r++) {
+            if (part->rels[r].min_hops != 1 || part->rels[r].max_hops != 1) {
+                parse_error(p, &first, "variable-length relationships are not supported in multi-part patterns");
+                return NULL;
+            }
+        }
+        if (i > 0) {
+            RelPattern* joint = &joined->rels[joined->count - 1];
+            joint->direction = ',';
+        }
+        memcpy(joined->nodes + joined->count, part->nodes, part->count * sizeof(NodePattern));
+        if (part->count > 1) memcpy(joined->rels + joined->count, part->rels, (part->count - 1) * sizeof(RelPattern));
+        joined->count += part->count;
+    }
+    return joined;
+}
+
+// var.prop = literal (AND var.prop = literal)*
+static void parse_where(Parser* p, ParsedQuery* pq) {
+    int capacity = 0;
+    do {
+        pq->conditions = (WhereCondition*)cypher_arena_grow(p->arena, pq->conditions, pq->cond_count, &capacity, sizeof(WhereCondition));
+        WhereCondition* wc = &pq->conditions[pq->cond_count];
+        wc->var = parse_ident(p, "a variable");
+        if (p->failed || !expect(p, TOK_DOT, "'.'")) return;
+        wc->prop = parse_ident(p, "a property name");
+        if (p->failed) return;
+        if (p->tok.type != TOK_EQ) {
+            unexpected(p, "'=' (only equality is supported)");
+            return;
+        }
+        advance(p);
+        wc->val = parse_value(p, &wc->param);
+        if (p->failed) return;
+        pq->cond_count++;
+    } while (accept_keyword(p, "AND"));
+}
+
+// var or var.prop, comma separated
+static char** parse_items(Parser* p, int* count) {
+    char** items = NULL;
+    int capacity = 0;
+    *count = 0;
+    do {
+        char* var = parse_ident(p, "a variable");
+        if (p->failed) return NULL;
+        char* item = var;
+        if (accept(p, TOK_DOT)) {
+            if (p->tok.type != TOK_IDENT) {
+                unexpected(p, "a property name");
+                return NULL;
+            }
+            item = (char*)cypher_arena_alloc(p->arena, strlen(var) + p->tok.len + 2);
+            sprintf(item, "%s.%.*s", var, (int)p->tok.len, p->tok.start);
+            advance(p);
+        }
+        items = (char**)cypher_arena_grow(p->arena, items, *count, &capacity, sizeof(char*));
+        items[(*count)++] = item;
+    } while (accept(p, TOK_COMMA));
+    return items;
+}
+
+static const char* const aggregate_names[] = {NULL, "count", "min", "max", "sum", "collect"};
+
+// var[.prop] or agg([DISTINCT] var[.prop]) / count(*). Returns the item's
+// column name, or NULL on a syntax error.
+static char* parse_return_item(Parser* p, ReturnItem* item) {
+    memset(item, 0, sizeof(ReturnItem));
+    for (int a = AGG_COUNT; a <= AGG_COLLECT; a++) {
+        if (p->next.type == TOK_LPAREN && is_keyword(&p->tok, aggregate_names[a])) item->agg = (AggregateKind)a;
+    }
+    if (item->agg != AGG_NONE) {
+        advance(p);
+        advance(p);
+        item->distinct = accept_keyword(p, "DISTINCT");
+    }
+    int count_all = item->agg == AGG_COUNT && !item->distinct && accept(p, TOK_STAR);
+    if (!count_all) {
+        item->var = parse_ident(p, "a variable");
+        if (p->failed) return NULL;
+        if (accept(p, TOK_DOT)) item->prop = parse_ident(p, "a property name");
+    }
+    if (item->agg != AGG_NONE && !expect(p, TOK_RPAREN, "')'")) return NULL;
+    if (p->failed) return NULL;
+
+    const char* target = item->var ? item->var : "*";
+    size_t len = strlen(target) + (item->prop ? strlen(item->prop) + 1 : 0) + 20;
+    char* name = (char*)cypher_arena_alloc(p->arena, len);
+    if (item->agg == AGG_NONE) {
+        snprintf(name, len, "%s%s%s", target, item->prop ? "." : "", item->prop ? item->prop : "");
+    } else {
+        snprintf(name, len, "%s(%s%s%s%s)", aggregate_names[item->agg], item->distinct ? "DISTINCT " : "",
+                 target, item->prop ? "." : "", item->prop ? item->prop : "");
+    }
+    return name;
+}
+
+// RETURN items, comma separated
+static void parse_return_items(Parser* p, ParsedQuery* pq) {
+    int capacity = 0, item_capacity = 0;
+    do {
+        ReturnItem item;
+        char* name = parse_return_item(p, &item);
+        if (!name) return;
+        if (item.agg != AGG_NONE) pq->aggregate_count++;
+        pq->returns = (char**)cypher_arena_grow(p->arena, pq->returns, pq->return_count, &capacity, sizeof(char*));
+        pq->return_items = (ReturnItem*)cypher_arena_grow(p->arena, pq->return_items, pq->return_count, &item_capacity, sizeof(ReturnItem));
+        pq->returns[pq->return_count] = name;
+        pq->return_items[pq->return_count++] = item;
+    } while (accept(p, TOK_COMMA));
+}
+
+// item [ASC | DESC], comma separated. Aggregates, and every item of an
+// aggregating or DISTINCT RETURN, must name one of its columns.
+static void parse_order_by(Parser* p, ParsedQuery* pq) {
+    int capacity = 0;
+    do {
+        const Token start = p->tok;
+        ReturnItem item;
+        char* name = parse_return_item(p, &item);
+        if (!name) return;
+        OrderItem order = {item.var, item.prop, -1, 0};
+        for (int i = 0; i < pq->return_count && order.column < 0; i++) {
+            if (strcmp(pq->returns[i], name) == 0) order.column = i;
+        }
+        if (order.column < 0 && (item.agg != AGG_NONE || pq->aggregate_count > 0 || pq->distinct)) {
+            parse_error(p, &start, "ORDER BY %s is not a RETURN column", name);
+            return;
+        }
+        if (accept_keyword(p, "DESC") || accept_keyword(p, "DESCENDING")) order.descending = 1;
+        else if (!accept_keyword(p, "ASC")) accept_keyword(p, "ASCENDING");
+        pq->order_by = (OrderItem*)cypher_arena_grow(p->arena, pq->order_by, pq->order_count, &capacity, sizeof(OrderItem));
+        pq->order_by[pq->order_count++] = order;
+    } while (accept(p, TOK_COMMA));
+}
+
+// proc.name(arg, 'arg', ...)
+static void parse_call(Parser* p, ParsedQuery* pq) {
+    const Token first = p->tok;
+    if (!parse_ident(p, "a procedure name")) return;
+    size_t len = first.len;
+    while (p->tok.type == TOK_DOT && p->next.type == TOK_IDENT) {
+        advance(p);
+        len = p->tok.start + p->tok.len - first.start;
+        advance(p);
+    }
+    pq->call_proc = cypher_arena_strndup(p->arena, first.start, len);
+    if (!accept(p, TOK_LPAREN)) return;
+    int capacity = 0, param_capacity = 0;
+    if (accept(p, TOK_RPAREN)) return;
+    do {
+        int param;
+        char* arg = parse_value(p, &param);
+        if (p->failed) return;
+        pq->call_args = (char**)cypher_arena_grow(p->arena, pq->call_args, pq->call_arg_count, &capacity, sizeof(char*));
+        pq->call_arg_params = (int*)cypher_arena_grow(p->arena, pq->call_arg_params, pq->call_arg_count, &param_capacity, sizeof(int));
+        pq->call_args[pq->call_arg_count] = arg;
+        pq->call_arg_params[pq->call_arg_count++] = param;
+    } while (accept(p, TOK_COMMA));
+    expect(p, TOK_RPAREN, "')'");
+}
+
+static void parse_query(Parser* p, ParsedQuery* pq) {
+    if (accept_keyword(p, "EXPLAIN")) pq->explain = EXPLAIN_PLAN;
+    else if (accept_keyword(p, "PROFILE")) pq->explain = EXPLAIN_PROFILE;
+    if (accept_keyword(p, "CALL")) {
+        pq->type = Q_CALL;
+        parse_call(p, pq);
+    } else if (accept_keyword(p, "CREATE")) {
+        pq->type = Q_CREATE;
+        pq->match = parse_pattern(p);
+    } else if (accept_keyword(p, "MATCH")) {
+        pq->match = parse_match(p);
+        if (!p->failed && accept_keyword(p, "WHERE")) parse_where(p, pq);
+        if (p->failed) return;
+        if (accept_keyword(p, "RETURN")) {
+            pq->type = Q_MATCH_RETURN;
+            pq->distinct = accept_keyword(p, "DISTINCT");
+            parse_return_items(p, pq);
+            if (!p->failed && accept_keyword(p, "ORDER")) {
+                if (expect_keyword(p, "BY")) parse_order_by(p, pq);
+            }
+            if (!p->failed && accept_keyword(p, "SKIP")) parse_count(p, &pq->skip, &pq->skip_param);
+            if (!p->failed && accept_keyword(p, "LIMIT")) parse_count(p, &pq->limit, &pq->limit_param);
+        } else if (accept_keyword(p, "DELETE")) {
+            pq->type = Q_DELETE;
+            pq->deletes = parse_items(p, &pq->delete_count);
+        } else {
+            unexpected(p, pq->cond_count > 0 ? "AND, RETURN or DELETE" : "WHERE, RETURN or DELETE");
+        }
+    } else {
+        unexpected(p, "MATCH, CREATE or CALL");
+    }
+    if (p->failed) return;
+    accept(p, TOK_SEMICOLON);
+    if (p->tok.type != TOK_EOF) unexpected(p, "end of query");
+}
+
+ParsedQuery* cypher_parse(CypherArena* arena, const char* query, CypherParseError* err) {
+    Parser p = {0};
+    p.src = query;
+    p.pos = query;
+    p.arena = arena;
+    p.err = err;
+    if (err) memset(err, 0, sizeof(CypherParseError));
+    lex(&p, &p.next);
+    advance(&p);
+    ParsedQuery* pq = (ParsedQuery*)cypher_arena_alloc(arena, sizeof(ParsedQuery));
+    pq->limit = -1;
+    p.query = pq;
+    parse_query(&p, pq);
+    return p.failed ? NULL : pq;
+}
+
+char* cypher_normalize(const char* query) {
+    size_t len = strlen(query);
+    // Worst case: a separator after every character
+    char* out = (char*)malloc(len * 2 + 1);
+    size_t n = 0;
+    Parser p = {0};
+    p.src = query;
+    p.pos = query;
+    Token t;
+    for (lex(&p, &t); t.type != TOK_EOF; lex(&p, &t)) {
+        if (n > 0) out[n++] = ' ';
+        // Raw source of the token, quotes and '$' included
+        const char* raw = query + t.offset;
+        size_t raw_len = t.type == TOK_ERROR ? len - t.offset : (size_t)(p.pos - raw);
+        memcpy(out + n, raw, raw_len);
+        n += raw_len;
+        if (t.type == TOK_ERROR) break;
+    }
+    out[n] = '\0';
+    return out;
+}
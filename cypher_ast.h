@@ -0,0 +1,136 @@
+#ifndef CYPHER_AST_H
+#define CYPHER_AST_H
+
+#include <stddef.h>
+
+// Bump allocator that owns every string and node of a parsed query; the whole
+// tree is released at once with cypher_arena_destroy
+typedef struct CypherArenaChunk CypherArenaChunk;
+
+typedef struct {
+    CypherArenaChunk* chunks;
+    size_t chunk_size;
+} CypherArena;
+
+CypherArena* cypher_arena_create(size_t chunk_size);
+void* cypher_arena_alloc(CypherArena* arena, size_t size); // zeroed
+char* cypher_arena_strndup(CypherArena* arena, const char* s, size_t len);
+// Doubles an arena array when full; the old copy stays in the arena until it is destroyed
+void* cypher_arena_grow(CypherArena* arena, void* items, int count, int* capacity, size_t elem_size);
+// Empties the arena but keeps its memory, merged into one chunk, so a
+// workload that fit once is served without further mallocs
+void cypher_arena_reset(CypherArena* arena);
+void cypher_arena_destroy(CypherArena* arena);
+// Bytes handed out by cypher_arena_alloc on the calling thread so far
+size_t cypher_arena_allocated(void);
+
+// Per-thread pool of reset arenas for per-query allocations. Acquire reuses
+// one released earlier on the same thread; release resets it and keeps it
+// for the next query (or destroys it when the pool is full or it grew large).
+CypherArena* cypher_arena_acquire(void);
+void cypher_arena_release(CypherArena* arena);
+
+typedef struct {
+    char* var;
+    char* label;
+    char* prop_key;
+    char* prop_value;
+    int prop_param;  // 1-based index into ParsedQuery.params, 0 for a literal
+} NodePattern;
+
+typedef struct {
+    char* var;
+    char* type;
+    char direction;  // '>' outgoing, '<' incoming, 0 either way, ',' joins two MATCH parts
+    int min_hops;
+    int max_hops;    // -1 when unbounded
+} RelPattern;
+
+// nodes[0] -rels[0]- nodes[1] ... -rels[count - 2]- nodes[count - 1]. The
+// comma-separated parts of a MATCH are chained into one path through
+// placeholder relationships (direction ',', 0 hops) that bind nothing; a
+// variable named in several places binds the same node.
+typedef struct {
+    NodePattern* nodes;
+    RelPattern* rels;
+    int count;
+    char* path_var;
+} PathPattern;
+
+typedef enum { Q_CREATE, Q_DELETE, Q_MATCH_RETURN, Q_CALL } QueryType;
+
+// EXPLAIN lists the operators of the plan without running it; PROFILE runs
+// the query, discards its rows and reports what each operator did
+typedef enum { EXPLAIN_NONE, EXPLAIN_PLAN, EXPLAIN_PROFILE } ExplainMode;
+
+// var.prop = 'val' (or $param)
+typedef struct {
+    char* var;
+    char* prop;
+    char* val;
+    int param;       // as NodePattern.prop_param
+} WhereCondition;
+
+typedef enum { AGG_NONE, AGG_COUNT, AGG_MIN, AGG_MAX, AGG_SUM, AGG_COLLECT } AggregateKind;
+
+// RETURN item: var or var.prop, possibly inside an aggregate function
+typedef struct {
+    char* var;       // NULL for count(*)
+    char* prop;      // NULL for the node or relationship itself
+    AggregateKind agg;
+    int distinct;    // count(DISTINCT x), ...
+} ReturnItem;
+
+// ORDER BY item: var, var.prop or an aggregate written as in RETURN
+typedef struct {
+    char* var;       // NULL for count(*)
+    char* prop;
+    int column;      // RETURN column with the same text, or -1
+    int descending;
+} OrderItem;
+
+typedef struct {
+    QueryType type;
+    ExplainMode explain;
+    PathPattern* match;
+    WhereCondition* conditions;
+    int cond_count;
+    char** returns;  // "b", "b.id" or "count(DISTINCT b)", as column names
+    ReturnItem* return_items;
+    int return_count;
+    int aggregate_count; // aggregate items; the others are grouping keys
+    int distinct;     // RETURN DISTINCT
+    OrderItem* order_by;
+    int order_count;  // 0 when rows come in match order
+    char** deletes;
+    int delete_count;
+    char* call_proc;
+    char** call_args; // literals as text, quotes stripped
+    int* call_arg_params; // per argument, as NodePattern.prop_param
+    int call_arg_count;
+    int skip;         // SKIP, 0 when absent
+    int limit;        // LIMIT, -1 when absent
+    int skip_param;   // as NodePattern.prop_param
+    int limit_param;
+    char** params;    // distinct $names (without '$') in order of appearance
+    int param_count;
+} ParsedQuery;
+
+typedef struct {
+    int offset;  // byte offset of the offending token
+    int line;    // 1-based
+    int column;  // 1-based
+    char message[128];
+} CypherParseError;
+
+// Single-pass tokenizer plus recursive-descent parser. Keywords are matched
+// case-insensitively and only as whole tokens, so quoted values never change
+// the shape of the query. Returns NULL and fills `err` (when given) on a
+// syntax error; everything returned lives in `arena`.
+ParsedQuery* cypher_parse(CypherArena* arena, const char* query, CypherParseError* err);
+
+// The query's tokens joined by single spaces, so queries that differ only in
+// whitespace or comments share a plan cache key. Returns a malloc'ed string.
+char* cypher_normalize(const char* query);
+
+#endif
@@ -2,6 +2,10 @@
 // cypher_parser.c
 #include "graphdb.h"
 #include "cypher_parser.h"
+#include "cypher_ast.h"
+#include "strmap.h"
+#include "graph_algo.h"
+#include "reach_index.h"
 #include <rocksdb/c.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,6 +14,9 @@
 #include <ctype.h>
 #include <stdbool.h> // Added for bool type
 #include <limits.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <time.h>
 
 // Assume graphdb.h is included which declares GraphDB and functions like graphdb_get_outgoing, etc.
 // For example:
@@ -21,96 +28,174 @@
 
 // Legacy tabular result support removed – we now operate with structured results only.
 
-// Extended parser structures
+/*******************************
+ * Interned ids
+ *******************************/
+
+// Per-query dictionaries: node ids, relationship types and labels are interned
+// once so traversal state holds ints, and the interned strings stay put until
+// the dictionary is destroyed. A node entry's value caches its label: 0 not
+// read yet, -1 no such node, else label index + 1.
 typedef struct {
-    char* var;
-    char* label;
-    char* prop_key;
-    char* prop_value;
-} NodePattern;
-
-// Add simple Queue for BFS
-typedef struct PathQueueNode {
-    char** path_ids;
-    int path_len;
-    int current_hop;
-    char** rel_types;
-    int rel_count;
-    struct PathQueueNode* next;
-} PathQueueNode;
+    GraphDB* gdb;
+    StrMap* ids;
+    StrMap* types;
+    StrMap* labels;
+    int* stamps;       // per node id, last undirected listing that saw it as an outgoing neighbor
+    int stamp_capacity;
+    int stamp;
+} IdDict;
 
 typedef struct {
-    PathQueueNode* front;
-    PathQueueNode* rear;
-} PathQueue;
-
-static PathQueue* path_queue_create() {
-    PathQueue* q = malloc(sizeof(PathQueue));
-    q->front = q->rear = NULL;
-    return q;
-}
-
-static void path_queue_enqueue(PathQueue* q, char** path_ids, int path_len, int current_hop, char** rel_types, int rel_count) {
-    PathQueueNode* new_node = malloc(sizeof(PathQueueNode));
-    new_node->path_ids = malloc(path_len * sizeof(char*));
-    for (int i = 0; i < path_len; i++) new_node->path_ids[i] = strdup(path_ids[i]);
-    new_node->path_len = path_len;
-    new_node->current_hop = current_hop;
-    new_node->rel_types = malloc(rel_count * sizeof(char*));
-    for (int i = 0; i < rel_count; i++) new_node->rel_types[i] = strdup(rel_types[i]);
-    new_node->rel_count = rel_count;
-    new_node->next = NULL;
-    if (q->rear == NULL) {
-        q->front = q->rear = new_node;
-    } else {
-        q->rear->next = new_node;
-        q->rear = new_node;
-    }
-}
-
-static bool path_queue_dequeue(PathQueue* q, char*** path_ids, int* path_len, int* current_hop, char*** rel_types, int* rel_count) {
-    if (q->front == NULL) return false;
-    PathQueueNode* temp = q->front;
-    *path_ids = temp->path_ids;
-    *path_len = temp->path_len;
-    *current_hop = temp->current_hop;
-    *rel_types = temp->rel_types;
-    *rel_count = temp->rel_count;
-    q->front = q->front->next;
-    if (q->front == NULL) q->rear = NULL;
-    free(temp);
-    return true;
+    int* ids;
+    int* types;
+    int count;
+    int capacity;
+    GraphDirection dir;
+    bool marking;
+} NeighborBuffer;
+
+static void id_dict_init(IdDict* d, GraphDB* gdb) {
+    d->gdb = gdb;
+    d->ids = strmap_create(1024);
+    d->types = strmap_create(16);
+    d->labels = strmap_create(16);
+}
+
+static void id_dict_free(IdDict* d) {
+    if (!d->ids) return;
+    strmap_destroy(d->ids);
+    strmap_destroy(d->types);
+    strmap_destroy(d->labels);
+    free(d->stamps);
+}
+
+static int id_dict_intern(StrMap* map, const char* s) {
+    return strmap_intern(map, s, strlen(s), NULL);
+}
+
+static const char* id_dict_key(const StrMap* map, int id) {
+    return map->entries[id].key;
+}
+
+static int id_dict_label(IdDict* d, int node) {
+    StrMapEntry* e = &d->ids->entries[node];
+    if (e->value == 0) {
+        char* label = graphdb_get_node_label(d->gdb, e->key);
+        e->value = label ? id_dict_intern(d->labels, label) + 1 : -1;
+        free(label);
+    }
+    return (int)e->value;
+}
+
+static int collect_neighbor(void* arg, const char* id, size_t id_len, const char* type, size_t type_len) {
+    IdDict* d = ((void**)arg)[0];
+    NeighborBuffer* buf = ((void**)arg)[1];
+    int node = strmap_intern(d->ids, id, id_len, NULL);
+    if (node >= d->stamp_capacity) {
+        int capacity = d->stamp_capacity ? d->stamp_capacity : 256;
+        while (capacity <= node) capacity *= 2;
+        d->stamps = realloc(d->stamps, capacity * sizeof(int));
+        memset(d->stamps + d->stamp_capacity, 0, (capacity - d->stamp_capacity) * sizeof(int));
+        d->stamp_capacity = capacity;
+    }
+    // An undirected hop lists a node reached both ways once, through its outgoing edge
+    if (buf->dir == GRAPHDB_DIR_BOTH) {
+        if (buf->marking) d->stamps[node] = d->stamp;
+        else if (d->stamps[node] == d->stamp) return 0;
+    }
+    if (buf->count >= buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 64;
+        buf->ids = realloc(buf->ids, buf->capacity * sizeof(int));
+        buf->types = realloc(buf->types, buf->capacity * sizeof(int));
+    }
+    buf->ids[buf->count] = node;
+    buf->types[buf->count++] = strmap_intern(d->types, type, type_len, NULL);
+    return 0;
 }
 
-static void path_queue_destroy(PathQueue* q) {
-    char** dummy = NULL;
-    int d1 = 0, d2 = 0;
-    char** dummy_rel = NULL;
-    int d3 = 0;
-    while (path_queue_dequeue(q, &dummy, &d1, &d2, &dummy_rel, &d3)) {
-        for (int i = 0; i < d1; i++) free(dummy[i]);
-        free(dummy);
-        for (int i = 0; i < d3; i++) free(dummy_rel[i]);
-        free(dummy_rel);
+// Replaces `buf` with the neighbors of `node` over `type` ("" for any) in `dir`
+static void id_dict_neighbors(IdDict* d, int node, const char* type, GraphDirection dir, NeighborBuffer* buf) {
+    const char* id = id_dict_key(d->ids, node);
+    void* arg[2] = {d, buf};
+    buf->count = 0;
+    buf->dir = dir;
+    if (dir != GRAPHDB_DIR_BOTH) {
+        graphdb_foreach_neighbor(d->gdb, id, type, dir, collect_neighbor, arg);
+        return;
     }
-    free(q);
+    d->stamp++;
+    buf->marking = true;
+    graphdb_foreach_neighbor(d->gdb, id, type, GRAPHDB_DIR_OUT, collect_neighbor, arg);
+    buf->marking = false;
+    graphdb_foreach_neighbor(d->gdb, id, type, GRAPHDB_DIR_IN, collect_neighbor, arg);
+}
+
+static void neighbor_buffer_free(NeighborBuffer* buf) {
+    free(buf->ids);
+    free(buf->types);
+}
+
+// Direction to scan when walking `rp` from its left node, or from its right
+// node when `reverse` is set
+static GraphDirection rel_walk_direction(const RelPattern* rp, int reverse) {
+    if (rp->direction == '>') return reverse ? GRAPHDB_DIR_IN : GRAPHDB_DIR_OUT;
+    if (rp->direction == '<') return reverse ? GRAPHDB_DIR_OUT : GRAPHDB_DIR_IN;
+    return GRAPHDB_DIR_BOTH;
 }
 
-// Update structs
+/*******************************
+ * Path trees
+ *******************************/
+
+// Breadth-first expansion of a variable-length hop. Every path is one step
+// pointing at the step it extends, so a hop adds a fixed-size record instead
+// of a copy of its prefix. `mask` is a 64-bit Bloom filter over the nodes on
+// the path; the parent chain is only walked when it reports a possible cycle.
 typedef struct {
-    char* var;
-    char* type;
-    char direction;
-    int min_hops;
-    int max_hops;
-} RelPattern;
+    int parent;        // -1 at the first node of the walked path
+    int node;          // interned id
+    int type;          // interned type of the relationship into `node`
+    int hops;          // hops taken by the variable-length relationship
+    unsigned long long mask;
+} PathStep;
 
 typedef struct {
-    NodePattern* nodes;
-    RelPattern* rels;
+    PathStep* steps;   // in breadth-first order
     int count;
-    char* path_var;
-} PathPattern;
+    int capacity;
+    int next;          // steps[next, count) are still to be visited
+} PathTree;
+
+static unsigned long long path_step_bit(int node) {
+    return 1ULL << ((unsigned)node * 0x9E3779B9u >> 26);
+}
+
+static void path_tree_add(PathTree* t, int parent, int node, int type, int hops) {
+    if (t->count >= t->capacity) {
+        t->capacity = t->capacity ? t->capacity * 2 : 64;
+        t->steps = realloc(t->steps, t->capacity * sizeof(PathStep));
+    }
+    PathStep* s = &t->steps[t->count++];
+    s->parent = parent;
+    s->node = node;
+    s->type = type;
+    s->hops = hops;
+    s->mask = (parent >= 0 ? t->steps[parent].mask : 0) | path_step_bit(node);
+}
+
+static bool path_tree_contains(const PathTree* t, int step, int node) {
+    if (!(t->steps[step].mask & path_step_bit(node))) return false;
+    for (int s = step; s >= 0; s = t->steps[s].parent) {
+        if (t->steps[s].node == node) return true;
+    }
+    return false;
+}
+
+static void path_tree_free(PathTree* t) {
+    free(t->steps);
+    memset(t, 0, sizeof(PathTree));
+}
 
 // MatchingPath with num_nodes
 typedef struct {
@@ -121,956 +206,4190 @@ typedef struct {
     int num_rels;
 } MatchingPath;
 
-// Extended parser structures
-typedef enum { Q_CREATE, Q_DELETE, Q_MATCH_RETURN } QueryType;
-
-// Move WhereCondition before ParsedQuery
+// WHERE conjuncts attached to the pattern position they reference, checked as
+// soon as that node or relationship is bound during the traversal
 typedef struct {
-    char* var;
-    char* prop;
-    char* val;
-} WhereCondition;
+    const WhereCondition** conds; // cheapest first: id, label, then stored properties
+    int count;
+} PositionFilter;
 
 typedef struct {
-    QueryType type;
-    PathPattern* match;
-    WhereCondition* conditions;
-    int cond_count;
-    char** returns;
-    int return_count;
-    char** deletes;
-    int delete_count;
-} ParsedQuery;
-
-// Helper to skip whitespace
-static const char* skip_ws(const char* str) {
-    while (isspace(*str)) str++;
-    return str;
-}
-
-// Helper to trim string
-static char* trim(const char* str) {
-    str = skip_ws(str);
-    const char* end = str + strlen(str) - 1;
-    while (end > str && isspace(*end)) end--;
-    return strndup(str, end - str + 1);
-}
-
-// Parse a node pattern like (a:Label {id:'val'})
-static NodePattern* parse_node(const char** pattern) {
-    *pattern = skip_ws(*pattern);
-    if (**pattern != '(') return NULL;
-    (*pattern)++;
-    *pattern = skip_ws(*pattern);
-    NodePattern* np = (NodePattern*)calloc(1, sizeof(NodePattern));
-    // Variable
-    const char* start = *pattern;
-    while (**pattern && **pattern != ':' && **pattern != '{' && **pattern != ')' && !isspace(**pattern)) (*pattern)++;
-    if (*pattern > start) np->var = strndup(start, *pattern - start);
-    *pattern = skip_ws(*pattern);
-    // Label
-    if (**pattern == ':') {
-        (*pattern)++;
-        *pattern = skip_ws(*pattern);
-        start = *pattern;
-        while (**pattern && **pattern != '{' && **pattern != ')' && !isspace(**pattern)) (*pattern)++;
-        np->label = strndup(start, *pattern - start);
-        *pattern = skip_ws(*pattern);
-    }
-    // Properties (simple {key:'val'} for now, only id)
-    if (**pattern == '{') {
-        (*pattern)++;
-        *pattern = skip_ws(*pattern);
-        start = *pattern;
-        while (**pattern && **pattern != ':') (*pattern)++;
-        np->prop_key = strndup(start, *pattern - start);
-        (*pattern)++;
-        *pattern = skip_ws(*pattern);
-        if (**pattern == '\'') (*pattern)++;
-        start = *pattern;
-        while (**pattern && **pattern != '\'') (*pattern)++;
-        np->prop_value = strndup(start, *pattern - start);
-        if (**pattern == '\'') (*pattern)++;
-        *pattern = skip_ws(*pattern);
-        if (**pattern == '}') (*pattern)++;
-    }
-    *pattern = skip_ws(*pattern);
-    if (**pattern == ')') (*pattern)++;
-    return np;
-}
-
-// Add updated parse_rel
-static RelPattern* parse_rel(const char** pattern) {
-    *pattern = skip_ws(*pattern);
-    char start_dir = 0;
-    if (**pattern == '<') {
-        start_dir = '<';
-        (*pattern)++;
-        *pattern = skip_ws(*pattern);
-    }
-    if (**pattern != '-') return NULL;
-    (*pattern)++;
-    *pattern = skip_ws(*pattern);
-    if (**pattern != '[') return NULL;
-    (*pattern)++;
-    *pattern = skip_ws(*pattern);
-    RelPattern* rp = calloc(1, sizeof(RelPattern));
-    const char* start = *pattern;
-    while (**pattern && **pattern != ':' && **pattern != ']' && **pattern != '*') (*pattern)++;
-    if (*pattern > start) rp->var = strndup(start, *pattern - start);
-    if (**pattern == ':') {
-        (*pattern)++;
-        start = *pattern;
-        while (**pattern && **pattern != ']' && **pattern != '*') (*pattern)++;
-        rp->type = strndup(start, *pattern - start);
-    }
-    if (**pattern == '*') {
-        (*pattern)++;
-        const char* num_start = *pattern;
-        while (isdigit(**pattern)) (*pattern)++;
-        rp->min_hops = (num_start < *pattern) ? atoi(num_start) : 1;
-        if (strncmp(*pattern, "..", 2) == 0) {
-            (*pattern) += 2;
-            num_start = *pattern;
-            while (isdigit(**pattern)) (*pattern)++;
-            rp->max_hops = (num_start < *pattern) ? atoi(num_start) : -1;
+    PositionFilter* nodes; // per pattern node
+    PositionFilter* rels;  // per pattern relationship
+    bool* pushed;          // per condition: already enforced by the traversal
+    bool unsatisfiable;    // a condition names a variable the pattern does not bind
+} PatternFilters;
+
+// Hop-0 label and all-node scans read this many ids per RocksDB seek
+#define SCAN_PAGE_SIZE 256
+
+static void position_filter_add(PositionFilter* f, const WhereCondition* wc) {
+    f->conds = realloc(f->conds, (f->count + 1) * sizeof(WhereCondition*));
+    int i = f->count++;
+    if (strcmp(wc->prop, "id") == 0 || strcmp(wc->prop, "label") == 0) {
+        memmove(f->conds + 1, f->conds, i * sizeof(WhereCondition*));
+        i = 0;
+    }
+    f->conds[i] = wc;
+}
+
+static PatternFilters* pattern_filters_create(const ParsedQuery* pq) {
+    const PathPattern* path = pq->match;
+    PatternFilters* filters = calloc(1, sizeof(PatternFilters));
+    filters->nodes = calloc(path->count, sizeof(PositionFilter));
+    filters->rels = calloc(path->count > 1 ? path->count - 1 : 1, sizeof(PositionFilter));
+    filters->pushed = calloc(pq->cond_count > 0 ? pq->cond_count : 1, sizeof(bool));
+    for (int c = 0; c < pq->cond_count; c++) {
+        const WhereCondition* wc = &pq->conditions[c];
+        int hop = -1, rel = -1;
+        for (int h = 0; h < path->count && hop == -1; h++) {
+            if (path->nodes[h].var && strcmp(path->nodes[h].var, wc->var) == 0) hop = h;
+        }
+        for (int r = 0; r < path->count - 1 && hop == -1 && rel == -1; r++) {
+            if (path->rels[r].var && strcmp(path->rels[r].var, wc->var) == 0) rel = r;
+        }
+        if (hop == -1 && rel == -1) {
+            filters->unsatisfiable = true;
+            continue;
+        }
+        // Positions behind a variable-length hop only line up with the
+        // matched path in RETURN rows; relationship conditions other than a
+        // fixed-length hop's type keep their row-level semantics
+        bool fixed_prefix = true;
+        int end = hop != -1 ? hop : rel + 1;
+        for (int r = 0; r < end; r++) {
+            if (path->rels[r].min_hops != path->rels[r].max_hops) fixed_prefix = false;
+        }
+        if (hop != -1 && (pq->type == Q_MATCH_RETURN || fixed_prefix)) {
+            position_filter_add(&filters->nodes[hop], wc);
+            filters->pushed[c] = true;
+        } else if (rel != -1 && pq->type == Q_MATCH_RETURN && fixed_prefix && strcmp(wc->prop, "type") == 0) {
+            position_filter_add(&filters->rels[rel], wc);
+            filters->pushed[c] = true;
+        }
+    }
+    return filters;
+}
+
+static void pattern_filters_free(PatternFilters* filters, int count) {
+    for (int h = 0; h < count; h++) free(filters->nodes[h].conds);
+    for (int r = 0; r < count - 1; r++) free(filters->rels[r].conds);
+    free(filters->nodes);
+    free(filters->rels);
+    free(filters->pushed);
+    free(filters);
+}
+
+static bool node_filter_passes(GraphDB* gdb, const PositionFilter* f, const char* id, const char* label) {
+    for (int i = 0; i < f->count; i++) {
+        const WhereCondition* wc = f->conds[i];
+        bool ok;
+        if (strcmp(wc->prop, "id") == 0) {
+            ok = strcmp(id, wc->val) == 0;
+        } else if (strcmp(wc->prop, "label") == 0) {
+            ok = label && strcmp(label, wc->val) == 0;
         } else {
-            rp->max_hops = rp->min_hops;
+            char* value = graphdb_get_node_property(gdb, id, wc->prop);
+            ok = value && strcmp(value, wc->val) == 0;
+            free(value);
         }
-    } else {
-        rp->min_hops = 1;
-        rp->max_hops = 1;
-    }
-    printf("Parsed rel: min=%d max=%d type=%s\n", rp->min_hops, rp->max_hops, rp->type ? rp->type : "NULL");
-    if (**pattern == ']') (*pattern)++;
-    *pattern = skip_ws(*pattern);
-    if (**pattern == '-') {
-        (*pattern)++;
-        if (**pattern == '>') {
-            rp->direction = '>';
-            (*pattern)++;
-        } else if (start_dir == '<') {
-            rp->direction = '<';
-        }
-    } else if (**pattern == '>') {
-        rp->direction = '>';
-        (*pattern)++;
-    } else if (start_dir == '<') {
-        rp->direction = '<';
-    }
-    *pattern = skip_ws(*pattern);
-    return rp;
-}
-
-// Update parse_match
-static PathPattern* parse_match(const char* match_str) {
-    const char* p = match_str;
-    PathPattern* path = calloc(1, sizeof(PathPattern));
-    p = skip_ws(p);
-    const char* eq = strchr(p, '=');
-    if (eq && *(eq + 1) == ' ') {
-        path->path_var = trim(strndup(p, eq - p));
-        p = skip_ws(eq + 1);
-    }
-    NodePattern* np = parse_node(&p);
-    if (!np) {
-        free(path);
-        return NULL;
+        if (!ok) return false;
     }
-    path->nodes = (NodePattern*)malloc(sizeof(NodePattern));
-    path->nodes[0] = *np;
-    free(np);
-    path->count = 1;
-    RelPattern* rp = parse_rel(&p);
-    int rel_count = 0;
-    while (rp) {
-        path->rels = (RelPattern*)realloc(path->rels, sizeof(RelPattern) * (rel_count + 1));
-        path->rels[rel_count] = *rp;
-        free(rp);
-        rel_count++;
-        np = parse_node(&p);
-        if (!np) break;
-        path->nodes = (NodePattern*)realloc(path->nodes, sizeof(NodePattern) * (path->count + 1));
-        path->nodes[path->count] = *np;
-        free(np);
-        path->count++;
-        rp = parse_rel(&p);
-    }
-    return path;
-}
-
-// Parse RETURN (simple list like b.id, a.label)
-static char** parse_return(const char* ret_str, int* count) {
-    char* ret_copy = strdup(ret_str);
-    char** cols = NULL;
+    return true;
+}
+
+static bool rel_filter_passes(const PositionFilter* f, const char* type) {
+    for (int i = 0; i < f->count; i++) {
+        if (strcmp(type ? type : "", f->conds[i]->val) != 0) return false;
+    }
+    return true;
+}
+
+/*******************************
+ * Path walks
+ *******************************/
+
+// Default depth of variable-length hops without an upper bound
+#define UNBOUNDED_HOPS 20
+
+static const char* pattern_node_id(const NodePattern* np) {
+    if (np->prop_key && strcmp(np->prop_key, "id") == 0) return np->prop_value;
+    return NULL;
+}
+
+// Neighbors of `node` across `rp`, deduplicated by id when it has no direction
+static Neighbor* fetch_neighbors(GraphDB* gdb, const char* node, const RelPattern* rp, int* count) {
+    const char* type = rp->type ? rp->type : "";
+    if (rp->direction == '>') return graphdb_get_outgoing(gdb, node, type, count);
+    if (rp->direction == '<') return graphdb_get_incoming(gdb, node, type, count);
+    int out_count;
+    Neighbor* outs = graphdb_get_outgoing(gdb, node, type, &out_count);
+    int in_count;
+    Neighbor* ins = graphdb_get_incoming(gdb, node, type, &in_count);
+    Neighbor* neighbors = malloc((out_count + in_count) * sizeof(Neighbor));
     *count = 0;
-    char* tok = strtok(ret_copy, ",");
-    while (tok) {
-        tok = trim(tok);
-        cols = (char**)realloc(cols, sizeof(char*) * (*count + 1));
-        cols[*count] = strdup(tok);
-        (*count)++;
-        tok = strtok(NULL, ",");
-    }
-    free(ret_copy);
-    return cols;
-}
-
-// Update collect_paths to handle variable length
-static void collect_paths(GraphDB* gdb, PathPattern* path, int hop, char** current_path, int current_len, MatchingPath*** paths, int* num_paths, int* capacity, int* current_positions, char** current_rel_types, int current_rel_count) {
-    if (hop >= path->count) {
-        if (*num_paths >= *capacity) {
-            *capacity *= 2;
-            *paths = realloc(*paths, sizeof(MatchingPath*) * (*capacity));
-        }
-        (*paths)[*num_paths] = malloc(sizeof(MatchingPath));
-        MatchingPath* mp = (*paths)[*num_paths];
-        mp->num_nodes = current_len;
-        mp->node_ids = malloc(current_len * sizeof(char*));
-        for (int i = 0; i < current_len; i++) mp->node_ids[i] = strdup(current_path[i]);
-        mp->pattern_pos = malloc(path->count * sizeof(int));
-        memcpy(mp->pattern_pos, current_positions, path->count * sizeof(int));
-        mp->num_rels = current_rel_count;
-        mp->rel_types = malloc(current_rel_count * sizeof(char*));
-        for (int i = 0; i < current_rel_count; i++) mp->rel_types[i] = strdup(current_rel_types[i]);
-        (*num_paths)++;
-        return;
+    // Hash set of the outgoing ids, so the union is linear in the degree
+    StrMap* outgoing = strmap_create(out_count);
+    for (int j = 0; j < out_count; j++) {
+        neighbors[(*count)++] = outs[j];
+        strmap_intern(outgoing, outs[j].id, strlen(outs[j].id), NULL);
+    }
+    for (int j = 0; j < in_count; j++) {
+        if (strmap_find(outgoing, ins[j].id, strlen(ins[j].id)) < 0) neighbors[(*count)++] = ins[j];
+        else {
+            free(ins[j].id);
+            free(ins[j].type);
+        }
+    }
+    strmap_destroy(outgoing);
+    free(outs);
+    free(ins);
+    return neighbors;
+}
+
+static void free_neighbors(Neighbor* neighbors, int count) {
+    for (int i = 0; i < count; i++) {
+        free(neighbors[i].id);
+        free(neighbors[i].type);
+    }
+    free(neighbors);
+}
+
+// Pending work of one pattern node: the candidates of a single hop (hop 0
+// label and all-node scans are read a page at a time), or the path tree of a
+// variable-length hop
+typedef struct {
+    int base_len;      // path length before this node is bound
+    int base_rel_len;
+    Neighbor* cands;
+    int cand_count;
+    int next;
+    bool paged;
+    bool more;
+    char* scan_after;
+    bool var;
+    PathTree tree;     // steps[0, base_len) are the path bound so far
+} WalkFrame;
+
+// Pull-based depth-first walk over one linear pattern. Each path_walk_next
+// binds the next complete path into ids / rels / positions; the strings are
+// borrowed from the frames or the dictionary and stay valid until the
+// following call.
+typedef struct {
+    GraphDB* gdb;
+    PathPattern* path;
+    const PatternFilters* filters;
+    int max_hops;      // depth of variable-length hops without an upper bound
+    WalkFrame* frames;
+    int depth;         // frames[0..depth) are open
+    bool started;
+    IdDict dict;       // created by the first variable-length hop
+    NeighborBuffer nbrs;
+    char** ids;
+    int len;
+    char** rels;
+    int rel_len;
+    int* positions;    // per pattern node, index into ids
+} PathWalk;
+
+// Depth of `*` and `*n..` hops, set with cypher_set_max_hops
+static int unbounded_hops(GraphDB* gdb) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    int hops = gdb->max_var_hops > 0 ? gdb->max_var_hops : UNBOUNDED_HOPS;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+    return hops;
+}
+
+void cypher_set_max_hops(GraphDB* gdb, int hops) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    gdb->max_var_hops = hops > 0 ? hops : 0;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+}
+
+// Longest path a pattern can bind, in nodes
+static int pattern_max_len(const PathPattern* path, int max_hops) {
+    int len = 1;
+    for (int r = 0; r < path->count - 1; r++) {
+        const RelPattern* rp = &path->rels[r];
+        if (rp->min_hops == rp->max_hops) len++;
+        else len += rp->max_hops == -1 ? max_hops : rp->max_hops;
     }
+    return len;
+}
+
+static PathWalk* path_walk_create(GraphDB* gdb, PathPattern* path, const PatternFilters* filters, int max_hops) {
+    PathWalk* w = calloc(1, sizeof(PathWalk));
+    w->gdb = gdb;
+    w->path = path;
+    w->filters = filters;
+    w->max_hops = max_hops;
+    w->frames = calloc(path->count, sizeof(WalkFrame));
+    int cap = pattern_max_len(path, max_hops);
+    w->ids = malloc(cap * sizeof(char*));
+    w->rels = malloc(cap * sizeof(char*));
+    w->positions = calloc(path->count, sizeof(int));
+    return w;
+}
+
+static void frame_close(WalkFrame* f) {
+    free_neighbors(f->cands, f->cand_count);
+    free(f->scan_after);
+    path_tree_free(&f->tree);
+    memset(f, 0, sizeof(WalkFrame));
+}
+
+static void path_walk_destroy(PathWalk* w) {
+    if (!w) return;
+    for (int h = 0; h < w->depth; h++) frame_close(&w->frames[h]);
+    free(w->frames);
+    free(w->ids);
+    free(w->rels);
+    free(w->positions);
+    id_dict_free(&w->dict);
+    neighbor_buffer_free(&w->nbrs);
+    free(w);
+}
 
-    NodePattern* np = &path->nodes[hop];
-    RelPattern* rp = (hop > 0) ? &path->rels[hop - 1] : NULL;
+// Label, pinned id and the WHERE conjuncts pushed onto pattern node `hop`
+// (and onto the single relationship that reached it, when `rel_type` is set)
+static bool walk_accepts(PathWalk* w, int hop, const char* id, const char* rel_type) {
+    const NodePattern* np = &w->path->nodes[hop];
+    char* label = graphdb_get_node_label(w->gdb, id);
+    if (!label) return false;
+    bool ok = !np->label || strcmp(np->label, label) == 0;
+    const char* pinned = pattern_node_id(np);
+    if (ok && pinned) ok = strcmp(id, pinned) == 0;
+    if (ok && rel_type) ok = rel_filter_passes(&w->filters->rels[hop - 1], rel_type);
+    if (ok) ok = node_filter_passes(w->gdb, &w->filters->nodes[hop], id, label);
+    free(label);
+    return ok;
+}
 
+static void frame_open(PathWalk* w, int hop) {
+    WalkFrame* f = &w->frames[hop];
+    memset(f, 0, sizeof(WalkFrame));
+    f->base_len = w->len;
+    f->base_rel_len = w->rel_len;
+    const NodePattern* np = &w->path->nodes[hop];
+    const RelPattern* rp = hop > 0 ? &w->path->rels[hop - 1] : NULL;
     if (rp && rp->min_hops != rp->max_hops) {
-        PathQueue* queue = path_queue_create();
-        char** init_path = malloc(current_len * sizeof(char*));
-        for (int i = 0; i < current_len; i++) init_path[i] = strdup(current_path[i]);
-        char** init_rel_types = NULL;
-        int init_rel_count = 0;
-        if (current_rel_count > 0) {
-            init_rel_types = malloc(current_rel_count * sizeof(char*));
-            for (int i = 0; i < current_rel_count; i++) init_rel_types[i] = strdup(current_rel_types[i]);
-            init_rel_count = current_rel_count;
-        }
-        path_queue_enqueue(queue, init_path, current_len, 0, init_rel_types, init_rel_count);
-        for (int i = 0; i < current_len; i++) free(init_path[i]);
-        free(init_path);
-        if (init_rel_types) {
-            for (int i = 0; i < init_rel_count; i++) free(init_rel_types[i]);
-            free(init_rel_types);
-        }
-        char** cur_path = NULL;
-        int cur_len = 0;
-        int local_hops = 0;
-        char** cur_rel_types = NULL;
-        int cur_rel_count = 0;
-        while (path_queue_dequeue(queue, &cur_path, &cur_len, &local_hops, &cur_rel_types, &cur_rel_count)) {
-            if (local_hops >= rp->min_hops && local_hops <= (rp->max_hops == -1 ? 20 : rp->max_hops)) {
-                char* cand_id = cur_path[cur_len - 1];
-                char* cand_label = graphdb_get_node_label(gdb, cand_id);
-                bool node_match = (cand_label != NULL);
-                if (node_match && np->label) node_match = strcmp(np->label, cand_label) == 0;
-                else if (node_match && np->label == NULL && strcmp(cand_label, "Person") != 0) node_match = false;
-                if (node_match && np->prop_value && np->prop_key && strcmp(np->prop_key, "id") == 0) node_match = strcmp(cand_id, np->prop_value) == 0;
-                free(cand_label);
-                if (node_match) {
-                    int* temp_positions = malloc(path->count * sizeof(int));
-                    memcpy(temp_positions, current_positions, path->count * sizeof(int));
-                    temp_positions[hop] = cur_len - 1;
-                    collect_paths(gdb, path, hop + 1, cur_path, cur_len, paths, num_paths, capacity, temp_positions, cur_rel_types, cur_rel_count);
-                    free(temp_positions);
-                }
-            }
-            if (local_hops < (rp->max_hops == -1 ? 20 : rp->max_hops)) {
-                char* last_id = cur_path[cur_len - 1];
-                char* cur_type = rp->type ? rp->type : "";
-                Neighbor* neighbors = NULL;
-                int neigh_count = 0;
-                if (rp->direction == '>') {
-                    neighbors = graphdb_get_outgoing(gdb, last_id, cur_type, &neigh_count);
-                } else if (rp->direction == '<') {
-                    neighbors = graphdb_get_incoming(gdb, last_id, cur_type, &neigh_count);
-                } else {
-                    int out_count;
-                    Neighbor* outs = graphdb_get_outgoing(gdb, last_id, cur_type, &out_count);
-                    int in_count;
-                    Neighbor* ins = graphdb_get_incoming(gdb, last_id, cur_type, &in_count);
-                    neighbors = malloc((out_count + in_count) * sizeof(Neighbor));
-                    neigh_count = 0;
-                    for (int j = 0; j < out_count; j++) neighbors[neigh_count++] = outs[j];
-                    for (int j = 0; j < in_count; j++) {
-                        bool dup = false;
-                        for (int k = 0; k < out_count; k++) if (strcmp(ins[j].id, outs[k].id) == 0) dup = true;
-                        if (!dup) neighbors[neigh_count++] = ins[j];
-                        else {
-                            free(ins[j].id);
-                            free(ins[j].type);
-                        }
-                    }
-                    free(outs);
-                    free(ins);
-                }
-                for (int n = 0; n < neigh_count; n++) {
-                    bool in_path = false;
-                    for (int k = 0; k < cur_len; k++) {
-                        if (strcmp(cur_path[k], neighbors[n].id) == 0) in_path = true;
-                    }
-                    if (!in_path) {
-                        char** new_path = malloc((cur_len + 1) * sizeof(char*));
-                        for (int k = 0; k < cur_len; k++) new_path[k] = strdup(cur_path[k]);
-                        new_path[cur_len] = strdup(neighbors[n].id);
-                        char** new_rel_types = malloc((cur_rel_count + 1) * sizeof(char*));
-                        for (int k = 0; k < cur_rel_count; k++) new_rel_types[k] = strdup(cur_rel_types[k]);
-                        new_rel_types[cur_rel_count] = strdup(neighbors[n].type);
-                        path_queue_enqueue(queue, new_path, cur_len + 1, local_hops + 1, new_rel_types, cur_rel_count + 1);
-                        for (int k = 0; k <= cur_len; k++) free(new_path[k]);
-                        free(new_path);
-                        for (int k = 0; k <= cur_rel_count; k++) free(new_rel_types[k]);
-                        free(new_rel_types);
-                    }
-                    free(neighbors[n].id);
-                    free(neighbors[n].type);
-                }
-                free(neighbors);
+        if (!w->dict.ids) id_dict_init(&w->dict, w->gdb);
+        f->var = true;
+        for (int i = 0; i < w->len; i++) path_tree_add(&f->tree, i - 1, id_dict_intern(w->dict.ids, w->ids[i]), -1, 0);
+        f->tree.next = w->len - 1;
+    } else if (rp) {
+        f->cands = fetch_neighbors(w->gdb, w->ids[w->len - 1], rp, &f->cand_count);
+    } else if (pattern_node_id(np)) {
+        f->cands = malloc(sizeof(Neighbor));
+        f->cands[0].id = strdup(pattern_node_id(np));
+        f->cands[0].type = strdup("");
+        f->cand_count = 1;
+    } else {
+        f->paged = true;
+        f->more = true;
+    }
+}
+
+// Visits the hop's path tree breadth first, growing it as it goes, and binds
+// the next path whose end is accepted
+static bool frame_advance_var(PathWalk* w, int hop) {
+    WalkFrame* f = &w->frames[hop];
+    PathTree* t = &f->tree;
+    const RelPattern* rp = &w->path->rels[hop - 1];
+    int max_hops = rp->max_hops == -1 ? w->max_hops : rp->max_hops;
+    const char* type = rp->type ? rp->type : "";
+    while (t->next < t->count) {
+        int s = t->next++;
+        int hops = t->steps[s].hops;
+        if (hops < max_hops) {
+            id_dict_neighbors(&w->dict, t->steps[s].node, type, rel_walk_direction(rp, 0), &w->nbrs);
+            for (int n = 0; n < w->nbrs.count; n++) {
+                if (path_tree_contains(t, s, w->nbrs.ids[n])) continue;
+                path_tree_add(t, s, w->nbrs.ids[n], w->nbrs.types[n], hops + 1);
             }
-            for (int i = 0; i < cur_len; i++) free(cur_path[i]);
-            free(cur_path);
-            for (int i = 0; i < cur_rel_count; i++) free(cur_rel_types[i]);
-            free(cur_rel_types);
         }
-        path_queue_destroy(queue);
-    } else {
-        Neighbor* candidates = NULL;
-        int cand_count = 0;
-        if (hop == 0) {
-            if (np->prop_value && np->prop_key && strcmp(np->prop_key, "id") == 0) {
-                cand_count = 1;
-                candidates = malloc(sizeof(Neighbor));
-                candidates[0].id = strdup(np->prop_value);
-                candidates[0].type = strdup("");
-            } else if (np->label) {
-                char** node_ids = graphdb_get_nodes_by_label(gdb, np->label, &cand_count);
-                candidates = malloc(cand_count * sizeof(Neighbor));
-                for (int i = 0; i < cand_count; i++) {
-                    candidates[i].id = node_ids[i];
-                    candidates[i].type = strdup("");
-                }
-                free(node_ids);
-            } else {
-                char** node_ids = graphdb_get_all_nodes(gdb, &cand_count);
-                candidates = malloc(cand_count * sizeof(Neighbor));
-                for (int i = 0; i < cand_count; i++) {
-                    candidates[i].id = node_ids[i];
-                    candidates[i].type = strdup("");
-                }
-                free(node_ids);
+        if (hops < rp->min_hops || !walk_accepts(w, hop, id_dict_key(w->dict.ids, t->steps[s].node), NULL)) continue;
+        w->len = f->base_len + hops;
+        w->rel_len = f->base_rel_len + hops;
+        for (int i = s; t->steps[i].hops > 0; i = t->steps[i].parent) {
+            w->ids[f->base_len - 1 + t->steps[i].hops] = (char*)id_dict_key(w->dict.ids, t->steps[i].node);
+            w->rels[f->base_rel_len + t->steps[i].hops - 1] = (char*)id_dict_key(w->dict.types, t->steps[i].type);
+        }
+        w->positions[hop] = w->len - 1;
+        return true;
+    }
+    return false;
+}
+
+// Binds the frame's next accepted node; false once it is exhausted
+static bool frame_advance(PathWalk* w, int hop) {
+    WalkFrame* f = &w->frames[hop];
+    if (f->var) return frame_advance_var(w, hop);
+    for (;;) {
+        if (f->next >= f->cand_count) {
+            if (!f->paged || !f->more) return false;
+            free_neighbors(f->cands, f->cand_count);
+            int count = 0;
+            char** node_ids = graphdb_scan_nodes(w->gdb, w->path->nodes[hop].label, f->scan_after, SCAN_PAGE_SIZE, &count);
+            f->cands = malloc((count > 0 ? count : 1) * sizeof(Neighbor));
+            for (int i = 0; i < count; i++) {
+                f->cands[i].id = node_ids[i];
+                f->cands[i].type = strdup("");
             }
-        } else {
-            char* prev_id = current_path[current_len - 1];
-            RelPattern* rp = &path->rels[hop - 1];
-            char* rel_type = rp->type ? rp->type : "";
-            if (rp->direction == '>') {
-                candidates = graphdb_get_outgoing(gdb, prev_id, rel_type, &cand_count);
-            } else if (rp->direction == '<') {
-                candidates = graphdb_get_incoming(gdb, prev_id, rel_type, &cand_count);
-            } else {
-                int out_count;
-                Neighbor* outs = graphdb_get_outgoing(gdb, prev_id, rel_type, &out_count);
-                int in_count;
-                Neighbor* ins = graphdb_get_incoming(gdb, prev_id, rel_type, &in_count);
-                candidates = malloc((out_count + in_count) * sizeof(Neighbor));
-                cand_count = 0;
-                for (int j = 0; j < out_count; j++) candidates[cand_count++] = outs[j];
-                for (int j = 0; j < in_count; j++) {
-                    bool dup = false;
-                    for (int k = 0; k < out_count; k++) if (strcmp(ins[j].id, outs[k].id) == 0) dup = true;
-                    if (!dup) candidates[cand_count++] = ins[j];
-                    else {
-                        free(ins[j].id);
-                        free(ins[j].type);
-                    }
-                }
-                free(outs);
-                free(ins);
+            free(node_ids);
+            f->cand_count = count;
+            f->next = 0;
+            f->more = count == SCAN_PAGE_SIZE;
+            if (f->more) {
+                free(f->scan_after);
+                f->scan_after = strdup(f->cands[count - 1].id);
             }
+            continue;
         }
-        for (int i = 0; i < cand_count; i++) {
-            char* cand_id = candidates[i].id;
-            char* cand_rel_type = candidates[i].type;
-            char* cand_label = graphdb_get_node_label(gdb, cand_id);
-            if (!cand_label) {
-                free(cand_id);
-                free(cand_rel_type);
-                continue;
-            }
-            bool node_match = true;
-            if (np->label && strcmp(np->label, cand_label) != 0) node_match = false;
-            if (np->prop_value && np->prop_key && strcmp(np->prop_key, "id") == 0 && strcmp(cand_id, np->prop_value) != 0) node_match = false;
-            free(cand_label);
-            if (node_match) {
-                char** new_path = malloc((current_len + 1) * sizeof(char*));
-                for (int k = 0; k < current_len; k++) new_path[k] = strdup(current_path[k]);
-                new_path[current_len] = strdup(cand_id);
-                int* new_positions = malloc(path->count * sizeof(int));
-                memcpy(new_positions, current_positions, path->count * sizeof(int));
-                new_positions[hop] = current_len;
-                char** new_rel_types = malloc(current_rel_count * sizeof(char*));
-                int new_rel_count = current_rel_count;
-                for (int k = 0; k < current_rel_count; k++) new_rel_types[k] = strdup(current_rel_types[k]);
-                if (hop > 0) {
-                    new_rel_types = realloc(new_rel_types, (new_rel_count + 1) * sizeof(char*));
-                    new_rel_types[new_rel_count] = strdup(cand_rel_type ? cand_rel_type : "");
-                    new_rel_count++;
-                }
-                collect_paths(gdb, path, hop + 1, new_path, current_len + 1, paths, num_paths, capacity, new_positions, new_rel_types, new_rel_count);
-                for (int k = 0; k <= current_len; k++) free(new_path[k]);
-                free(new_path);
-                free(new_positions);
-                for (int k = 0; k < new_rel_count; k++) free(new_rel_types[k]);
-                free(new_rel_types);
+        Neighbor* cand = &f->cands[f->next++];
+        if (!walk_accepts(w, hop, cand->id, hop > 0 ? cand->type : NULL)) continue;
+        w->len = f->base_len;
+        w->rel_len = f->base_rel_len;
+        w->positions[hop] = w->len;
+        w->ids[w->len++] = cand->id;
+        if (hop > 0) w->rels[w->rel_len++] = cand->type;
+        return true;
+    }
+}
+
+static bool path_walk_next(PathWalk* w) {
+    if (!w->started) {
+        w->started = true;
+        frame_open(w, 0);
+        w->depth = 1;
+    }
+    int hop = w->depth - 1;
+    while (hop >= 0) {
+        if (frame_advance(w, hop)) {
+            if (hop == w->path->count - 1) return true;
+            frame_open(w, ++hop);
+            w->depth = hop + 1;
+        } else {
+            frame_close(&w->frames[hop]);
+            w->depth = hop--;
+        }
+    }
+    return false;
+}
+
+// Copy of a borrowed path over a `count`-node pattern, owned by `arena`
+static MatchingPath* matching_path_copy(CypherArena* arena, const MatchingPath* src, int count) {
+    MatchingPath* mp = cypher_arena_alloc(arena, sizeof(MatchingPath));
+    mp->num_nodes = src->num_nodes;
+    mp->node_ids = cypher_arena_alloc(arena, src->num_nodes * sizeof(char*));
+    for (int i = 0; i < src->num_nodes; i++) mp->node_ids[i] = cypher_arena_strndup(arena, src->node_ids[i], strlen(src->node_ids[i]));
+    mp->pattern_pos = cypher_arena_alloc(arena, count * sizeof(int));
+    memcpy(mp->pattern_pos, src->pattern_pos, count * sizeof(int));
+    mp->num_rels = src->num_rels;
+    mp->rel_types = cypher_arena_alloc(arena, src->num_rels * sizeof(char*));
+    for (int i = 0; i < src->num_rels; i++) {
+        const char* type = src->rel_types[i];
+        mp->rel_types[i] = type ? cypher_arena_strndup(arena, type, strlen(type)) : NULL;
+    }
+    return mp;
+}
+
+/*******************************
+ * Anchor selection
+ *******************************/
+
+// Cap on the iterator steps spent on one label count or degree estimate
+#define PLANNER_STAT_LIMIT 10000
+
+// Most selective node to start matching from: a node pinned to an id (the
+// one with the fewest edges along the pattern when there are several), else
+// the label with the fewest nodes, else nodes[0]. Ties keep the leftmost
+// node, so patterns without a better anchor run exactly as written.
+static int choose_anchor(GraphDB* gdb, const PathPattern* path) {
+    int bound = 0, labelled = 0;
+    for (int h = 0; h < path->count; h++) {
+        if (pattern_node_id(&path->nodes[h])) bound++;
+        else if (path->nodes[h].label) labelled++;
+    }
+    int anchor = 0;
+    long long best = LLONG_MAX;
+    if (bound > 0) {
+        for (int h = 0; h < path->count; h++) {
+            const char* id = pattern_node_id(&path->nodes[h]);
+            if (!id) continue;
+            if (bound == 1) return h;
+            long long cost = 0;
+            if (h > 0) {
+                const RelPattern* rp = &path->rels[h - 1];
+                cost += graphdb_degree(gdb, id, rp->type, rel_walk_direction(rp, 1), PLANNER_STAT_LIMIT);
             }
-            free(cand_id);
-            free(cand_rel_type);
-        }
-        free(candidates);
-    }
-}
-
-static int split_on_and(const char* str, char*** parts) {
-    char* temp = strdup(str);
-    char* p = temp;
-    int count = 1;
-    while ((p = strstr(p, " AND ")) != NULL) {
-        count++;
-        p += 5;
-    }
-    *parts = malloc(count * sizeof(char*));
-    free(temp);
-    temp = strdup(str);
-    p = temp;
-    char* start = temp;
-    int i = 0;
-    while ((p = strstr(start, " AND ")) != NULL) {
-        *p = '\0';
-        (*parts)[i++] = strdup(start);
-        start = p + 5;
-    }
-    (*parts)[i] = strdup(start);
-    free(temp);
-    return count;
-}
-
-static ParsedQuery* parse_cypher(const char* query) {
-    ParsedQuery* pq = calloc(1, sizeof(ParsedQuery));
-    const char* create_start = strstr(query, "CREATE");
-    const char* delete_start = strstr(query, "DELETE");
-    const char* match_start = strstr(query, "MATCH");
-    const char* where_start = strstr(query, "WHERE");
-    const char* return_start = strstr(query, "RETURN");
-
-    if (create_start) {
-        pq->type = Q_CREATE;
-        create_start += 6;
-        char* pattern_str = trim(strdup(create_start));
-        pq->match = parse_match(pattern_str);
-        free(pattern_str);
-    } else if (match_start && delete_start) {
-        pq->type = Q_DELETE;
-        match_start += 5;
-        const char* pattern_end = where_start ? where_start : delete_start;
-        size_t match_len = pattern_end - match_start;
-        char* match_string = strndup(match_start, match_len);
-        char* trimmed_match = trim(match_string);
-        free(match_string);
-        pq->match = parse_match(trimmed_match);
-        free(trimmed_match);
-        if (where_start) {
-            where_start += 5;
-            size_t where_len = delete_start - where_start;
-            char* where_string = strndup(where_start, where_len);
-            char* trimmed_where = trim(where_string);
-            free(where_string);
-
-            pq->cond_count = 0;
-            pq->conditions = NULL;
-            char** conds;
-            int num_conds = split_on_and(trimmed_where, &conds);
-            for (int j = 0; j < num_conds; j++) {
-                char* cond_tok = trim(conds[j]);
-                const char* dot = strchr(cond_tok, '.');
-                const char* eq = strchr(cond_tok, '=');
-                const char* q1 = strchr(cond_tok, '\'');
-                const char* q2 = q1 ? strchr(q1 + 1, '\'') : NULL;
-                if (dot && eq && q1 && q2 && dot < eq && eq < q1 && q1 < q2) {
-                    char* var = strndup(cond_tok, dot - cond_tok);
-                    const char* prop_start = dot + 1;
-                    while (prop_start < eq && isspace(*prop_start)) prop_start++;
-                    const char* prop_end = eq;
-                    while (prop_end > prop_start && isspace(*(prop_end - 1))) prop_end--;
-                    char* prop = strndup(prop_start, prop_end - prop_start);
-                    char* val = strndup(q1 + 1, q2 - q1 - 1);
-                    pq->conditions = realloc(pq->conditions, sizeof(WhereCondition) * (pq->cond_count + 1));
-                    pq->conditions[pq->cond_count].var = var;
-                    pq->conditions[pq->cond_count].prop = prop;
-                    pq->conditions[pq->cond_count].val = val;
-                    pq->cond_count++;
-                }
-                free(cond_tok);
-                free(conds[j]);
+            if (h < path->count - 1) {
+                const RelPattern* rp = &path->rels[h];
+                cost += graphdb_degree(gdb, id, rp->type, rel_walk_direction(rp, 0), PLANNER_STAT_LIMIT);
             }
-            free(conds);
-            free(trimmed_where);
-        }
-        delete_start += 6;
-        char* delete_string = trim(strdup(delete_start));
-        pq->deletes = parse_return(delete_string, &pq->delete_count);
-        free(delete_string);
-    } else if (match_start && return_start) {
-        pq->type = Q_MATCH_RETURN;
-        match_start += 5;
-        const char* pattern_end = where_start ? where_start : return_start;
-        size_t match_len = pattern_end - match_start;
-        char* match_string = strndup(match_start, match_len);
-        char* trimmed_match = trim(match_string);
-        free(match_string);
-        pq->match = parse_match(trimmed_match);
-        free(trimmed_match);
-        if (where_start) {
-            where_start += 5;
-            size_t where_len = return_start - where_start;
-            char* where_string = strndup(where_start, where_len);
-            char* trimmed_where = trim(where_string);
-            free(where_string);
-
-            pq->cond_count = 0;
-            pq->conditions = NULL;
-            char** conds;
-            int num_conds = split_on_and(trimmed_where, &conds);
-            for (int j = 0; j < num_conds; j++) {
-                char* cond_tok = trim(conds[j]);
-                const char* dot = strchr(cond_tok, '.');
-                const char* eq = strchr(cond_tok, '=');
-                const char* q1 = strchr(cond_tok, '\'');
-                const char* q2 = q1 ? strchr(q1 + 1, '\'') : NULL;
-                if (dot && eq && q1 && q2 && dot < eq && eq < q1 && q1 < q2) {
-                    char* var = strndup(cond_tok, dot - cond_tok);
-                    const char* prop_start = dot + 1;
-                    while (prop_start < eq && isspace(*prop_start)) prop_start++;
-                    const char* prop_end = eq;
-                    while (prop_end > prop_start && isspace(*(prop_end - 1))) prop_end--;
-                    char* prop = strndup(prop_start, prop_end - prop_start);
-                    char* val = strndup(q1 + 1, q2 - q1 - 1);
-                    pq->conditions = realloc(pq->conditions, sizeof(WhereCondition) * (pq->cond_count + 1));
-                    pq->conditions[pq->cond_count].var = var;
-                    pq->conditions[pq->cond_count].prop = prop;
-                    pq->conditions[pq->cond_count].val = val;
-                    pq->cond_count++;
-                }
-                free(cond_tok);
-                free(conds[j]);
+            if (cost < best) {
+                best = cost;
+                anchor = h;
             }
-            free(conds);
-            free(trimmed_where);
         }
-        return_start += 6;
-        char* return_string = trim(strdup(return_start));
-        pq->returns = parse_return(return_string, &pq->return_count);
-        free(return_string);
-    } else {
-        free(pq);
-        return NULL;
+        return anchor;
     }
-    return pq;
+    // A labelled scan never reads more than the all-node scan of an unlabeled nodes[0]
+    if (labelled == 0 || (labelled == 1 && path->nodes[0].label)) return 0;
+    for (int h = 0; h < path->count; h++) {
+        if (!path->nodes[h].label) continue;
+        long long cost = graphdb_count_nodes(gdb, path->nodes[h].label, PLANNER_STAT_LIMIT);
+        if (cost < best) {
+            best = cost;
+            anchor = h;
+        }
+    }
+    return anchor;
 }
 
-static int compare_paths_last(const void* a, const void* b) {
+static int compare_paths_first(const void* a, const void* b) {
     const MatchingPath* pa = *(const MatchingPath**)a;
     const MatchingPath* pb = *(const MatchingPath**)b;
-    const char* ida = pa->node_ids[pa->num_nodes - 1];
-    const char* idb = pb->node_ids[pb->num_nodes - 1];
-    return strcmp(ida, idb);
+    return strcmp(pa->node_ids[0], pb->node_ids[0]);
 }
 
-static CypherResult* execute_parsed_query(GraphDB* gdb, ParsedQuery* pq) {
-    CypherResult* result = (CypherResult*)calloc(1, sizeof(CypherResult));
+/*******************************
+ * Profiles
+ *******************************/
 
-    if (pq->type == Q_CREATE) {
-        if (!pq->match) return result;
-        char** created_ids = malloc(sizeof(char*) * pq->match->count);
-        for (int i = 0; i < pq->match->count; i++) {
-            NodePattern* np = &pq->match->nodes[i];
-            if (!np->prop_key || strcmp(np->prop_key, "id") != 0 || !np->prop_value || !np->label) continue;
-            graphdb_add_node(gdb, np->prop_value, np->label);
-            created_ids[i] = strdup(np->prop_value);
-        }
-        for (int i = 0; i < pq->match->count - 1; i++) {
-            RelPattern* rp = &pq->match->rels[i];
-            char* from = created_ids[i];
-            char* to = created_ids[i + 1];
-            if (rp->direction == '<') {
-                char* temp = from;
-                from = to;
-                to = temp;
-            }
-            graphdb_add_edge(gdb, from, to, rp->type ? rp->type : "");
-        }
-        for (int i = 0; i < pq->match->count; i++) free(created_ids[i]);
-        free(created_ids);
-        return result;
-    }
+// One operator of an EXPLAIN / PROFILE plan. Counters add up over every
+// call; a `nested` operator pulls from its input on the same thread, so its
+// counters include the input's. `rows` are the tuples or rows it produced.
+typedef struct {
+    const char* name;
+    char* detail;
+    int input;          // operator feeding this one, -1 for a leaf
+    bool nested;
+    long long rows;
+    long long ns;
+    GraphIOStats io;
+    unsigned long long bytes; // arena bytes allocated
+} ProfileOp;
 
-    // For DELETE and MATCH_RETURN, use path matching
-    char** current_path = malloc(100 * sizeof(char*)); // Increased initial size
-    int capacity = 1;
-    MatchingPath** paths = malloc(sizeof(MatchingPath*) * capacity);
-    int num_paths = 0;
-    int* initial_positions = calloc(pq->match->count, sizeof(int));
-    collect_paths(gdb, pq->match, 0, current_path, 0, &paths, &num_paths, &capacity, initial_positions, NULL, 0);
-    free(initial_positions);
-    free(current_path);
-
-    // Sort paths deterministically by last node id so test expectations are stable
-    if (num_paths > 1) {
-        qsort(paths, num_paths, sizeof(MatchingPath*), compare_paths_last);
-    }
-
-    char* where_var = NULL;
-    char* where_prop = NULL;
-    char* where_val = NULL;
-    // Remove the single condition parsing
-    // Instead, conditions are already in pq->conditions
-
-    if (pq->type == Q_DELETE) {
-        for (int p = 0; p < num_paths; p++) {
-            MatchingPath* mp = paths[p];
-            bool match = true;
-            for (int cond = 0; cond < pq->cond_count; cond++) {
-                WhereCondition* wc = &pq->conditions[cond];
-                int hop_idx = -1;
-                bool is_rel_cond = false;
-                for (int h = 0; h < pq->match->count; h++) {
-                    if (pq->match->nodes[h].var && strcmp(pq->match->nodes[h].var, wc->var) == 0) {
-                        hop_idx = h;
-                        break;
-                    }
-                }
-                if (hop_idx == -1) {
-                    for (int r = 0; r < pq->match->count - 1; r++) {
-                        if (pq->match->rels[r].var && strcmp(pq->match->rels[r].var, wc->var) == 0) {
-                            hop_idx = r;
-                            is_rel_cond = true;
-                            break;
-                        }
-                    }
-                }
-                if (hop_idx != -1) {
-                    char* check_val = NULL;
-                    if (is_rel_cond) {
-                        RelPattern* rp = &pq->match->rels[hop_idx];
-                        if (strcmp(wc->prop, "type") == 0) check_val = strdup(rp->type ? rp->type : "");
-                    } else {
-                        char* node_id = mp->node_ids[hop_idx];
-                        if (strcmp(wc->prop, "id") == 0) check_val = strdup(node_id);
-                        else if (strcmp(wc->prop, "label") == 0) check_val = graphdb_get_node_label(gdb, node_id);
-                    }
-                    if (check_val && strcmp(check_val, wc->val) != 0) match = false;
-                    free(check_val);
-                } else {
-                    match = false;
-                }
-                if (!match) break;
-            }
-            if (!match) continue;
-            for (int d = 0; d < pq->delete_count; d++) {
-                char* del_var = pq->deletes[d];
-                int is_rel = 0;
-                int idx = -1;
-                for (int h = 0; h < pq->match->count; h++) {
-                    if (pq->match->nodes[h].var && strcmp(pq->match->nodes[h].var, del_var) == 0) {
-                        idx = h;
-                        break;
-                    }
-                }
-                if (idx == -1) {
-                    for (int r = 0; r < pq->match->count - 1; r++) {
-                        if (pq->match->rels[r].var && strcmp(pq->match->rels[r].var, del_var) == 0) {
-                            idx = r;
-                            is_rel = 1;
-                            break;
-                        }
-                    }
-                }
-                if (idx != -1) {
-                    if (is_rel) {
-                        char* from = mp->node_ids[idx];
-                        char* to = mp->node_ids[idx + 1];
-                        RelPattern* rp = &pq->match->rels[idx];
-                        if (rp->direction == '<') {
-                            char* temp = from;
-                            from = to;
-                            to = temp;
-                        }
-                        graphdb_delete_edge(gdb, from, to, rp->type ? rp->type : "");
-                    } else {
-                        graphdb_delete_node(gdb, mp->node_ids[idx]);
-                    }
-                }
-            }
-        }
-    } else if (pq->type == Q_MATCH_RETURN) {
-        for (int p = 0; p < num_paths; p++) {
-            MatchingPath* mp = paths[p];
-
-            bool match_ok = true;
-            // Evaluate WHERE conditions (same logic as before but without column structs)
-            for (int cond = 0; cond < pq->cond_count && match_ok; cond++) {
-                WhereCondition* wc = &pq->conditions[cond];
-                int hop_idx = -1;
-                bool is_rel_cond = false;
-                for (int h = 0; h < pq->match->count; h++) {
-                    if (pq->match->nodes[h].var && strcmp(pq->match->nodes[h].var, wc->var) == 0) { hop_idx = h; break; }
-                }
-                if (hop_idx == -1) {
-                    for (int r = 0; r < pq->match->count - 1; r++) {
-                        if (pq->match->rels[r].var && strcmp(pq->match->rels[r].var, wc->var) == 0) { hop_idx = r; is_rel_cond = true; break; }
-                    }
-                }
-                if (hop_idx == -1) { match_ok = false; break; }
-
-                char* check_val = NULL;
-                if (is_rel_cond) {
-                    char* rel_type = mp->rel_types[hop_idx];
-                    if (strcmp(wc->prop, "type") == 0) check_val = strdup(rel_type ? rel_type : "");
-                } else {
-                    int pos = mp->pattern_pos[hop_idx];
-                    char* node_id = mp->node_ids[pos];
-                    if (strcmp(wc->prop, "id") == 0) check_val = strdup(node_id);
-                    else if (strcmp(wc->prop, "label") == 0) check_val = graphdb_get_node_label(gdb, node_id);
-                }
-                if (!check_val || strcmp(check_val, wc->val) != 0) match_ok = false;
-                free(check_val);
-            }
-            if (!match_ok) continue;
-
-            // Build structured row
-            CypherRowResult row = {0};
-            row.node_count = mp->num_nodes;
-            row.nodes = (CypherNodeResult*)calloc(row.node_count, sizeof(CypherNodeResult));
-            for (int i = 0; i < row.node_count; i++) {
-                row.nodes[i].id = strdup(mp->node_ids[i]);
-                row.nodes[i].label = graphdb_get_node_label(gdb, mp->node_ids[i]);
-                // We can try to map var name if pattern_pos matches
-                for (int pat = 0; pat < pq->match->count; pat++) {
-                    if (mp->pattern_pos[pat] == i && pq->match->nodes[pat].var) {
-                        row.nodes[i].var = strdup(pq->match->nodes[pat].var);
-                        break;
-                    }
-                }
-            }
+// The operators of one query, inputs before the operators they feed. Only
+// PROFILE (`analyze`) runs the query and counts; EXPLAIN stops once the
+// operators are built.
+typedef struct {
+    ProfileOp* ops;
+    int count;
+    int capacity;
+    bool analyze;
+} Profile;
 
-            row.edge_count = mp->num_rels;
-            row.edges = (CypherEdgeResult*)calloc(row.edge_count, sizeof(CypherEdgeResult));
-            for (int i = 0; i < row.edge_count; i++) {
-                row.edges[i].from_id = strdup(mp->node_ids[i]);
-                row.edges[i].to_id = strdup(mp->node_ids[i+1]);
-                row.edges[i].type = strdup(mp->rel_types[i] ? mp->rel_types[i] : "");
-                // var name mapping - safe for variable length
-                if (i < pq->match->count - 1 && pq->match->rels[i].var) {
-                    row.edges[i].var = strdup(pq->match->rels[i].var);
-                }
-            }
+// Counters at the start of a measured call
+typedef struct {
+    long long ns;
+    GraphIOStats io;
+    size_t bytes;
+} ProfileMark;
 
-            // Append to result
-            result->rows = (CypherRowResult*)realloc(result->rows, sizeof(CypherRowResult) * (result->row_count + 1));
-            result->rows[result->row_count++] = row;
-        }
+// Registers an operator and returns its index, or -1 without a profile.
+// Takes `detail` (malloc'ed, may be NULL).
+static int profile_add(Profile* profile, const char* name, char* detail, int input, bool nested) {
+    if (!profile) {
+        free(detail);
+        return -1;
     }
-
-    // Cleanup paths
-    for (int p = 0; p < num_paths; p++) {
-        for (int h = 0; h < paths[p]->num_nodes; h++) free(paths[p]->node_ids[h]);
-        free(paths[p]->node_ids);
-        free(paths[p]->pattern_pos);
-        for (int h = 0; h < paths[p]->num_rels; h++) free(paths[p]->rel_types[h]);
-        free(paths[p]->rel_types);
-        free(paths[p]);
+    if (profile->count == profile->capacity) {
+        profile->capacity = profile->capacity ? profile->capacity * 2 : 16;
+        profile->ops = realloc(profile->ops, profile->capacity * sizeof(ProfileOp));
     }
-    free(paths);
+    ProfileOp* op = &profile->ops[profile->count];
+    memset(op, 0, sizeof(ProfileOp));
+    op->name = name;
+    op->detail = detail;
+    op->input = input;
+    op->nested = nested;
+    return profile->count++;
+}
 
-    return result;
+static void profile_free(Profile* profile) {
+    for (int i = 0; i < profile->count; i++) free(profile->ops[i].detail);
+    free(profile->ops);
 }
 
-// Simple pretty-printer for the new structured result
-void print_cypher_result(const CypherResult* result) {
-    if (!result || result->row_count == 0) {
-        printf("No results\n");
-        return;
-    }
+// Rows passed on by an operator whose own work is not worth timing
+static void profile_count(Profile* profile, int op, long long rows) {
+    if (profile && profile->analyze && op >= 0) profile->ops[op].rows += rows;
+}
 
-    for (int r = 0; r < result->row_count; r++) {
-        const CypherRowResult* row = &result->rows[r];
-        for (int n = 0; n < row->node_count; n++) {
-            const CypherNodeResult* node = &row->nodes[n];
-            printf("(%s:%s)", node->id, node->label ? node->label : "");
-            if (n < row->edge_count) {
-                const CypherEdgeResult* edge = &row->edges[n];
-                printf("-[:%s]->", edge->type ? edge->type : "");
-            }
-        }
-        printf("\n");
-    }
+static bool profile_plan_only(const Profile* profile) {
+    return profile && !profile->analyze;
 }
 
-CypherResult* execute_cypher(GraphDB* gdb, const char* query) {
-    ParsedQuery* pq = parse_cypher(query);
-    if (!pq) {
-        return (CypherResult*)calloc(1, sizeof(CypherResult));
-    }
-    CypherResult* result = execute_parsed_query(gdb, pq);
-    // Free pq
-    if (pq->returns) {
-        for (int i = 0; i < pq->return_count; i++) free(pq->returns[i]);
-        free(pq->returns);
-    }
-    if (pq->deletes) {
-        for (int i = 0; i < pq->delete_count; i++) free(pq->deletes[i]);
-        free(pq->deletes);
+static long long profile_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void profile_enter(const Profile* profile, ProfileMark* mark) {
+    if (!profile || !profile->analyze) return;
+    graphdb_io_stats(&mark->io);
+    mark->bytes = cypher_arena_allocated();
+    mark->ns = profile_clock();
+}
+
+// Charges the calling thread's work since `mark` to operator `op`
+static void profile_leave(Profile* profile, int op, const ProfileMark* mark, long long rows) {
+    if (!profile || !profile->analyze || op < 0) return;
+    long long now = profile_clock();
+    GraphIOStats io;
+    graphdb_io_stats(&io);
+    ProfileOp* o = &profile->ops[op];
+    o->rows += rows;
+    o->ns += now - mark->ns;
+    o->bytes += cypher_arena_allocated() - mark->bytes;
+    o->io.seeks += io.seeks - mark->io.seeks;
+    o->io.nexts += io.nexts - mark->io.nexts;
+    o->io.gets += io.gets - mark->io.gets;
+    o->io.get_bytes += io.get_bytes - mark->io.get_bytes;
+    o->io.block_reads += io.block_reads - mark->io.block_reads;
+    o->io.cache_hits += io.cache_hits - mark->io.cache_hits;
+}
+
+// Zeroed counters for the operators registered so far, for a worker
+// thread; profile_merge adds them back
+static Profile* profile_fork(const Profile* profile) {
+    Profile* fork = calloc(1, sizeof(Profile));
+    fork->ops = calloc(profile->count > 0 ? profile->count : 1, sizeof(ProfileOp));
+    fork->count = fork->capacity = profile->count;
+    fork->analyze = true;
+    return fork;
+}
+
+static void profile_merge(Profile* profile, Profile* fork) {
+    if (!fork) return;
+    for (int i = 0; i < fork->count; i++) {
+        ProfileOp* o = &profile->ops[i];
+        const ProfileOp* f = &fork->ops[i];
+        o->rows += f->rows;
+        o->ns += f->ns;
+        o->bytes += f->bytes;
+        o->io.seeks += f->io.seeks;
+        o->io.nexts += f->io.nexts;
+        o->io.gets += f->io.gets;
+        o->io.get_bytes += f->io.get_bytes;
+        o->io.block_reads += f->io.block_reads;
+        o->io.cache_hits += f->io.cache_hits;
     }
-    if (pq->match) {
-        for (int i = 0; i < pq->match->count; i++) {
-            free(pq->match->nodes[i].var);
-            free(pq->match->nodes[i].label);
-            free(pq->match->nodes[i].prop_key);
-            free(pq->match->nodes[i].prop_value);
-        }
-        free(pq->match->nodes);
-        for (int i = 0; i < pq->match->count - 1; i++) {
-            free(pq->match->rels[i].var);
-            free(pq->match->rels[i].type);
-        }
-        free(pq->match->rels);
-        free(pq->match);
+    free(fork->ops);
+    free(fork);
+}
+
+// "(a:Person {id: 'x'})"
+static void describe_node(FILE* out, const NodePattern* np) {
+    fprintf(out, "(%s", np->var ? np->var : "");
+    if (np->label) fprintf(out, ":%s", np->label);
+    if (pattern_node_id(np)) fprintf(out, " {id: '%s'}", pattern_node_id(np));
+    fputc(')', out);
+}
+
+// "-[r:T*1..3]->", as written in the pattern
+static void describe_rel(FILE* out, const RelPattern* rp) {
+    if (rp->direction == ',') {
+        fputs(", ", out);
+        return;
     }
-    if (pq->conditions) {
-        for (int i = 0; i < pq->cond_count; i++) {
-            free(pq->conditions[i].var);
-            free(pq->conditions[i].prop);
-            free(pq->conditions[i].val);
-        }
-        free(pq->conditions);
+    fprintf(out, "%s[%s", rp->direction == '<' ? "<-" : "-", rp->var ? rp->var : "");
+    if (rp->type) fprintf(out, ":%s", rp->type);
+    if (rp->min_hops != 1 || rp->max_hops != 1) {
+        fprintf(out, "*%d..", rp->min_hops);
+        if (rp->max_hops >= 0) fprintf(out, "%d", rp->max_hops);
     }
-    free(pq);
-    return result;
+    fprintf(out, "]%s", rp->direction == '>' ? "->" : "-");
 }
 
-/***************************************
- * NEW STRUCTURED RESULT IMPLEMENTATION *
- ***************************************/
-
-// Allocate an empty raw result helper
-static CypherResult* cypher_result_create() {
-    CypherResult* res = (CypherResult*)calloc(1, sizeof(CypherResult));
-    return res;
+static void describe_conditions(FILE* out, const char* sep, const WhereCondition** conds, int count) {
+    for (int i = 0; i < count; i++) {
+        const WhereCondition* wc = conds[i];
+        fprintf(out, "%s%s.%s = '%s'", i == 0 ? sep : " AND ", wc->var, wc->prop, wc->val ? wc->val : "");
+    }
 }
 
-// Free result helper (public via header)
-void free_cypher_result(CypherResult* result) {
-    if (!result) return;
-    for (int r = 0; r < result->row_count; r++) {
-        CypherRowResult* row = &result->rows[r];
-        for (int n = 0; n < row->node_count; n++) {
-            free(row->nodes[n].var);
-            free(row->nodes[n].id);
-            free(row->nodes[n].label);
-        }
-        free(row->nodes);
-        for (int e = 0; e < row->edge_count; e++) {
-            free(row->edges[e].var);
-            free(row->edges[e].from_id);
-            free(row->edges[e].to_id);
-            free(row->edges[e].type);
-        }
-        free(row->edges);
+static char* describe_path(const PathPattern* path) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) return NULL;
+    for (int h = 0; h < path->count; h++) {
+        if (h > 0) describe_rel(out, &path->rels[h - 1]);
+        describe_node(out, &path->nodes[h]);
     }
-    free(result->rows);
-    free(result);
+    fclose(out);
+    return text;
 }
 
-// Simple JSON serializer for D3.js - produces { "nodes": [{ "id": "...", "label": "..." }], "links": [{ "source": "...", "target": "...", "type": "..." }] }
-// Merges all rows into one graph, deduplicating nodes by id.
-char* cypher_result_to_d3_json(const CypherResult* result) {
-    if (!result || result->row_count == 0) return strdup("{ \"nodes\": [], \"links\": [] }");
+// "a, b.id, count(*)"
+static char* describe_items(char** items, int count) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) return NULL;
+    for (int i = 0; i < count; i++) fprintf(out, "%s%s", i > 0 ? ", " : "", items[i]);
+    fclose(out);
+    return text;
+}
 
-    // Collect unique nodes with hash set for dedup (simpler than loop)
-    // Note: For production, use a real hash table; this is naive
-    char** unique_ids = NULL;
-    char** unique_labels = NULL;
-    int unique_count = 0;
+static char* describe_text(const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return strdup(buf);
+}
 
-    typedef struct { char* source; char* target; char* type; } Link;
-    Link* links = NULL;
-    int link_count = 0;
+/*******************************
+ * Batch execution
+ *******************************/
 
-    for (int r = 0; r < result->row_count; r++) {
-        const CypherRowResult* row = &result->rows[r];
-        if (!row) continue;
+// Tuples moved between batch operators per call
+#define BATCH_SIZE 1024
 
-        for (int n = 0; n < row->node_count; n++) {
-            const CypherNodeResult* node = &row->nodes[n];
-            if (!node || !node->id) continue;
+// Column-major tuples: node column c of tuple i is nodes[c * BATCH_SIZE + i],
+// relationship column r of tuple i is rels[r * BATCH_SIZE + i]
+typedef struct {
+    int count;
+    int* nodes;
+    int* rels;
+} TupleBatch;
 
-            bool exists = false;
-            for (int u = 0; u < unique_count; u++) {
-                if (strcmp(unique_ids[u], node->id) == 0) { exists = true; break; }
-            }
-            if (!exists) {
-                unique_ids = realloc(unique_ids, (unique_count + 1) * sizeof(char*));
-                unique_labels = realloc(unique_labels, (unique_count + 1) * sizeof(char*));
-                if (!unique_ids || !unique_labels) { /* Handle realloc failure */ return strdup("{ \"error\": \"Memory error\" }"); }
-                unique_ids[unique_count] = strdup(node->id);
-                unique_labels[unique_count] = strdup(node->label ? node->label : "");
-                unique_count++;
-            }
-        }
+typedef enum { BATCH_SCAN, BATCH_EXPAND, BATCH_FILTER } BatchOpKind;
 
-        for (int e = 0; e < row->edge_count; e++) {
-            const CypherEdgeResult* edge = &row->edges[e];
-            if (!edge || !edge->from_id || !edge->to_id) continue;
+// One physical operator. Nodes lo..hi (and the relationships between them)
+// are bound in its output; the other columns hold garbage. next() never
+// returns an empty batch, and a returned batch stays valid until the
+// operator's following call.
+typedef struct BatchOp {
+    BatchOpKind kind;
+    struct BatchOp* input;
+    int lo, hi;
+    TupleBatch out;
+    // Scan (NodeScan, or LabelScan when `label` is set) fills column lo,
+    // or emits the `feed` ids once when they are set (a parallel morsel)
+    const char* pinned;
+    const char* label;
+    char* scan_after;
+    bool more;
+    char** feed;
+    int feed_count;
+    // Expand: src -> dst over relationship column `rel`
+    int src, dst, rel;
+    const char* type;
+    GraphDirection dir;
+    const TupleBatch* in;
+    int in_next;
+    NeighborBuffer nbrs;
+    int nbr_next;
+    // Filter on node column `col` and, when rel >= 0, the relationship that bound it
+    int col;
+    int want_label;    // label index + 1, 0 for any
+    int pinned_id;     // -1 for none
+    const PositionFilter* node_filter;
+    const PositionFilter* rel_filter;
+    int* node_vals;    // per node condition: interned id or label index (+1)
+    int* rel_vals;     // per relationship condition: interned type
+    int* sel;          // selection vector over the input batch
+    // Counted as operator `prof` of `profile` (PROFILE only)
+    Profile* profile;
+    int prof;
+} BatchOp;
 
-            links = realloc(links, (link_count + 1) * sizeof(Link));
-            if (!links) return strdup("{ \"error\": \"Memory error\" }");
-            links[link_count].source = strdup(edge->from_id);
-            links[link_count].target = strdup(edge->to_id);
-            links[link_count].type = strdup(edge->type ? edge->type : "");
-            link_count++;
-        }
-    }
+// Scan, Filter and Expand operators for a fixed-length pattern, followed by
+// the Project step that turns the root's tuples back into a MatchingPath
+typedef struct {
+    IdDict dict;
+    BatchOp* ops;
+    int op_count;      // ops[op_count - 1] is the root
+    int count;         // pattern nodes
+    const TupleBatch* batch;
+    int next;
+    char** node_ids;
+    char** rel_types;
+    int* positions;
+} BatchPipeline;
 
-    // Build JSON with dynamic buffer
-    char* json = NULL;
-    size_t len = 0;
-    FILE* stream = open_memstream(&json, &len);
-    if (!stream) return strdup("{ \"error\": \"Memory error\" }");
+static void batch_alloc(TupleBatch* b, int count) {
+    b->nodes = malloc((size_t)count * BATCH_SIZE * sizeof(int));
+    b->rels = malloc((size_t)(count > 1 ? count - 1 : 1) * BATCH_SIZE * sizeof(int));
+}
+
+static const TupleBatch* batch_op_next(IdDict* d, BatchOp* op);
 
-    fprintf(stream, "{ \"nodes\": ["); 
-    for (int u = 0; u < unique_count; u++) {
-        fprintf(stream, "{\"id\":\"%s\",\"label\":\"%s\"}", unique_ids[u], unique_labels[u]);
-        if (u < unique_count - 1) fprintf(stream, ",");
+static const TupleBatch* scan_next(IdDict* d, BatchOp* op) {
+    TupleBatch* out = &op->out;
+    int* col = out->nodes + op->lo * BATCH_SIZE;
+    out->count = 0;
+    if (!op->more) return NULL;
+    if (op->pinned) {
+        op->more = false;
+        col[0] = id_dict_intern(d->ids, op->pinned);
+        out->count = 1;
+        return out;
+    }
+    if (op->feed) {
+        op->more = false;
+        for (int i = 0; i < op->feed_count; i++) col[i] = id_dict_intern(d->ids, op->feed[i]);
+        out->count = op->feed_count;
+        return out->count > 0 ? out : NULL;
+    }
+    int count = 0;
+    char** node_ids = graphdb_scan_nodes(d->gdb, op->label, op->scan_after, BATCH_SIZE, &count);
+    for (int i = 0; i < count; i++) {
+        col[i] = id_dict_intern(d->ids, node_ids[i]);
+        free(node_ids[i]);
     }
-    fprintf(stream, "], \"links\": ["); 
-    for (int l = 0; l < link_count; l++) {
-        fprintf(stream, "{\"source\":\"%s\",\"target\":\"%s\",\"type\":\"%s\"}", links[l].source, links[l].target, links[l].type);
-        if (l < link_count - 1) fprintf(stream, ",");
+    free(node_ids);
+    op->more = count == BATCH_SIZE;
+    if (op->more) {
+        free(op->scan_after);
+        op->scan_after = strdup(id_dict_key(d->ids, col[count - 1]));
     }
-    fprintf(stream, "] }");
-    fclose(stream);  // Flushes to json
+    out->count = count;
+    return count > 0 ? out : NULL;
+}
 
-    // Cleanup
-    for (int u = 0; u < unique_count; u++) { free(unique_ids[u]); free(unique_labels[u]); }
-    free(unique_ids); free(unique_labels);
-    for (int l = 0; l < link_count; l++) { free(links[l].source); free(links[l].target); free(links[l].type); }
-    free(links);
+// Emits every (input tuple, neighbor) pair in input order; a source tuple's
+// bound columns are broadcast over the run of its neighbors
+static const TupleBatch* expand_next(IdDict* d, BatchOp* op) {
+    TupleBatch* out = &op->out;
+    out->count = 0;
+    while (out->count < BATCH_SIZE) {
+        if (op->nbr_next >= op->nbrs.count) {
+            if (!op->in || op->in_next >= op->in->count) {
+                op->in = batch_op_next(d, op->input);
+                op->in_next = 0;
+                if (!op->in) break;
+            }
+            id_dict_neighbors(d, op->in->nodes[op->src * BATCH_SIZE + op->in_next++], op->type, op->dir, &op->nbrs);
+            op->nbr_next = 0;
+            continue;
+        }
+        const TupleBatch* in = op->in;
+        int src = op->in_next - 1;
+        int take = op->nbrs.count - op->nbr_next;
+        if (take > BATCH_SIZE - out->count) take = BATCH_SIZE - out->count;
+        int at = out->count;
+        for (int c = op->input->lo; c <= op->input->hi; c++) {
+            int v = in->nodes[c * BATCH_SIZE + src];
+            int* dst = out->nodes + c * BATCH_SIZE + at;
+            for (int i = 0; i < take; i++) dst[i] = v;
+        }
+        for (int r = op->input->lo; r < op->input->hi; r++) {
+            int v = in->rels[r * BATCH_SIZE + src];
+            int* dst = out->rels + r * BATCH_SIZE + at;
+            for (int i = 0; i < take; i++) dst[i] = v;
+        }
+        memcpy(out->nodes + op->dst * BATCH_SIZE + at, op->nbrs.ids + op->nbr_next, take * sizeof(int));
+        memcpy(out->rels + op->rel * BATCH_SIZE + at, op->nbrs.types + op->nbr_next, take * sizeof(int));
+        out->count += take;
+        op->nbr_next += take;
+    }
+    return out->count > 0 ? out : NULL;
+}
 
-    return json;
+// Narrows the selection vector one predicate at a time, then compacts the
+// surviving tuples into the output batch
+static const TupleBatch* filter_next(IdDict* d, BatchOp* op) {
+    TupleBatch* out = &op->out;
+    int* sel = op->sel;
+    for (;;) {
+        const TupleBatch* in = batch_op_next(d, op->input);
+        if (!in) return NULL;
+        const int* col = in->nodes + op->col * BATCH_SIZE;
+        int n = 0;
+        for (int i = 0; i < in->count; i++) {
+            int label = id_dict_label(d, col[i]);
+            if (label > 0 && (!op->want_label || label == op->want_label)) sel[n++] = i;
+        }
+        if (op->pinned_id >= 0) {
+            int k = 0;
+            for (int i = 0; i < n; i++) if (col[sel[i]] == op->pinned_id) sel[k++] = sel[i];
+            n = k;
+        }
+        for (int f = 0; op->rel_filter && f < op->rel_filter->count; f++) {
+            const int* rels = in->rels + op->rel * BATCH_SIZE;
+            int want = op->rel_vals[f], k = 0;
+            for (int i = 0; i < n; i++) if (rels[sel[i]] == want) sel[k++] = sel[i];
+            n = k;
+        }
+        for (int f = 0; f < op->node_filter->count; f++) {
+            const WhereCondition* wc = op->node_filter->conds[f];
+            int want = op->node_vals[f], k = 0;
+            if (strcmp(wc->prop, "id") == 0) {
+                for (int i = 0; i < n; i++) if (col[sel[i]] == want) sel[k++] = sel[i];
+            } else if (strcmp(wc->prop, "label") == 0) {
+                for (int i = 0; i < n; i++) if (id_dict_label(d, col[sel[i]]) == want) sel[k++] = sel[i];
+            } else {
+                for (int i = 0; i < n; i++) {
+                    char* value = graphdb_get_node_property(d->gdb, id_dict_key(d->ids, col[sel[i]]), wc->prop);
+                    if (value && strcmp(value, wc->val) == 0) sel[k++] = sel[i];
+                    free(value);
+                }
+            }
+            n = k;
+        }
+        if (n == 0) continue;
+        for (int c = op->lo; c <= op->hi; c++) {
+            const int* src = in->nodes + c * BATCH_SIZE;
+            int* dst = out->nodes + c * BATCH_SIZE;
+            for (int i = 0; i < n; i++) dst[i] = src[sel[i]];
+        }
+        for (int r = op->lo; r < op->hi; r++) {
+            const int* src = in->rels + r * BATCH_SIZE;
+            int* dst = out->rels + r * BATCH_SIZE;
+            for (int i = 0; i < n; i++) dst[i] = src[sel[i]];
+        }
+        out->count = n;
+        return out;
+    }
+}
+
+static const TupleBatch* batch_op_next(IdDict* d, BatchOp* op) {
+    ProfileMark mark;
+    profile_enter(op->profile, &mark);
+    const TupleBatch* out;
+    switch (op->kind) {
+        case BATCH_SCAN: out = scan_next(d, op); break;
+        case BATCH_EXPAND: out = expand_next(d, op); break;
+        default: out = filter_next(d, op); break;
+    }
+    profile_leave(op->profile, op->prof, &mark, out ? out->count : 0);
+    return out;
+}
+
+static BatchOp* batch_pipeline_add(BatchPipeline* p, BatchOpKind kind, int lo, int hi) {
+    BatchOp* op = &p->ops[p->op_count];
+    op->kind = kind;
+    op->input = p->op_count > 0 ? &p->ops[p->op_count - 1] : NULL;
+    op->lo = lo;
+    op->hi = hi;
+    op->rel = -1;
+    op->pinned_id = -1;
+    op->prof = -1;
+    batch_alloc(&op->out, p->count);
+    p->op_count++;
+    return op;
+}
+
+// Checks pattern node `hop` (and relationship `rel` that bound it, or -1)
+static void batch_pipeline_filter(BatchPipeline* p, const PathPattern* path, const PatternFilters* filters, int hop, int rel) {
+    BatchOp* prev = &p->ops[p->op_count - 1];
+    BatchOp* op = batch_pipeline_add(p, BATCH_FILTER, prev->lo, prev->hi);
+    const NodePattern* np = &path->nodes[hop];
+    op->col = hop;
+    op->rel = rel;
+    if (np->label) op->want_label = id_dict_intern(p->dict.labels, np->label) + 1;
+    if (pattern_node_id(np)) op->pinned_id = id_dict_intern(p->dict.ids, pattern_node_id(np));
+    op->node_filter = &filters->nodes[hop];
+    op->node_vals = malloc((op->node_filter->count + 1) * sizeof(int));
+    for (int f = 0; f < op->node_filter->count; f++) {
+        const WhereCondition* wc = op->node_filter->conds[f];
+        if (strcmp(wc->prop, "id") == 0) op->node_vals[f] = id_dict_intern(p->dict.ids, wc->val);
+        else if (strcmp(wc->prop, "label") == 0) op->node_vals[f] = id_dict_intern(p->dict.labels, wc->val) + 1;
+    }
+    if (rel >= 0) {
+        op->rel_filter = &filters->rels[rel];
+        op->rel_vals = malloc((op->rel_filter->count + 1) * sizeof(int));
+        for (int f = 0; f < op->rel_filter->count; f++) op->rel_vals[f] = id_dict_intern(p->dict.types, op->rel_filter->conds[f]->val);
+    }
+    op->sel = malloc(BATCH_SIZE * sizeof(int));
+}
+
+static void batch_pipeline_expand(BatchPipeline* p, const PathPattern* path, int rel, int reverse) {
+    BatchOp* prev = &p->ops[p->op_count - 1];
+    BatchOp* op = batch_pipeline_add(p, BATCH_EXPAND, reverse ? rel : prev->lo, reverse ? prev->hi : rel + 1);
+    const RelPattern* rp = &path->rels[rel];
+    op->src = reverse ? rel + 1 : rel;
+    op->dst = reverse ? rel : rel + 1;
+    op->rel = rel;
+    op->type = rp->type ? rp->type : "";
+    op->dir = rel_walk_direction(rp, reverse);
+}
+
+// Only patterns whose hops all have a fixed length run as batches
+static bool batch_supported(const PathPattern* path) {
+    for (int r = 0; r < path->count - 1; r++) {
+        if (path->rels[r].min_hops != path->rels[r].max_hops) return false;
+    }
+    return true;
+}
+
+// Scan the anchor, expand to the right end, then back to nodes[0], filtering
+// every node as soon as it is bound
+static BatchPipeline* batch_pipeline_create(GraphDB* gdb, const PathPattern* path, const PatternFilters* filters, int anchor) {
+    int n = path->count;
+    BatchPipeline* p = calloc(1, sizeof(BatchPipeline));
+    id_dict_init(&p->dict, gdb);
+    p->count = n;
+    p->ops = calloc(2 * n, sizeof(BatchOp));
+    BatchOp* scan = batch_pipeline_add(p, BATCH_SCAN, anchor, anchor);
+    scan->pinned = pattern_node_id(&path->nodes[anchor]);
+    scan->label = path->nodes[anchor].label;
+    scan->more = true;
+    batch_pipeline_filter(p, path, filters, anchor, -1);
+    for (int r = anchor; r < n - 1; r++) {
+        batch_pipeline_expand(p, path, r, 0);
+        batch_pipeline_filter(p, path, filters, r + 1, r);
+    }
+    for (int r = anchor - 1; r >= 0; r--) {
+        batch_pipeline_expand(p, path, r, 1);
+        batch_pipeline_filter(p, path, filters, r, r);
+    }
+    p->node_ids = malloc(n * sizeof(char*));
+    p->rel_types = malloc(n * sizeof(char*));
+    p->positions = malloc(n * sizeof(int));
+    for (int h = 0; h < n; h++) p->positions[h] = h;
+    return p;
+}
+
+// Registers the pipeline's operators with `profile`, scan first. A
+// `morsels` scan is fed its ids by a parallel scan.
+static void batch_pipeline_profile(BatchPipeline* p, const PathPattern* path, Profile* profile, bool morsels) {
+    for (int i = 0; i < p->op_count; i++) {
+        BatchOp* op = &p->ops[i];
+        int input = op->input ? op->input->prof : -1;
+        char* text = NULL;
+        size_t len = 0;
+        FILE* out = open_memstream(&text, &len);
+        if (!out) continue;
+        const char* name;
+        if (op->kind == BATCH_SCAN) {
+            name = morsels ? "MorselScan" : op->pinned ? "NodeByIdSeek" : op->label ? "NodeByLabelScan" : "AllNodesScan";
+            describe_node(out, &path->nodes[op->lo]);
+        } else if (op->kind == BATCH_EXPAND) {
+            name = "Expand";
+            const char* src = path->nodes[op->src].var;
+            const char* dst = path->nodes[op->dst].var;
+            fprintf(out, "(%s)%s[%s%s]%s(%s)", src ? src : "", op->dir == GRAPHDB_DIR_IN ? "<-" : "-", *op->type ? ":" : "",
+                    op->type, op->dir == GRAPHDB_DIR_OUT ? "->" : "-", dst ? dst : "");
+        } else {
+            name = "Filter";
+            describe_node(out, &path->nodes[op->col]);
+            describe_conditions(out, " WHERE ", op->node_filter->conds, op->node_filter->count);
+            if (op->rel_filter) describe_conditions(out, op->node_filter->count ? " AND " : " WHERE ", op->rel_filter->conds, op->rel_filter->count);
+        }
+        fclose(out);
+        op->profile = profile;
+        op->prof = profile_add(profile, name, text, input, input >= 0);
+    }
+}
+
+static void batch_pipeline_destroy(BatchPipeline* p) {
+    if (!p) return;
+    for (int i = 0; i < p->op_count; i++) {
+        BatchOp* op = &p->ops[i];
+        free(op->out.nodes);
+        free(op->out.rels);
+        free(op->scan_after);
+        neighbor_buffer_free(&op->nbrs);
+        free(op->node_vals);
+        free(op->rel_vals);
+        free(op->sel);
+    }
+    free(p->ops);
+    id_dict_free(&p->dict);
+    free(p->node_ids);
+    free(p->rel_types);
+    free(p->positions);
+    free(p);
+}
+
+// Project: binds the next root tuple's ids and types into `mp` (strings owned
+// by the dictionaries); false once the pipeline is drained
+static bool batch_pipeline_next(BatchPipeline* p, MatchingPath* mp) {
+    if (!p->batch || p->next >= p->batch->count) {
+        p->batch = batch_op_next(&p->dict, &p->ops[p->op_count - 1]);
+        p->next = 0;
+        if (!p->batch) return false;
+    }
+    int i = p->next++;
+    for (int h = 0; h < p->count; h++) p->node_ids[h] = (char*)id_dict_key(p->dict.ids, p->batch->nodes[h * BATCH_SIZE + i]);
+    for (int r = 0; r < p->count - 1; r++) p->rel_types[r] = (char*)id_dict_key(p->dict.types, p->batch->rels[r * BATCH_SIZE + i]);
+    mp->node_ids = p->node_ids;
+    mp->num_nodes = p->count;
+    mp->pattern_pos = p->positions;
+    mp->rel_types = p->rel_types;
+    mp->num_rels = p->count - 1;
+    return true;
+}
+
+/*******************************
+ * Parallel scans
+ *******************************/
+
+// Morsels a worker may run ahead of the consumer, per worker
+#define MORSEL_WINDOW 2
+
+// Threads expanding an unpinned anchor scan, set with cypher_set_query_threads
+static int query_threads(GraphDB* gdb) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    int threads = gdb->query_threads;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+    if (threads > 0) return threads;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+void cypher_set_query_threads(GraphDB* gdb, int threads) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    gdb->query_threads = threads > 0 ? threads : 0;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+}
+
+// The paths one morsel of anchor ids expanded to, row-major: row i binds
+// node_ids[i * count ...] and rel_types[i * (count - 1) ...]. The strings
+// live in the worker's dictionaries.
+typedef struct Morsel {
+    int seq;
+    int rows;
+    int capacity;
+    char** node_ids;
+    char** rel_types;
+    struct Morsel* next;
+} Morsel;
+
+typedef struct ParallelScan ParallelScan;
+
+typedef struct {
+    ParallelScan* scan;
+    pthread_t thread;
+    BatchPipeline* pipeline;
+    Profile* profile;        // the worker's share of the pipeline's counters
+} ScanWorker;
+
+// Morsel-driven execution of a batch pipeline whose anchor is a label (or
+// all-node) scan. Workers take the next BATCH_SIZE ids of the key range,
+// expand them through a private pipeline (own dictionaries and buffers) and
+// publish the rows as a morsel. Whichever worker is free takes the next
+// morsel, so a hub-heavy range does not hold up the others. Ordered scans
+// hand morsels to the consumer by sequence number, which reproduces the
+// serial order; unordered ones as they finish. Workers stay at most
+// MORSEL_WINDOW morsels each ahead of the consumer. They start on the first
+// call to parallel_scan_next.
+struct ParallelScan {
+    GraphDB* gdb;
+    const PathPattern* path;
+    const PatternFilters* filters;
+    int anchor;
+    bool ordered;
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;    // a morsel finished, or the range ran out
+    pthread_cond_t space;    // the consumer took a morsel, or stop was set
+    char* after;             // last id handed out
+    bool exhausted;
+    bool stop;
+    int next_seq;            // morsels handed out
+    int taken;               // morsels taken by the consumer
+    int window;
+    Morsel* finished;
+    ScanWorker* workers;
+    int worker_count;
+    bool started;
+    Morsel* current;
+    int row;
+    int* positions;
+    Profile* profile;
+};
+
+static void morsel_free(Morsel* morsel) {
+    if (!morsel) return;
+    free(morsel->node_ids);
+    free(morsel->rel_types);
+    free(morsel);
+}
+
+// Next run of anchor ids, or NULL once the range is done or the scan stops
+static char** parallel_scan_claim(ParallelScan* s, int* count, int* seq) {
+    char** ids = NULL;
+    *count = 0;
+    pthread_mutex_lock(&s->mutex);
+    while (!s->stop && !s->exhausted && s->next_seq - s->taken >= s->window) pthread_cond_wait(&s->space, &s->mutex);
+    if (!s->stop && !s->exhausted) {
+        ids = graphdb_scan_nodes(s->gdb, s->path->nodes[s->anchor].label, s->after, BATCH_SIZE, count);
+        if (*count < BATCH_SIZE) s->exhausted = true;
+        if (*count > 0) {
+            free(s->after);
+            s->after = strdup(ids[*count - 1]);
+            *seq = s->next_seq++;
+        }
+        if (s->exhausted) pthread_cond_broadcast(&s->ready);
+    }
+    pthread_mutex_unlock(&s->mutex);
+    if (*count == 0) {
+        free(ids);
+        return NULL;
+    }
+    return ids;
+}
+
+static void* scan_worker_main(void* arg) {
+    ScanWorker* w = (ScanWorker*)arg;
+    ParallelScan* s = w->scan;
+    BatchPipeline* p = w->pipeline;
+    BatchOp* scan = &p->ops[0];
+    int n = p->count;
+    int count, seq;
+    char** ids;
+    if (s->profile) {
+        w->profile = profile_fork(s->profile);
+        for (int i = 0; i < p->op_count; i++) p->ops[i].profile = w->profile;
+        graphdb_io_perf(1);
+    }
+    while ((ids = parallel_scan_claim(s, &count, &seq))) {
+        Morsel* morsel = calloc(1, sizeof(Morsel));
+        morsel->seq = seq;
+        scan->feed = ids;
+        scan->feed_count = count;
+        scan->more = true;
+        MatchingPath mp;
+        while (batch_pipeline_next(p, &mp)) {
+            if (morsel->rows == morsel->capacity) {
+                morsel->capacity = morsel->capacity ? morsel->capacity * 2 : BATCH_SIZE;
+                morsel->node_ids = realloc(morsel->node_ids, (size_t)morsel->capacity * n * sizeof(char*));
+                morsel->rel_types = realloc(morsel->rel_types, (size_t)morsel->capacity * (n > 1 ? n - 1 : 1) * sizeof(char*));
+            }
+            memcpy(morsel->node_ids + (size_t)morsel->rows * n, mp.node_ids, n * sizeof(char*));
+            memcpy(morsel->rel_types + (size_t)morsel->rows * (n - 1), mp.rel_types, (n - 1) * sizeof(char*));
+            morsel->rows++;
+        }
+        scan->feed = NULL;
+        for (int i = 0; i < count; i++) free(ids[i]);
+        free(ids);
+
+        pthread_mutex_lock(&s->mutex);
+        morsel->next = s->finished;
+        s->finished = morsel;
+        pthread_cond_broadcast(&s->ready);
+        pthread_mutex_unlock(&s->mutex);
+    }
+    if (s->profile) graphdb_io_perf(0);
+    return NULL;
+}
+
+// Whether `path` should run as a parallel scan: its anchor is scanned rather
+// than pinned, and the scan spans more than one morsel
+static bool parallel_scan_worthwhile(GraphDB* gdb, const PathPattern* path, int anchor, int threads) {
+    if (threads < 2 || pattern_node_id(&path->nodes[anchor])) return false;
+    return graphdb_count_nodes(gdb, path->nodes[anchor].label, BATCH_SIZE + 1) > BATCH_SIZE;
+}
+
+static ParallelScan* parallel_scan_create(GraphDB* gdb, const PathPattern* path, const PatternFilters* filters, int anchor, int threads, bool ordered, Profile* profile) {
+    ParallelScan* s = calloc(1, sizeof(ParallelScan));
+    s->gdb = gdb;
+    s->path = path;
+    s->filters = filters;
+    s->anchor = anchor;
+    s->ordered = ordered;
+    s->window = threads * MORSEL_WINDOW;
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->ready, NULL);
+    pthread_cond_init(&s->space, NULL);
+    s->positions = malloc(path->count * sizeof(int));
+    for (int h = 0; h < path->count; h++) s->positions[h] = h;
+    s->workers = calloc(threads, sizeof(ScanWorker));
+    s->worker_count = threads;
+    for (int w = 0; w < threads; w++) {
+        s->workers[w].scan = s;
+        s->workers[w].pipeline = batch_pipeline_create(gdb, path, filters, anchor);
+    }
+    if (profile) {
+        // One set of operators stands for every worker's pipeline
+        BatchPipeline* first = s->workers[0].pipeline;
+        batch_pipeline_profile(first, path, profile, true);
+        for (int w = 1; w < threads; w++) {
+            for (int i = 0; i < first->op_count; i++) s->workers[w].pipeline->ops[i].prof = first->ops[i].prof;
+        }
+        s->profile = profile;
+    }
+    return s;
+}
+
+static void parallel_scan_start(ParallelScan* s) {
+    s->started = true;
+    for (int w = 0; w < s->worker_count; w++) pthread_create(&s->workers[w].thread, NULL, scan_worker_main, &s->workers[w]);
+}
+
+static void parallel_scan_destroy(ParallelScan* s) {
+    if (!s) return;
+    pthread_mutex_lock(&s->mutex);
+    s->stop = true;
+    pthread_cond_broadcast(&s->space);
+    pthread_mutex_unlock(&s->mutex);
+    for (int w = 0; s->started && w < s->worker_count; w++) pthread_join(s->workers[w].thread, NULL);
+    for (int w = 0; w < s->worker_count; w++) {
+        batch_pipeline_destroy(s->workers[w].pipeline);
+        if (s->profile) profile_merge(s->profile, s->workers[w].profile);
+    }
+    free(s->workers);
+    morsel_free(s->current);
+    while (s->finished) {
+        Morsel* next = s->finished->next;
+        morsel_free(s->finished);
+        s->finished = next;
+    }
+    pthread_cond_destroy(&s->ready);
+    pthread_cond_destroy(&s->space);
+    pthread_mutex_destroy(&s->mutex);
+    free(s->after);
+    free(s->positions);
+    free(s);
+}
+
+// The next finished morsel the consumer may take, or NULL when every morsel
+// handed out has been taken and the range is done
+static Morsel* parallel_scan_take(ParallelScan* s) {
+    pthread_mutex_lock(&s->mutex);
+    Morsel* morsel = NULL;
+    for (;;) {
+        Morsel** link = &s->finished;
+        while (*link && s->ordered && (*link)->seq != s->taken) link = &(*link)->next;
+        if (*link) {
+            morsel = *link;
+            *link = morsel->next;
+            s->taken++;
+            pthread_cond_broadcast(&s->space);
+            break;
+        }
+        if (s->exhausted && s->taken == s->next_seq) break;
+        pthread_cond_wait(&s->ready, &s->mutex);
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return morsel;
+}
+
+// As batch_pipeline_next, over the morsels in consumer order
+static bool parallel_scan_next(ParallelScan* s, MatchingPath* mp) {
+    int n = s->path->count;
+    if (!s->started) parallel_scan_start(s);
+    while (!s->current || s->row >= s->current->rows) {
+        morsel_free(s->current);
+        s->current = parallel_scan_take(s);
+        s->row = 0;
+        if (!s->current) return false;
+    }
+    int i = s->row++;
+    mp->node_ids = s->current->node_ids + (size_t)i * n;
+    mp->num_nodes = n;
+    mp->pattern_pos = s->positions;
+    mp->rel_types = s->current->rel_types + (size_t)i * (n - 1);
+    mp->num_rels = n - 1;
+    return true;
+}
+
+/*******************************
+ * Generic join
+ *******************************/
+
+// Patterns with comma-separated parts or a repeated variable, all of single
+// hops, are matched one variable at a time rather than one hop at a time.
+// Each variable's candidates are the intersection of the neighbor lists of
+// every bound variable it shares a relationship with, so a triangle never
+// enumerates the open wedges a chain walk would build first, and the work
+// stays bounded by the size of the output (generic join).
+static bool pattern_needs_join(const PathPattern* path) {
+    bool cyclic = false;
+    for (int r = 0; r < path->count - 1; r++) {
+        const RelPattern* rp = &path->rels[r];
+        if (rp->direction == ',') cyclic = true;
+        else if (rp->min_hops != 1 || rp->max_hops != 1) return false;
+    }
+    for (int h = 0; h < path->count && !cyclic; h++) {
+        for (int k = h + 1; k < path->count && !cyclic; k++) {
+            const char* a = path->nodes[h].var;
+            if (a && path->nodes[k].var && strcmp(a, path->nodes[k].var) == 0) cyclic = true;
+        }
+    }
+    return cyclic;
+}
+
+// A neighbor in id order; key is the interned id
+typedef struct {
+    const char* key;
+    int id;
+    int type;
+} JoinEntry;
+
+// A pattern relationship, listed from variable `from` (bound first) toward
+// `to`; from == to for a self-loop
+typedef struct {
+    int rel;
+    int from;
+    int to;
+    const char* type;
+    GraphDirection dir;
+    JoinEntry* adj;      // neighbors of from's node, sorted by id
+    int adj_count;
+    int adj_capacity;
+    int* types;          // types of the relationships to to's node that pass the filters
+    int type_count;
+    int type_capacity;
+    int type_next;
+} JoinEdge;
+
+typedef struct {
+    int var;
+    int* edges;          // JoinEdge indices closed by binding this variable
+    int edge_count;
+    int* lists;          // the edges that reach a bound variable, intersected
+    int list_count;
+    int* pos;            // per list, the intersection's position
+    const char* pinned;
+    const char* label;   // scanned when no edge reaches a bound variable
+    char* scan_after;
+    bool scan_more;
+    int* cands;
+    int cand_count;
+    int cand_capacity;
+    int next;
+} JoinLevel;
+
+typedef struct {
+    GraphDB* gdb;
+    const PathPattern* path;
+    const PatternFilters* filters;
+    IdDict dict;
+    NeighborBuffer nbrs;
+    int var_count;
+    int* node_var;       // per pattern node
+    int* value;          // per variable, bound interned id
+    JoinEdge* edges;
+    int edge_count;
+    JoinLevel* levels;   // in binding order
+    int depth;           // level being bound, -1 when exhausted
+    bool started;        // level 0 is opened by the first generic_join_next
+    bool emitting;       // every variable is bound; stepping through relationship types
+    char** node_ids;
+    char** rel_types;
+    int* positions;
+} GenericJoin;
+
+static int join_entry_compare(const void* a, const void* b) {
+    const JoinEntry* x = a;
+    const JoinEntry* y = b;
+    int c = strcmp(x->key, y->key);
+    return c ? c : x->type - y->type;
+}
+
+// Neighbor list of node `id` along `e`, in id order. A typed one-way scan
+// reads one `O`/`I` key range, which is already in that order; only mixed
+// types and undirected hops need a sort.
+static void join_edge_fetch(GenericJoin* j, JoinEdge* e, int id) {
+    id_dict_neighbors(&j->dict, id, e->type, e->dir, &j->nbrs);
+    if (j->nbrs.count > e->adj_capacity) {
+        e->adj_capacity = j->nbrs.count;
+        e->adj = realloc(e->adj, e->adj_capacity * sizeof(JoinEntry));
+    }
+    bool sorted = true;
+    for (int i = 0; i < j->nbrs.count; i++) {
+        JoinEntry* entry = &e->adj[i];
+        entry->id = j->nbrs.ids[i];
+        entry->type = j->nbrs.types[i];
+        entry->key = id_dict_key(j->dict.ids, entry->id);
+        if (i > 0 && sorted && join_entry_compare(entry - 1, entry) > 0) sorted = false;
+    }
+    e->adj_count = j->nbrs.count;
+    if (!sorted) qsort(e->adj, e->adj_count, sizeof(JoinEntry), join_entry_compare);
+}
+
+// First index at or after `from` whose key is not below `key`, galloping
+// so a long list is skipped in logarithmic steps
+static int join_seek(const JoinEntry* adj, int count, int from, const char* key) {
+    if (from >= count || strcmp(adj[from].key, key) >= 0) return from;
+    int step = 1, lo = from;
+    while (lo + step < count && strcmp(adj[lo + step].key, key) < 0) {
+        lo += step;
+        step *= 2;
+    }
+    int hi = lo + step < count ? lo + step : count;
+    while (lo + 1 < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(adj[mid].key, key) < 0) lo = mid;
+        else hi = mid;
+    }
+    return hi;
+}
+
+static void join_add_candidate(JoinLevel* lv, int id) {
+    if (lv->cand_count == lv->cand_capacity) {
+        lv->cand_capacity = lv->cand_capacity ? lv->cand_capacity * 2 : 64;
+        lv->cands = realloc(lv->cands, lv->cand_capacity * sizeof(int));
+    }
+    lv->cands[lv->cand_count++] = id;
+}
+
+// Leapfrog intersection of the level's sorted neighbor lists: every list
+// seeks to the largest current key until all of them agree on it
+static void join_intersect(GenericJoin* j, JoinLevel* lv) {
+    const int* lists = lv->lists;
+    int list_count = lv->list_count;
+    int* pos = lv->pos;
+    for (int i = 0; i < list_count; i++) {
+        pos[i] = 0;
+        if (j->edges[lists[i]].adj_count == 0) return;
+    }
+    for (;;) {
+        const char* key = j->edges[lists[0]].adj[pos[0]].key;
+        for (int i = 1; i < list_count; i++) {
+            const JoinEdge* e = &j->edges[lists[i]];
+            if (strcmp(e->adj[pos[i]].key, key) > 0) key = e->adj[pos[i]].key;
+        }
+        bool agree = true;
+        for (int i = 0; i < list_count; i++) {
+            const JoinEdge* e = &j->edges[lists[i]];
+            pos[i] = join_seek(e->adj, e->adj_count, pos[i], key);
+            if (pos[i] == e->adj_count) return;
+            if (strcmp(e->adj[pos[i]].key, key) != 0) agree = false;
+        }
+        if (!agree) continue;
+        join_add_candidate(lv, j->edges[lists[0]].adj[pos[0]].id);
+        for (int i = 0; i < list_count; i++) {
+            const JoinEdge* e = &j->edges[lists[i]];
+            while (pos[i] < e->adj_count && strcmp(e->adj[pos[i]].key, key) == 0) pos[i]++;
+            if (pos[i] == e->adj_count) return;
+        }
+    }
+}
+
+// Next page of a scanned level; false when the scan is done
+static bool join_scan_page(GenericJoin* j, JoinLevel* lv) {
+    lv->cand_count = 0;
+    lv->next = 0;
+    if (!lv->scan_more) return false;
+    int count = 0;
+    char** ids = graphdb_scan_nodes(j->gdb, lv->label, lv->scan_after, SCAN_PAGE_SIZE, &count);
+    for (int i = 0; i < count; i++) {
+        join_add_candidate(lv, id_dict_intern(j->dict.ids, ids[i]));
+        free(ids[i]);
+    }
+    free(ids);
+    lv->scan_more = count == SCAN_PAGE_SIZE;
+    if (lv->scan_more) {
+        free(lv->scan_after);
+        lv->scan_after = strdup(id_dict_key(j->dict.ids, lv->cands[count - 1]));
+    }
+    return count > 0;
+}
+
+// Candidates for the level's variable given the variables bound before it
+static void join_level_open(GenericJoin* j, int depth) {
+    JoinLevel* lv = &j->levels[depth];
+    lv->cand_count = 0;
+    lv->next = 0;
+    for (int i = 0; i < lv->list_count; i++) join_edge_fetch(j, &j->edges[lv->lists[i]], j->value[j->edges[lv->lists[i]].from]);
+    if (lv->list_count > 0) {
+        join_intersect(j, lv);
+    } else if (lv->pinned) {
+        join_add_candidate(lv, id_dict_intern(j->dict.ids, lv->pinned));
+    } else {
+        free(lv->scan_after);
+        lv->scan_after = NULL;
+        lv->scan_more = true;
+        join_scan_page(j, lv);
+    }
+}
+
+// Relationship types from `from`'s node to `id` along `e` that pass the
+// WHERE conditions on the relationship; false when there are none
+static bool join_edge_types(GenericJoin* j, JoinEdge* e, int id) {
+    if (e->from == e->to) join_edge_fetch(j, e, id);
+    const char* key = id_dict_key(j->dict.ids, id);
+    e->type_count = 0;
+    e->type_next = 0;
+    for (int i = join_seek(e->adj, e->adj_count, 0, key); i < e->adj_count && e->adj[i].id == id; i++) {
+        if (!rel_filter_passes(&j->filters->rels[e->rel], id_dict_key(j->dict.types, e->adj[i].type))) continue;
+        if (e->type_count == e->type_capacity) {
+            e->type_capacity = e->type_capacity ? e->type_capacity * 2 : 4;
+            e->types = realloc(e->types, e->type_capacity * sizeof(int));
+        }
+        e->types[e->type_count++] = e->adj[i].type;
+    }
+    return e->type_count > 0;
+}
+
+// Label, pinned id and pushed WHERE conjuncts of every pattern node the
+// variable stands for
+static bool join_accepts(GenericJoin* j, int var, int id) {
+    int label = id_dict_label(&j->dict, id);
+    if (label <= 0) return false;
+    const char* label_text = id_dict_key(j->dict.labels, label - 1);
+    const char* key = id_dict_key(j->dict.ids, id);
+    for (int h = 0; h < j->path->count; h++) {
+        if (j->node_var[h] != var) continue;
+        const NodePattern* np = &j->path->nodes[h];
+        if (np->label && strcmp(np->label, label_text) != 0) return false;
+        const char* pinned = pattern_node_id(np);
+        if (pinned && strcmp(pinned, key) != 0) return false;
+        if (!node_filter_passes(j->gdb, &j->filters->nodes[h], key, label_text)) return false;
+    }
+    return true;
+}
+
+// Binds the level's next accepted candidate; false when it has none left
+static bool join_level_next(GenericJoin* j, int depth) {
+    JoinLevel* lv = &j->levels[depth];
+    for (;;) {
+        if (lv->next >= lv->cand_count) {
+            bool scanned = lv->list_count == 0 && !lv->pinned;
+            if (!scanned || !join_scan_page(j, lv)) return false;
+        }
+        int id = lv->cands[lv->next++];
+        if (!join_accepts(j, lv->var, id)) continue;
+        bool ok = true;
+        for (int i = 0; i < lv->edge_count && ok; i++) ok = join_edge_types(j, &j->edges[lv->edges[i]], id);
+        if (!ok) continue;
+        j->value[lv->var] = id;
+        return true;
+    }
+}
+
+static GenericJoin* generic_join_create(GraphDB* gdb, const PathPattern* path, const PatternFilters* filters) {
+    int n = path->count;
+    GenericJoin* j = calloc(1, sizeof(GenericJoin));
+    j->gdb = gdb;
+    j->path = path;
+    j->filters = filters;
+    id_dict_init(&j->dict, gdb);
+    j->node_var = malloc(n * sizeof(int));
+    for (int h = 0; h < n; h++) {
+        j->node_var[h] = j->var_count;
+        for (int k = 0; k < h && path->nodes[h].var; k++) {
+            if (path->nodes[k].var && strcmp(path->nodes[k].var, path->nodes[h].var) == 0) {
+                j->node_var[h] = j->node_var[k];
+                break;
+            }
+        }
+        if (j->node_var[h] == j->var_count) j->var_count++;
+    }
+    int vars = j->var_count;
+    j->value = calloc(vars, sizeof(int));
+
+    // A pinned variable costs 1, else its (capped) label or node count
+    long long* cost = malloc(vars * sizeof(long long));
+    const char** pinned = calloc(vars, sizeof(char*));
+    const char** label = calloc(vars, sizeof(char*));
+    for (int h = 0; h < n; h++) {
+        int v = j->node_var[h];
+        if (pattern_node_id(&path->nodes[h])) pinned[v] = pattern_node_id(&path->nodes[h]);
+        if (path->nodes[h].label && !label[v]) label[v] = path->nodes[h].label;
+    }
+    for (int v = 0; v < vars; v++) {
+        cost[v] = pinned[v] ? 1 : graphdb_count_nodes(gdb, label[v], PLANNER_STAT_LIMIT);
+    }
+
+    // Binding order: the cheapest variable, then always the one sharing the
+    // most relationships with those already bound (cheapest on a tie)
+    int* order = malloc(vars * sizeof(int));
+    int* rank = malloc(vars * sizeof(int));
+    for (int v = 0; v < vars; v++) rank[v] = -1;
+    for (int d = 0; d < vars; d++) {
+        int best = -1, best_links = -1;
+        for (int v = 0; v < vars; v++) {
+            if (rank[v] >= 0) continue;
+            int links = 0;
+            for (int r = 0; r < n - 1; r++) {
+                if (path->rels[r].direction == ',') continue;
+                int a = j->node_var[r], b = j->node_var[r + 1];
+                if ((a == v && b != v && rank[b] >= 0) || (b == v && a != v && rank[a] >= 0)) links++;
+            }
+            if (best < 0 || links > best_links || (links == best_links && cost[v] < cost[best])) {
+                best = v;
+                best_links = links;
+            }
+        }
+        order[d] = best;
+        rank[best] = d;
+    }
+
+    j->edges = calloc(n > 1 ? n - 1 : 1, sizeof(JoinEdge));
+    j->levels = calloc(vars, sizeof(JoinLevel));
+    for (int d = 0; d < vars; d++) {
+        JoinLevel* lv = &j->levels[d];
+        lv->var = order[d];
+        lv->pinned = pinned[order[d]];
+        lv->label = label[order[d]];
+        lv->edges = malloc((n > 1 ? n - 1 : 1) * sizeof(int));
+        lv->lists = malloc((n > 1 ? n - 1 : 1) * sizeof(int));
+        lv->pos = malloc((n > 1 ? n - 1 : 1) * sizeof(int));
+    }
+    for (int r = 0; r < n - 1; r++) {
+        const RelPattern* rp = &path->rels[r];
+        if (rp->direction == ',') continue;
+        int a = j->node_var[r], b = j->node_var[r + 1];
+        JoinEdge* e = &j->edges[j->edge_count];
+        e->rel = r;
+        e->type = rp->type ? rp->type : "";
+        // Listed from whichever end is bound first
+        bool reverse = rank[b] < rank[a];
+        e->from = reverse ? b : a;
+        e->to = reverse ? a : b;
+        e->dir = rel_walk_direction(rp, reverse);
+        JoinLevel* lv = &j->levels[rank[e->to]];
+        if (e->from != e->to) lv->lists[lv->list_count++] = j->edge_count;
+        lv->edges[lv->edge_count++] = j->edge_count++;
+    }
+    free(cost);
+    free(pinned);
+    free(label);
+    free(order);
+    free(rank);
+
+    j->node_ids = malloc(n * sizeof(char*));
+    j->rel_types = calloc(n > 1 ? n - 1 : 1, sizeof(char*));
+    j->positions = malloc(n * sizeof(int));
+    for (int h = 0; h < n; h++) j->positions[h] = h;
+    return j;
+}
+
+// The pattern followed by its variables in binding order, "_" for an
+// anonymous node
+static char* generic_join_describe(const GenericJoin* j) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) return NULL;
+    char* path = describe_path(j->path);
+    fprintf(out, "%s; binds ", path ? path : "");
+    free(path);
+    for (int d = 0; d < j->var_count; d++) {
+        const char* name = "_";
+        for (int h = 0; h < j->path->count; h++) {
+            if (j->node_var[h] == j->levels[d].var && j->path->nodes[h].var) name = j->path->nodes[h].var;
+        }
+        fprintf(out, "%s%s", d > 0 ? ", " : "", name);
+    }
+    fclose(out);
+    return text;
+}
+
+static void generic_join_destroy(GenericJoin* j) {
+    if (!j) return;
+    for (int e = 0; e < j->edge_count; e++) {
+        free(j->edges[e].adj);
+        free(j->edges[e].types);
+    }
+    for (int d = 0; d < j->var_count; d++) {
+        free(j->levels[d].edges);
+        free(j->levels[d].lists);
+        free(j->levels[d].pos);
+        free(j->levels[d].cands);
+        free(j->levels[d].scan_after);
+    }
+    free(j->edges);
+    free(j->levels);
+    free(j->node_var);
+    free(j->value);
+    neighbor_buffer_free(&j->nbrs);
+    id_dict_free(&j->dict);
+    free(j->node_ids);
+    free(j->rel_types);
+    free(j->positions);
+    free(j);
+}
+
+// Next combination of relationship types for the bound variables, last
+// relationship fastest
+static bool join_next_types(GenericJoin* j) {
+    for (int e = j->edge_count - 1; e >= 0; e--) {
+        JoinEdge* edge = &j->edges[e];
+        if (++edge->type_next < edge->type_count) return true;
+        edge->type_next = 0;
+    }
+    return false;
+}
+
+// As batch_pipeline_next; strings are owned by the join's dictionaries
+static bool generic_join_next(GenericJoin* j, MatchingPath* mp) {
+    int last = j->var_count - 1;
+    if (!j->started) {
+        j->started = true;
+        join_level_open(j, 0);
+    }
+    for (;;) {
+        if (j->emitting && !join_next_types(j)) j->emitting = false;
+        if (!j->emitting) {
+            if (j->depth < 0) return false;
+            if (!join_level_next(j, j->depth)) {
+                j->depth--;
+                continue;
+            }
+            if (j->depth < last) {
+                join_level_open(j, ++j->depth);
+                continue;
+            }
+            j->emitting = true;
+        }
+        for (int h = 0; h < j->path->count; h++) j->node_ids[h] = (char*)id_dict_key(j->dict.ids, j->value[j->node_var[h]]);
+        for (int e = 0; e < j->edge_count; e++) {
+            const JoinEdge* edge = &j->edges[e];
+            j->rel_types[edge->rel] = (char*)id_dict_key(j->dict.types, edge->types[edge->type_next]);
+        }
+        mp->node_ids = j->node_ids;
+        mp->num_nodes = j->path->count;
+        mp->pattern_pos = j->positions;
+        mp->rel_types = j->rel_types;
+        mp->num_rels = j->path->count - 1;
+        return true;
+    }
+}
+
+/*******************************
+ * Pattern matching
+ *******************************/
+
+// Lazily matches pq->match from the node picked by choose_anchor. Patterns
+// of fixed-length hops run through a batch pipeline, split across threads
+// when the anchor is a scan of more than one morsel. Multi-part and cyclic
+// patterns run as a generic join. Otherwise hops left of
+// the anchor are walked backwards with their directions flipped (an outgoing
+// hop is answered from the `I` index); those backward paths are collected by
+// the first call and grouped by anchor node, then joined with a lazy forward
+// walk from each anchor node. Paths always come out in pattern order. Nothing
+// is read before the first call, so EXPLAIN only plans.
+typedef struct {
+    GraphDB* gdb;
+    int count;
+    int anchor;
+    int max_hops;
+    bool done;
+    BatchPipeline* pipeline;
+    ParallelScan* parallel;
+    GenericJoin* join;
+    NodePattern* nodes;      // pattern rewritten with pinned ids and the Person rule
+    PathPattern pattern;
+    PathWalk* walk;          // the whole pattern, or the forward walk from the anchor
+    PathPattern left;        // nodes[anchor] <- ... <- nodes[0], each relationship reversed
+    PatternFilters left_filters;
+    NodePattern* right_nodes;
+    PathPattern right;
+    PatternFilters right_filters;
+    CypherArena* left_arena;
+    MatchingPath** left_paths; // backward walks, sorted by anchor node
+    int left_count;
+    int group_start;         // left_paths[group_start, group_end) share the walk's anchor node
+    int group_end;
+    int left_next;
+    MatchingPath out;        // joined path, strings borrowed
+    Profile* profile;
+    int prof;                // operator whose output is the match
+    int left_prof;
+} PatternMatch;
+
+// Whether the order of matched paths can show in the result; aggregates
+// without grouping keys or collect() fold the same whatever the order
+static bool match_order_matters(const ParsedQuery* pq) {
+    if (pq->aggregate_count < pq->return_count) return true;
+    for (int i = 0; i < pq->return_count; i++) {
+        if (pq->return_items[i].agg == AGG_COLLECT) return true;
+    }
+    return false;
+}
+
+static PatternMatch* pattern_match_create(GraphDB* gdb, const ParsedQuery* pq, const PatternFilters* filters, Profile* profile) {
+    const PathPattern* path = pq->match;
+    int n = path->count;
+    PatternMatch* m = calloc(1, sizeof(PatternMatch));
+    m->gdb = gdb;
+    m->count = n;
+    m->max_hops = unbounded_hops(gdb);
+    m->done = filters->unsatisfiable;
+    m->profile = profile;
+    m->prof = -1;
+    m->left_prof = -1;
+    m->nodes = malloc(n * sizeof(NodePattern));
+    memcpy(m->nodes, path->nodes, n * sizeof(NodePattern));
+    for (int h = 0; h < n; h++) {
+        NodePattern* np = &m->nodes[h];
+        // An unlabeled node at the end of a variable-length hop only matches Person nodes
+        if (h > 0 && !np->label && path->rels[h - 1].min_hops != path->rels[h - 1].max_hops) np->label = (char*)"Person";
+        // WHERE x.id = '...' pins x like an inline {id: ...}; the condition is still checked on every row
+        if (pattern_node_id(np) || !np->var) continue;
+        for (int c = 0; c < pq->cond_count; c++) {
+            const WhereCondition* wc = &pq->conditions[c];
+            if (wc->val && strcmp(wc->var, np->var) == 0 && strcmp(wc->prop, "id") == 0) {
+                np->prop_key = (char*)"id";
+                np->prop_value = wc->val;
+                break;
+            }
+        }
+    }
+    m->pattern = (PathPattern){m->nodes, path->rels, n, path->path_var};
+    if (m->done) {
+        if (profile) m->prof = profile_add(profile, "EmptyResult", describe_path(&m->pattern), -1, false);
+        return m;
+    }
+    if (pattern_needs_join(&m->pattern)) {
+        m->join = generic_join_create(gdb, &m->pattern, filters);
+        if (profile) m->prof = profile_add(profile, "GenericJoin", generic_join_describe(m->join), -1, false);
+        return m;
+    }
+    m->anchor = choose_anchor(gdb, &m->pattern);
+    if (batch_supported(&m->pattern)) {
+        int threads = query_threads(gdb);
+        if (parallel_scan_worthwhile(gdb, &m->pattern, m->anchor, threads)) {
+            bool ordered = match_order_matters(pq);
+            m->parallel = parallel_scan_create(gdb, &m->pattern, filters, m->anchor, threads, ordered, profile);
+            if (profile) {
+                BatchPipeline* first = m->parallel->workers[0].pipeline;
+                char* detail = describe_text("%d threads, %s morsels", threads, ordered ? "ordered" : "unordered");
+                m->prof = profile_add(profile, "ParallelScan", detail, first->ops[first->op_count - 1].prof, false);
+            }
+        } else {
+            m->pipeline = batch_pipeline_create(gdb, &m->pattern, filters, m->anchor);
+            if (profile) {
+                batch_pipeline_profile(m->pipeline, &m->pattern, profile, false);
+                m->prof = m->pipeline->ops[m->pipeline->op_count - 1].prof;
+            }
+        }
+        return m;
+    }
+    if (m->anchor == 0) {
+        m->walk = path_walk_create(gdb, &m->pattern, filters, m->max_hops);
+        if (profile) m->prof = profile_add(profile, "PathWalk", describe_path(&m->pattern), -1, false);
+        return m;
+    }
+
+    int anchor = m->anchor;
+    NodePattern* left_nodes = malloc((anchor + 1) * sizeof(NodePattern));
+    RelPattern* left_rels = malloc(anchor * sizeof(RelPattern));
+    PositionFilter* left_node_filters = malloc((anchor + 1) * sizeof(PositionFilter));
+    PositionFilter* left_rel_filters = malloc(anchor * sizeof(PositionFilter));
+    for (int i = 0; i <= anchor; i++) {
+        left_nodes[i] = m->nodes[anchor - i];
+        left_node_filters[i] = filters->nodes[anchor - i];
+    }
+    for (int i = 0; i < anchor; i++) {
+        left_rels[i] = path->rels[anchor - 1 - i];
+        if (left_rels[i].direction == '>') left_rels[i].direction = '<';
+        else if (left_rels[i].direction == '<') left_rels[i].direction = '>';
+        left_rel_filters[i] = filters->rels[anchor - 1 - i];
+    }
+    m->left = (PathPattern){left_nodes, left_rels, anchor + 1, NULL};
+    m->left_filters = (PatternFilters){left_node_filters, left_rel_filters, NULL, false};
+
+    // The forward walk is pinned to one anchor node at a time
+    m->right_nodes = malloc((n - anchor) * sizeof(NodePattern));
+    memcpy(m->right_nodes, m->nodes + anchor, (n - anchor) * sizeof(NodePattern));
+    m->right_nodes[0].prop_key = (char*)"id";
+    m->right = (PathPattern){m->right_nodes, path->rels + anchor, n - anchor, NULL};
+    m->right_filters = (PatternFilters){filters->nodes + anchor, filters->rels + anchor, NULL, false};
+    int cap = pattern_max_len(path, m->max_hops);
+    m->out.node_ids = malloc(cap * sizeof(char*));
+    m->out.rel_types = malloc(cap * sizeof(char*));
+    m->out.pattern_pos = malloc(n * sizeof(int));
+    if (profile) {
+        m->left_prof = profile_add(profile, "BackwardWalk", describe_path(&m->left), -1, false);
+        m->prof = profile_add(profile, "PathWalk", describe_path(&m->right), m->left_prof, true);
+    }
+    return m;
+}
+
+// Collects every backward path from the anchor, sorted by anchor node
+static void pattern_match_collect_left(PatternMatch* m) {
+    ProfileMark mark;
+    profile_enter(m->profile, &mark);
+    PathWalk* walk = path_walk_create(m->gdb, &m->left, &m->left_filters, m->max_hops);
+    m->left_arena = cypher_arena_acquire();
+    int capacity = 0;
+    while (path_walk_next(walk)) {
+        m->left_paths = cypher_arena_grow(m->left_arena, m->left_paths, m->left_count, &capacity, sizeof(MatchingPath*));
+        MatchingPath view = {walk->ids, walk->len, walk->positions, walk->rels, walk->rel_len};
+        m->left_paths[m->left_count++] = matching_path_copy(m->left_arena, &view, m->anchor + 1);
+    }
+    path_walk_destroy(walk);
+    if (m->left_count > 1) qsort(m->left_paths, m->left_count, sizeof(MatchingPath*), compare_paths_first);
+    profile_leave(m->profile, m->left_prof, &mark, m->left_count);
+}
+
+static void pattern_match_destroy(PatternMatch* m) {
+    if (!m) return;
+    batch_pipeline_destroy(m->pipeline);
+    parallel_scan_destroy(m->parallel);
+    generic_join_destroy(m->join);
+    path_walk_destroy(m->walk);
+    cypher_arena_release(m->left_arena);
+    free(m->left.nodes);
+    free(m->left.rels);
+    free(m->left_filters.nodes);
+    free(m->left_filters.rels);
+    free(m->right_nodes);
+    free(m->nodes);
+    if (m->anchor > 0 && !m->pipeline && !m->parallel) {
+        free(m->out.node_ids);
+        free(m->out.rel_types);
+        free(m->out.pattern_pos);
+    }
+    free(m);
+}
+
+// Stitches a backward path (anchor ... nodes[0]) and the forward walk's
+// current path (anchor ... nodes[count - 1]) into m->out
+static void join_at_anchor(PatternMatch* m, const MatchingPath* left, const PathWalk* right) {
+    MatchingPath* mp = &m->out;
+    int offset = left->num_nodes - 1;
+    mp->num_nodes = offset + right->len;
+    for (int i = 0; i < left->num_nodes; i++) mp->node_ids[offset - i] = left->node_ids[i];
+    for (int i = 1; i < right->len; i++) mp->node_ids[offset + i] = right->ids[i];
+    mp->num_rels = left->num_rels + right->rel_len;
+    for (int i = 0; i < left->num_rels; i++) mp->rel_types[left->num_rels - 1 - i] = left->rel_types[i];
+    for (int i = 0; i < right->rel_len; i++) mp->rel_types[left->num_rels + i] = right->rels[i];
+    for (int h = 0; h <= m->anchor; h++) mp->pattern_pos[h] = offset - left->pattern_pos[m->anchor - h];
+    for (int h = m->anchor + 1; h < m->count; h++) mp->pattern_pos[h] = offset + right->positions[h - m->anchor];
+}
+
+static const MatchingPath* pattern_match_step(PatternMatch* m) {
+    if (m->done) return NULL;
+    if (m->pipeline) {
+        if (batch_pipeline_next(m->pipeline, &m->out)) return &m->out;
+        m->done = true;
+        return NULL;
+    }
+    if (m->parallel) {
+        if (parallel_scan_next(m->parallel, &m->out)) return &m->out;
+        m->done = true;
+        return NULL;
+    }
+    if (m->join) {
+        if (generic_join_next(m->join, &m->out)) return &m->out;
+        m->done = true;
+        return NULL;
+    }
+    if (m->anchor == 0) {
+        if (!path_walk_next(m->walk)) {
+            m->done = true;
+            return NULL;
+        }
+        m->out.node_ids = m->walk->ids;
+        m->out.num_nodes = m->walk->len;
+        m->out.pattern_pos = m->walk->positions;
+        m->out.rel_types = m->walk->rels;
+        m->out.num_rels = m->walk->rel_len;
+        return &m->out;
+    }
+    if (!m->left_arena) pattern_match_collect_left(m);
+    for (;;) {
+        if (m->walk && m->left_next < m->group_end) {
+            join_at_anchor(m, m->left_paths[m->left_next++], m->walk);
+            return &m->out;
+        }
+        if (m->walk && path_walk_next(m->walk)) {
+            m->left_next = m->group_start;
+            continue;
+        }
+        if (m->walk) {
+            path_walk_destroy(m->walk);
+            m->walk = NULL;
+            m->group_start = m->group_end;
+        }
+        if (m->group_start >= m->left_count) {
+            m->done = true;
+            return NULL;
+        }
+        const char* anchor_id = m->left_paths[m->group_start]->node_ids[0];
+        m->group_end = m->group_start + 1;
+        while (m->group_end < m->left_count && strcmp(m->left_paths[m->group_end]->node_ids[0], anchor_id) == 0) m->group_end++;
+        m->right_nodes[0].prop_value = (char*)anchor_id;
+        m->walk = path_walk_create(m->gdb, &m->right, &m->right_filters, m->max_hops);
+        m->left_next = m->group_end;
+    }
+}
+
+// Next matching path, or NULL when exhausted. The path and its strings are
+// only valid until the next call.
+static const MatchingPath* pattern_match_next(PatternMatch* m) {
+    // A batch pipeline counts its own operators
+    if (!m->profile || m->pipeline) return pattern_match_step(m);
+    ProfileMark mark;
+    profile_enter(m->profile, &mark);
+    const MatchingPath* mp = pattern_match_step(m);
+    profile_leave(m->profile, m->prof, &mark, mp ? 1 : 0);
+    return mp;
+}
+
+// The pattern node or relationship a WHERE, DELETE, RETURN or ORDER BY
+// variable names
+typedef struct {
+    int hop;  // pattern node, or -1
+    int rel;  // pattern relationship, or -1
+} VarRef;
+
+static VarRef var_ref(const PathPattern* path, const char* var) {
+    VarRef ref = {-1, -1};
+    if (!var) return ref;
+    for (int h = 0; h < path->count; h++) {
+        if (path->nodes[h].var && strcmp(path->nodes[h].var, var) == 0) {
+            ref.hop = h;
+            return ref;
+        }
+    }
+    for (int r = 0; r < path->count - 1; r++) {
+        if (path->rels[r].var && strcmp(path->rels[r].var, var) == 0) {
+            ref.rel = r;
+            return ref;
+        }
+    }
+    return ref;
+}
+
+// WHERE conditions the traversal could not enforce, checked on a whole path
+static bool row_conditions_pass(GraphDB* gdb, const ParsedQuery* pq, const PatternFilters* filters, const MatchingPath* mp) {
+    for (int cond = 0; cond < pq->cond_count; cond++) {
+        if (filters->pushed[cond]) continue;
+        const WhereCondition* wc = &pq->conditions[cond];
+        VarRef ref = var_ref(pq->match, wc->var);
+        if (ref.hop < 0 && ref.rel < 0) return false;
+
+        const char* check_val = NULL;
+        char* fetched = NULL;
+        if (ref.rel >= 0) {
+            char* rel_type = mp->rel_types[mp->pattern_pos[ref.rel]];
+            if (strcmp(wc->prop, "type") == 0) check_val = rel_type ? rel_type : "";
+        } else {
+            char* node_id = mp->node_ids[mp->pattern_pos[ref.hop]];
+            if (strcmp(wc->prop, "id") == 0) check_val = node_id;
+            else if (strcmp(wc->prop, "label") == 0) check_val = fetched = graphdb_get_node_label(gdb, node_id);
+            else check_val = fetched = graphdb_get_node_property(gdb, node_id, wc->prop);
+        }
+        bool ok = check_val && strcmp(check_val, wc->val) == 0;
+        free(fetched);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// The Filter operator for the WHERE conditions the traversal could not
+// enforce, or -1 when there are none
+static int row_filter_profile(Profile* profile, const ParsedQuery* pq, const PatternFilters* filters, int input) {
+    if (!profile) return -1;
+    const WhereCondition** conds = malloc((pq->cond_count + 1) * sizeof(WhereCondition*));
+    int count = 0;
+    for (int c = 0; c < pq->cond_count; c++) {
+        if (!filters->pushed[c]) conds[count++] = &pq->conditions[c];
+    }
+    int op = -1;
+    if (count > 0) {
+        char* text = NULL;
+        size_t len = 0;
+        FILE* out = open_memstream(&text, &len);
+        if (out) {
+            describe_conditions(out, "", conds, count);
+            fclose(out);
+        }
+        op = profile_add(profile, "Filter", text, input, false);
+    }
+    free(conds);
+    return op;
+}
+
+// row_conditions_pass, counted as Filter operator `op` when it is one
+static bool row_filter_pass(GraphDB* gdb, const ParsedQuery* pq, const PatternFilters* filters, const MatchingPath* mp, Profile* profile, int op) {
+    if (op < 0) return row_conditions_pass(gdb, pq, filters, mp);
+    ProfileMark mark;
+    profile_enter(profile, &mark);
+    bool pass = row_conditions_pass(gdb, pq, filters, mp);
+    profile_leave(profile, op, &mark, pass);
+    return pass;
+}
+
+// "b.name DESC, count(*)"
+static char* describe_order(const ParsedQuery* pq) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) return NULL;
+    for (int i = 0; i < pq->order_count; i++) {
+        const OrderItem* o = &pq->order_by[i];
+        if (i > 0) fputs(", ", out);
+        if (o->column >= 0) fputs(pq->returns[o->column], out);
+        else fprintf(out, "%s%s%s", o->var ? o->var : "count(*)", o->prop ? "." : "", o->prop ? o->prop : "");
+        if (o->descending) fputs(" DESC", out);
+    }
+    fclose(out);
+    return text;
+}
+
+/*******************************
+ * Results
+ *******************************/
+
+// Every row array and string of a result is carved from one pooled arena, so
+// free_cypher_result is a single release
+typedef struct {
+    CypherResult result; // first, so a CypherResult* converts back
+    CypherArena* arena;
+} ResultStorage;
+
+static CypherResult* cypher_result_create(void) {
+    ResultStorage* storage = calloc(1, sizeof(ResultStorage));
+    storage->arena = cypher_arena_acquire();
+    return &storage->result;
+}
+
+static CypherArena* result_arena(CypherResult* result) {
+    return ((ResultStorage*)result)->arena;
+}
+
+static char* result_strdup(CypherResult* result, const char* s) {
+    return cypher_arena_strndup(result_arena(result), s, strlen(s));
+}
+
+// Column names of a MATCH ... RETURN result
+static void result_set_columns(CypherResult* result, const ParsedQuery* pq) {
+    result->column_count = pq->return_count;
+    result->columns = cypher_arena_alloc(result_arena(result), (pq->return_count > 0 ? pq->return_count : 1) * sizeof(char*));
+    for (int i = 0; i < pq->return_count; i++) result->columns[i] = result_strdup(result, pq->returns[i]);
+}
+
+// Appends a zeroed row; `capacity` tracks the rows array
+static CypherRowResult* result_add_row(CypherResult* result, int* capacity) {
+    result->rows = cypher_arena_grow(result_arena(result), result->rows, result->row_count, capacity, sizeof(CypherRowResult));
+    CypherRowResult* row = &result->rows[result->row_count++];
+    memset(row, 0, sizeof(CypherRowResult));
+    return row;
+}
+
+// A procedure row: the node `id` as "node" plus one named value
+static void result_add_node_value(CypherResult* result, int* capacity, GraphDB* gdb, const char* id, const char* name, const char* value) {
+    CypherArena* arena = result_arena(result);
+    CypherRowResult* row = result_add_row(result, capacity);
+    row->node_count = 1;
+    row->nodes = cypher_arena_alloc(arena, sizeof(CypherNodeResult));
+    row->nodes[0].var = result_strdup(result, "node");
+    row->nodes[0].id = result_strdup(result, id);
+    char* label = graphdb_get_node_label(gdb, id);
+    if (label) row->nodes[0].label = result_strdup(result, label);
+    free(label);
+    row->value_count = 1;
+    row->values = cypher_arena_alloc(arena, sizeof(CypherValueResult));
+    row->values[0].name = result_strdup(result, name);
+    row->values[0].value = result_strdup(result, value);
+}
+
+// CALL algo.pageRank([type [, iterations [, damping [, write_property]]]])
+static void execute_call_pagerank(GraphDB* gdb, ParsedQuery* pq, CypherResult* result) {
+    const char* type = pq->call_arg_count > 0 ? pq->call_args[0] : "";
+    int iters = pq->call_arg_count > 1 ? atoi(pq->call_args[1]) : 20;
+    double damping = pq->call_arg_count > 2 ? atof(pq->call_args[2]) : 0.85;
+    const char* write_prop = pq->call_arg_count > 3 ? pq->call_args[3] : NULL;
+
+    GraphNodeScores* scores = graphdb_pagerank(gdb, type, iters, damping, 0);
+    if (!scores) return;
+    if (write_prop && strlen(write_prop) > 0) graphdb_write_node_scores(gdb, scores, write_prop);
+
+    int capacity = 0;
+    for (int i = 0; i < scores->count; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.10g", scores->values[i]);
+        result_add_node_value(result, &capacity, gdb, scores->ids[i], "score", buf);
+    }
+    graphdb_free_node_scores(scores);
+}
+
+typedef struct {
+    GraphDB* gdb;
+    CypherResult* result;
+    int capacity;
+} KHopRows;
+
+static int khop_row(void* ctx, const char* node_id, int depth) {
+    KHopRows* kr = (KHopRows*)ctx;
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", depth);
+    result_add_node_value(kr->result, &kr->capacity, kr->gdb, node_id, "depth", buf);
+    return 0;
+}
+
+// CALL algo.kHop(start [, type [, k [, 'out' | 'in' | 'both']]])
+static void execute_call_khop(GraphDB* gdb, ParsedQuery* pq, CypherResult* result) {
+    if (pq->call_arg_count < 1) {
+        fprintf(stderr, "algo.kHop requires a start node\n");
+        return;
+    }
+    const char* type = pq->call_arg_count > 1 ? pq->call_args[1] : "";
+    int k = pq->call_arg_count > 2 ? atoi(pq->call_args[2]) : 1;
+    GraphDirection direction = GRAPHDB_DIR_OUT;
+    if (pq->call_arg_count > 3) {
+        if (strcmp(pq->call_args[3], "in") == 0) direction = GRAPHDB_DIR_IN;
+        else if (strcmp(pq->call_args[3], "both") == 0) direction = GRAPHDB_DIR_BOTH;
+    }
+    KHopRows kr = {gdb, result, 0};
+    graphdb_khop(gdb, pq->call_args[0], type, k, direction, khop_row, &kr);
+}
+
+// CALL algo.communities([type [, max_iterations [, refine [, write_property]]]])
+static void execute_call_communities(GraphDB* gdb, ParsedQuery* pq, CypherResult* result) {
+    const char* type = pq->call_arg_count > 0 ? pq->call_args[0] : "";
+    int iters = pq->call_arg_count > 1 ? atoi(pq->call_args[1]) : 20;
+    int refine = pq->call_arg_count > 2 && (strcmp(pq->call_args[2], "true") == 0 || atoi(pq->call_args[2]) != 0);
+    const char* write_prop = pq->call_arg_count > 3 ? pq->call_args[3] : NULL;
+
+    GraphCommunities* comms = graphdb_communities(gdb, type, iters, refine, 0);
+    if (!comms) return;
+    if (write_prop && strlen(write_prop) > 0) graphdb_write_communities(gdb, comms, write_prop);
+
+    int capacity = 0;
+    for (int i = 0; i < comms->count; i++) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", comms->community[i]);
+        result_add_node_value(result, &capacity, gdb, comms->ids[i], "community", buf);
+    }
+    graphdb_free_communities(comms);
+}
+
+// CALL algo.reachable(a, b [, type])
+static void execute_call_reachable(GraphDB* gdb, ParsedQuery* pq, CypherResult* result) {
+    if (pq->call_arg_count < 2) {
+        fprintf(stderr, "algo.reachable requires two node ids\n");
+        return;
+    }
+    const char* type = pq->call_arg_count > 2 ? pq->call_args[2] : "";
+    int reachable = graphdb_reachable(gdb, pq->call_args[0], pq->call_args[1], type);
+    int capacity = 0;
+    CypherRowResult* row = result_add_row(result, &capacity);
+    row->value_count = 1;
+    row->values = cypher_arena_alloc(result_arena(result), sizeof(CypherValueResult));
+    row->values[0].name = result_strdup(result, "reachable");
+    row->values[0].value = result_strdup(result, reachable ? "true" : "false");
+}
+
+static CypherResult* execute_parsed_query(GraphDB* gdb, ParsedQuery* pq, Profile* profile) {
+    CypherResult* result = cypher_result_create();
+
+    if (pq->type == Q_CALL) {
+        if (strcmp(pq->call_proc, "algo.pageRank") == 0) {
+            execute_call_pagerank(gdb, pq, result);
+        } else if (strcmp(pq->call_proc, "algo.kHop") == 0) {
+            execute_call_khop(gdb, pq, result);
+        } else if (strcmp(pq->call_proc, "algo.reachable") == 0) {
+            execute_call_reachable(gdb, pq, result);
+        } else if (strcmp(pq->call_proc, "algo.communities") == 0) {
+            execute_call_communities(gdb, pq, result);
+        } else {
+            fprintf(stderr, "Unknown procedure: %s\n", pq->call_proc);
+        }
+        return result;
+    }
+
+    if (pq->type == Q_CREATE) {
+        if (!pq->match) return result;
+        const char** created_ids = calloc(pq->match->count, sizeof(char*));
+        for (int i = 0; i < pq->match->count; i++) {
+            NodePattern* np = &pq->match->nodes[i];
+            if (!np->prop_key || strcmp(np->prop_key, "id") != 0 || !np->prop_value || !np->label) continue;
+            graphdb_add_node(gdb, np->prop_value, np->label);
+            created_ids[i] = np->prop_value;
+        }
+        for (int i = 0; i < pq->match->count - 1; i++) {
+            RelPattern* rp = &pq->match->rels[i];
+            const char* from = created_ids[i];
+            const char* to = created_ids[i + 1];
+            if (!from || !to) continue;
+            if (rp->direction == '<') {
+                const char* temp = from;
+                from = to;
+                to = temp;
+            }
+            graphdb_add_edge(gdb, from, to, rp->type ? rp->type : "");
+        }
+        free(created_ids);
+        return result;
+    }
+
+    // DELETE: every match is collected before anything is deleted, so the
+    // walk never reads a graph it is modifying
+    PatternFilters* filters = pattern_filters_create(pq);
+    PatternMatch* match = pattern_match_create(gdb, pq, filters, profile);
+    int op = profile_add(profile, "Delete", describe_items(pq->deletes, pq->delete_count), match->prof, false);
+    if (profile_plan_only(profile)) {
+        pattern_match_destroy(match);
+        pattern_filters_free(filters, pq->match->count);
+        return result;
+    }
+    CypherArena* arena = cypher_arena_acquire();
+    MatchingPath** paths = NULL;
+    int num_paths = 0, capacity = 0;
+    const MatchingPath* view;
+    while ((view = pattern_match_next(match))) {
+        paths = cypher_arena_grow(arena, paths, num_paths, &capacity, sizeof(MatchingPath*));
+        paths[num_paths++] = matching_path_copy(arena, view, pq->match->count);
+    }
+    pattern_match_destroy(match);
+
+    ProfileMark mark;
+    profile_enter(profile, &mark);
+    int deleted = 0;
+    for (int p = 0; p < num_paths; p++) {
+        MatchingPath* mp = paths[p];
+        if (!row_conditions_pass(gdb, pq, filters, mp)) continue;
+        deleted++;
+        for (int d = 0; d < pq->delete_count; d++) {
+            VarRef ref = var_ref(pq->match, pq->deletes[d]);
+            if (ref.hop >= 0) {
+                graphdb_delete_node(gdb, mp->node_ids[mp->pattern_pos[ref.hop]]);
+                continue;
+            }
+            if (ref.rel < 0) continue;
+            // Every edge the relationship bound, in its stored direction
+            const RelPattern* rp = &pq->match->rels[ref.rel];
+            for (int k = mp->pattern_pos[ref.rel]; k < mp->pattern_pos[ref.rel + 1]; k++) {
+                const char* from = mp->node_ids[rp->direction == '<' ? k + 1 : k];
+                const char* to = mp->node_ids[rp->direction == '<' ? k : k + 1];
+                graphdb_delete_edge(gdb, from, to, mp->rel_types[k] ? mp->rel_types[k] : "");
+            }
+        }
+    }
+
+    profile_leave(profile, op, &mark, deleted);
+    cypher_arena_release(arena);
+    pattern_filters_free(filters, pq->match->count);
+    return result;
+}
+
+/*******************************
+ * Projection
+ *******************************/
+
+// Node id, label or stored property, or relationship type (of the first hop
+// of a variable-length one). A fetched value is malloc'ed and also returned
+// in *owned. NULL when the path has no such value.
+static const char* path_value(GraphDB* gdb, const MatchingPath* mp, VarRef ref, const char* prop, char** owned) {
+    *owned = NULL;
+    if (ref.hop >= 0) {
+        const char* id = mp->node_ids[mp->pattern_pos[ref.hop]];
+        if (!prop || strcmp(prop, "id") == 0) return id;
+        if (strcmp(prop, "label") == 0) return *owned = graphdb_get_node_label(gdb, id);
+        return *owned = graphdb_get_node_property(gdb, id, prop);
+    }
+    if (ref.rel >= 0 && (!prop || strcmp(prop, "type") == 0)) {
+        const char* type = mp->rel_types[mp->pattern_pos[ref.rel]];
+        return type ? type : "";
+    }
+    return NULL;
+}
+
+typedef enum { COLUMN_VALUE, COLUMN_NODE, COLUMN_REL, COLUMN_PATH } ColumnKind;
+
+typedef struct {
+    ColumnKind kind;
+    VarRef ref;
+    const char* prop;
+} Column;
+
+// Evaluates the RETURN items of each matched path into one reused row;
+// values[i] is column i. Only what is returned is computed: `b.id` reads no
+// label, and nodes / edges are listed only for returned nodes,
+// relationships and paths.
+typedef struct {
+    GraphDB* gdb;
+    const ParsedQuery* pq;
+    Column* columns;
+    CypherRowResult row;
+    bool* missing;        // per column, the value is null rather than "null"
+    int node_capacity;
+    int edge_capacity;
+    char** owned;         // fetched strings of the current row
+    int owned_count;
+    int owned_capacity;
+    StrMap* seen;         // RETURN DISTINCT: encoded rows returned so far
+    char* key;
+    size_t key_capacity;
+} Projection;
+
+static Projection* projection_create(GraphDB* gdb, const ParsedQuery* pq) {
+    Projection* p = calloc(1, sizeof(Projection));
+    int n = pq->return_count;
+    p->gdb = gdb;
+    p->pq = pq;
+    p->columns = malloc((n > 0 ? n : 1) * sizeof(Column));
+    p->row.values = malloc((n > 0 ? n : 1) * sizeof(CypherValueResult));
+    p->row.value_count = n;
+    p->missing = calloc(n > 0 ? n : 1, sizeof(bool));
+    if (pq->distinct) p->seen = strmap_create(64);
+    for (int i = 0; i < n; i++) {
+        const ReturnItem* item = &pq->return_items[i];
+        Column* col = &p->columns[i];
+        col->ref = var_ref(pq->match, item->var);
+        col->prop = item->prop;
+        if (item->prop) col->kind = COLUMN_VALUE;
+        else if (col->ref.hop >= 0) col->kind = COLUMN_NODE;
+        else if (col->ref.rel >= 0) col->kind = COLUMN_REL;
+        else if (pq->match->path_var && strcmp(pq->match->path_var, item->var) == 0) col->kind = COLUMN_PATH;
+        else col->kind = COLUMN_VALUE;
+        p->row.values[i].name = pq->returns[i];
+    }
+    return p;
+}
+
+// Releases the current row's fetched strings
+static void projection_clear(Projection* p) {
+    for (int i = 0; i < p->owned_count; i++) free(p->owned[i]);
+    p->owned_count = 0;
+    p->row.node_count = 0;
+    p->row.edge_count = 0;
+}
+
+static void projection_destroy(Projection* p) {
+    if (!p) return;
+    projection_clear(p);
+    if (p->seen) strmap_destroy(p->seen);
+    free(p->key);
+    free(p->missing);
+    free(p->owned);
+    free(p->columns);
+    free(p->row.nodes);
+    free(p->row.edges);
+    free(p->row.values);
+    free(p);
+}
+
+static char* projection_keep(Projection* p, char* s) {
+    if (!s) return NULL;
+    if (p->owned_count == p->owned_capacity) {
+        p->owned_capacity = p->owned_capacity ? p->owned_capacity * 2 : 16;
+        p->owned = realloc(p->owned, p->owned_capacity * sizeof(char*));
+    }
+    p->owned[p->owned_count++] = s;
+    return s;
+}
+
+static void projection_add_node(Projection* p, const MatchingPath* mp, int pos, const char* var) {
+    CypherRowResult* row = &p->row;
+    if (row->node_count == p->node_capacity) {
+        p->node_capacity = p->node_capacity ? p->node_capacity * 2 : 8;
+        row->nodes = realloc(row->nodes, p->node_capacity * sizeof(CypherNodeResult));
+    }
+    CypherNodeResult* node = &row->nodes[row->node_count++];
+    node->var = (char*)var;
+    node->id = mp->node_ids[pos];
+    node->label = projection_keep(p, graphdb_get_node_label(p->gdb, node->id));
+}
+
+// The edges bound by pattern relationship `r`, stored direction restored
+// for `<-` hops
+static void projection_add_edges(Projection* p, const MatchingPath* mp, int r) {
+    const RelPattern* rp = &p->pq->match->rels[r];
+    CypherRowResult* row = &p->row;
+    for (int k = mp->pattern_pos[r]; k < mp->pattern_pos[r + 1]; k++) {
+        if (row->edge_count == p->edge_capacity) {
+            p->edge_capacity = p->edge_capacity ? p->edge_capacity * 2 : 8;
+            row->edges = realloc(row->edges, p->edge_capacity * sizeof(CypherEdgeResult));
+        }
+        CypherEdgeResult* edge = &row->edges[row->edge_count++];
+        edge->var = rp->var;
+        edge->from_id = mp->node_ids[rp->direction == '<' ? k + 1 : k];
+        edge->to_id = mp->node_ids[rp->direction == '<' ? k : k + 1];
+        edge->type = mp->rel_types[k] ? mp->rel_types[k] : (char*)"";
+    }
+}
+
+// "[T1, T2]" for the relationships of a variable-length hop
+static char* rel_list_text(const MatchingPath* mp, int from, int to) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) return NULL;
+    fputc('[', out);
+    for (int k = from; k < to; k++) fprintf(out, "%s%s", k > from ? ", " : "", mp->rel_types[k] ? mp->rel_types[k] : "");
+    fputc(']', out);
+    fclose(out);
+    return text;
+}
+
+// "(a)-[:T]->(b)<-[:U]-(c)"
+static char* path_text(const ParsedQuery* pq, const MatchingPath* mp) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* out = open_memstream(&text, &len);
+    if (!out) return NULL;
+    fprintf(out, "(%s)", mp->node_ids[0]);
+    for (int r = 0; r < pq->match->count - 1; r++) {
+        bool left = pq->match->rels[r].direction == '<';
+        for (int k = mp->pattern_pos[r]; k < mp->pattern_pos[r + 1]; k++) {
+            fprintf(out, "%s[:%s]%s(%s)", left ? "<-" : "-", mp->rel_types[k] ? mp->rel_types[k] : "", left ? "-" : "->", mp->node_ids[k + 1]);
+        }
+    }
+    fclose(out);
+    return text;
+}
+
+// The row for `mp`, valid until the next call. Ids, types and names are
+// borrowed from the path and the query.
+static const CypherRowResult* projection_row(Projection* p, const MatchingPath* mp) {
+    const PathPattern* path = p->pq->match;
+    projection_clear(p);
+    for (int i = 0; i < p->pq->return_count; i++) {
+        const Column* col = &p->columns[i];
+        const char* value = NULL;
+        char* owned = NULL;
+        switch (col->kind) {
+            case COLUMN_VALUE:
+                value = path_value(p->gdb, mp, col->ref, col->prop, &owned);
+                projection_keep(p, owned);
+                break;
+            case COLUMN_NODE:
+                projection_add_node(p, mp, mp->pattern_pos[col->ref.hop], path->nodes[col->ref.hop].var);
+                value = mp->node_ids[mp->pattern_pos[col->ref.hop]];
+                break;
+            case COLUMN_REL: {
+                int from = mp->pattern_pos[col->ref.rel], to = mp->pattern_pos[col->ref.rel + 1];
+                projection_add_edges(p, mp, col->ref.rel);
+                if (to - from == 1) value = mp->rel_types[from] ? mp->rel_types[from] : "";
+                else value = projection_keep(p, rel_list_text(mp, from, to));
+                break;
+            }
+            case COLUMN_PATH: {
+                int first = p->row.node_count;
+                for (int k = 0; k < mp->num_nodes; k++) projection_add_node(p, mp, k, NULL);
+                for (int h = 0; h < path->count; h++) {
+                    CypherNodeResult* node = &p->row.nodes[first + mp->pattern_pos[h]];
+                    if (!node->var) node->var = path->nodes[h].var;
+                }
+                for (int r = 0; r < path->count - 1; r++) projection_add_edges(p, mp, r);
+                value = projection_keep(p, path_text(p->pq, mp));
+                break;
+            }
+        }
+        p->missing[i] = !value;
+        p->row.values[i].value = (char*)(value ? value : "null");
+    }
+    return &p->row;
+}
+
+static void projection_key_append(Projection* p, size_t* len, const char* s, size_t n) {
+    if (*len + n + 1 > p->key_capacity) {
+        p->key_capacity = (*len + n + 1) * 2;
+        p->key = realloc(p->key, p->key_capacity);
+    }
+    memcpy(p->key + *len, s, n);
+    *len += n;
+}
+
+// RETURN DISTINCT: whether the row last projected from `mp` is new. Rows are
+// encoded as in aggregator_group and interned into `seen`, whose chunks keep
+// the keys; a relationship also contributes its endpoints, so two edges of
+// the same type stay distinct.
+static bool projection_first_seen(Projection* p, const MatchingPath* mp) {
+    size_t len = 0;
+    for (int i = 0; i < p->pq->return_count; i++) {
+        const Column* col = &p->columns[i];
+        if (col->kind == COLUMN_REL) {
+            for (int k = mp->pattern_pos[col->ref.rel]; k <= mp->pattern_pos[col->ref.rel + 1]; k++) {
+                projection_key_append(p, &len, mp->node_ids[k], strlen(mp->node_ids[k]));
+                projection_key_append(p, &len, "\x1f", 1);
+            }
+        }
+        const char* v = p->row.values[i].value;
+        if (!p->missing[i]) projection_key_append(p, &len, v, strlen(v));
+        projection_key_append(p, &len, p->missing[i] ? "\x1e" : "\x1f", 1);
+    }
+    int inserted;
+    strmap_intern(p->seen, p->key ? p->key : "", len, &inserted);
+    return inserted;
+}
+
+/*******************************
+ * Sorting
+ *******************************/
+
+#define SORT_MEMORY_DEFAULT ((size_t)64 << 20)
+#define SORT_MERGE_FANIN 64 // spilled runs kept open at most
+#define SORT_MERGE_WAYS 8   // runs of one level merged into one run of the next
+
+typedef int (*CompareFn)(const void* ctx, const void* a, const void* b);
+
+static bool parse_number(const char* s, double* out) {
+    if (!s || !*s) return false;
+    char* end;
+    *out = strtod(s, &end);
+    return *end == '\0';
+}
+
+// Numeric when both sides are numbers, else by bytes
+static int compare_values(const char* a, const char* b) {
+    double x, y;
+    if (parse_number(a, &x) && parse_number(b, &y)) return x < y ? -1 : x > y;
+    return strcmp(a, b);
+}
+
+// One ORDER BY item; null sorts after every value, so first when descending
+static int compare_order_key(const OrderItem* item, const char* a, const char* b) {
+    int cmp = a && b ? compare_values(a, b) : (!a) - (!b);
+    return item->descending ? -cmp : cmp;
+}
+
+// Stable bottom-up merge sort, so rows that tie keep their arrival order
+static void sort_pointers(void** items, int n, CompareFn cmp, const void* ctx) {
+    if (n < 2) return;
+    void** tmp = malloc(n * sizeof(void*));
+    void** src = items;
+    void** dst = tmp;
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = lo + width < n ? lo + width : n;
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) dst[k++] = cmp(ctx, src[j], src[i]) < 0 ? src[j++] : src[i++];
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
+        }
+        void** t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != items) memcpy(items, src, n * sizeof(void*));
+    free(tmp);
+}
+
+// Binary heap with the largest item (by sign * cmp) at the root
+static void heap_sift_up(void** heap, int i, int sign, CompareFn cmp, const void* ctx) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (sign * cmp(ctx, heap[i], heap[parent]) <= 0) return;
+        void* t = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = t;
+        i = parent;
+    }
+}
+
+static void heap_sift_down(void** heap, int n, int i, int sign, CompareFn cmp, const void* ctx) {
+    for (;;) {
+        int top = i, left = 2 * i + 1, right = left + 1;
+        if (left < n && sign * cmp(ctx, heap[left], heap[top]) > 0) top = left;
+        if (right < n && sign * cmp(ctx, heap[right], heap[top]) > 0) top = right;
+        if (top == i) return;
+        void* t = heap[i];
+        heap[i] = heap[top];
+        heap[top] = t;
+        i = top;
+    }
+}
+
+// Memory an ORDER BY may hold before it spills, set with cypher_set_sort_memory
+static size_t sort_memory(GraphDB* gdb) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    size_t bytes = gdb->sort_memory > 0 ? gdb->sort_memory : SORT_MEMORY_DEFAULT;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+    return bytes;
+}
+
+void cypher_set_sort_memory(GraphDB* gdb, size_t bytes) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    gdb->sort_memory = bytes;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+}
+
+// A matched path and its sort keys flattened into one malloc'ed block, the
+// same bytes in memory and in a spilled run. The header is followed by the
+// pattern positions, then the keys, node ids and relationship types as
+// length-prefixed, NUL-terminated strings (length ~0 for null).
+typedef struct {
+    unsigned long long seq; // arrival order, the final tie-breaker
+    unsigned int size;      // whole record, header included
+    int num_nodes;
+    int num_rels;
+} SortRecord;
+
+#define SORT_NULL 0xFFFFFFFFu
+
+static size_t record_string_size(const char* s) {
+    return sizeof(unsigned int) + (s ? strlen(s) + 1 : 0);
+}
+
+static char* record_put_string(char* out, const char* s) {
+    unsigned int len = s ? (unsigned int)strlen(s) : SORT_NULL;
+    memcpy(out, &len, sizeof(len));
+    out += sizeof(len);
+    if (!s) return out;
+    memcpy(out, s, len + 1);
+    return out + len + 1;
+}
+
+static const char* record_get_string(const char** in) {
+    unsigned int len;
+    memcpy(&len, *in, sizeof(len));
+    *in += sizeof(len);
+    if (len == SORT_NULL) return NULL;
+    const char* s = *in;
+    *in += len + 1;
+    return s;
+}
+
+static const char* record_keys(const SortRecord* rec, int pattern_count) {
+    return (const char*)(rec + 1) + pattern_count * sizeof(int);
+}
+
+typedef struct {
+    FILE* file;       // NULL for the records still in memory
+    SortRecord* head; // next record of the run, NULL once drained
+    int level;        // merge passes its records went through
+} SortRun;
+
+// ORDER BY over matched paths. With a LIMIT only the best SKIP + LIMIT paths
+// are kept, in a max-heap; otherwise paths are buffered and, once they
+// outgrow the memory budget, sorted and spilled to a temporary file as a
+// run. The runs, and whatever is left in memory, are merged back as rows
+// are read.
+typedef struct {
+    GraphDB* gdb;
+    const ParsedQuery* pq;
+    VarRef* refs;         // per order item
+    const char** keys;
+    char** owned;
+    size_t budget;
+    long long keep;       // SKIP + LIMIT, -1 without a LIMIT
+    bool heap;            // records is a max-heap of the best `keep` so far
+    SortRecord** records;
+    int count;
+    int capacity;
+    size_t bytes;
+    unsigned long long seq;
+    SortRun runs[SORT_MERGE_FANIN]; // by level, highest first
+    int run_count;
+    SortRun memory;       // the in-memory records as one more merge input
+    SortRun* merge[SORT_MERGE_FANIN + 1]; // inputs by head, smallest first
+    int merge_count;
+    bool merging;         // output comes from merge_next
+    bool failed;          // a run could not be read back
+    int next;             // in-memory output position
+    SortRecord* current;  // last record returned by merge_next
+    MatchingPath out;     // strings point into the current record
+    int out_node_capacity;
+    int out_rel_capacity;
+} Sorter;
+
+static int record_compare(const void* ctx, const void* a, const void* b) {
+    const Sorter* s = ctx;
+    const SortRecord* x = a;
+    const SortRecord* y = b;
+    int pattern_count = s->pq->match->count;
+    const char* kx = record_keys(x, pattern_count);
+    const char* ky = record_keys(y, pattern_count);
+    for (int i = 0; i < s->pq->order_count; i++) {
+        const char* vx = record_get_string(&kx);
+        const char* vy = record_get_string(&ky);
+        int cmp = compare_order_key(&s->pq->order_by[i], vx, vy);
+        if (cmp) return cmp;
+    }
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static int run_compare(const void* ctx, const void* a, const void* b) {
+    return record_compare(ctx, ((const SortRun*)a)->head, ((const SortRun*)b)->head);
+}
+
+static Sorter* sorter_create(GraphDB* gdb, const ParsedQuery* pq) {
+    Sorter* s = calloc(1, sizeof(Sorter));
+    s->gdb = gdb;
+    s->pq = pq;
+    s->budget = sort_memory(gdb);
+    s->keep = pq->limit >= 0 ? (long long)pq->skip + pq->limit : -1;
+    s->heap = s->keep >= 0;
+    int n = pq->order_count;
+    s->refs = malloc(n * sizeof(VarRef));
+    s->keys = malloc(n * sizeof(char*));
+    s->owned = calloc(n, sizeof(char*));
+    for (int i = 0; i < n; i++) s->refs[i] = var_ref(pq->match, pq->order_by[i].var);
+    return s;
+}
+
+static void sorter_close_runs(Sorter* s) {
+    for (int r = 0; r < s->run_count; r++) {
+        free(s->runs[r].head);
+        fclose(s->runs[r].file);
+    }
+    s->run_count = 0;
+}
+
+static void sorter_destroy(Sorter* s) {
+    if (!s) return;
+    for (int i = 0; i < s->count; i++) free(s->records[i]);
+    sorter_close_runs(s);
+    free(s->memory.head);
+    free(s->current);
+    free(s->records);
+    free(s->refs);
+    free(s->keys);
+    free(s->owned);
+    free(s->out.node_ids);
+    free(s->out.rel_types);
+    free(s);
+}
+
+// Flattens `mp` and its sort keys into a record
+static SortRecord* sorter_record(Sorter* s, const MatchingPath* mp) {
+    const ParsedQuery* pq = s->pq;
+    int pattern_count = pq->match->count;
+    size_t size = sizeof(SortRecord) + pattern_count * sizeof(int);
+    for (int i = 0; i < pq->order_count; i++) {
+        s->keys[i] = path_value(s->gdb, mp, s->refs[i], pq->order_by[i].prop, &s->owned[i]);
+        size += record_string_size(s->keys[i]);
+    }
+    for (int i = 0; i < mp->num_nodes; i++) size += record_string_size(mp->node_ids[i]);
+    for (int i = 0; i < mp->num_rels; i++) size += record_string_size(mp->rel_types[i]);
+
+    SortRecord* rec = malloc(size);
+    rec->seq = s->seq++;
+    rec->size = (unsigned int)size;
+    rec->num_nodes = mp->num_nodes;
+    rec->num_rels = mp->num_rels;
+    memcpy(rec + 1, mp->pattern_pos, pattern_count * sizeof(int));
+    char* out = (char*)(rec + 1) + pattern_count * sizeof(int);
+    for (int i = 0; i < pq->order_count; i++) {
+        out = record_put_string(out, s->keys[i]);
+        free(s->owned[i]);
+        s->owned[i] = NULL;
+    }
+    for (int i = 0; i < mp->num_nodes; i++) out = record_put_string(out, mp->node_ids[i]);
+    for (int i = 0; i < mp->num_rels; i++) out = record_put_string(out, mp->rel_types[i]);
+    return rec;
+}
+
+// Next record of `run`, owned by the caller; NULL at its end. A run that
+// ends inside a record could not be read back: that is reported once and
+// fails the sort, which stops returning rows rather than skip some.
+static SortRecord* run_read(Sorter* s, SortRun* run) {
+    if (s->failed) return NULL;
+    if (!run->file) {
+        if (s->next >= s->count) return NULL;
+        SortRecord* rec = s->records[s->next];
+        s->records[s->next++] = NULL;
+        return rec;
+    }
+    SortRecord header;
+    size_t got = fread(&header, 1, sizeof(header), run->file);
+    if (got == 0 && !ferror(run->file)) return NULL;
+    if (got == sizeof(header) && header.size >= sizeof(header)) {
+        SortRecord* rec = malloc(header.size);
+        *rec = header;
+        if (fread(rec + 1, header.size - sizeof(header), 1, run->file) == 1) return rec;
+        free(rec);
+    }
+    fprintf(stderr, "ORDER BY: cannot read back a temporary file, the query is cut short\n");
+    s->failed = true;
+    return NULL;
+}
+
+// Rewinds runs[first..run_count), plus the in-memory records when `memory`
+// is set, and orders them by their first record
+static void merge_open(Sorter* s, int first, bool memory) {
+    s->merge_count = 0;
+    if (memory) s->next = 0;
+    for (int r = first; r <= s->run_count; r++) {
+        SortRun* run = r < s->run_count ? &s->runs[r] : memory ? &s->memory : NULL;
+        if (!run) break;
+        if (run->file) rewind(run->file);
+        free(run->head);
+        run->head = run_read(s, run);
+        if (!run->head) continue;
+        s->merge[s->merge_count++] = run;
+        heap_sift_up((void**)s->merge, s->merge_count - 1, -1, run_compare, s);
+    }
+}
+
+// Smallest record across the merge inputs, owned by the caller; NULL once all are drained
+static SortRecord* merge_next(Sorter* s) {
+    if (s->merge_count == 0 || s->failed) return NULL;
+    SortRun* run = s->merge[0];
+    SortRecord* rec = run->head;
+    run->head = run_read(s, run);
+    if (!run->head) s->merge[0] = s->merge[--s->merge_count];
+    heap_sift_down((void**)s->merge, s->merge_count, 0, -1, run_compare, s);
+    return rec;
+}
+
+// Writes records to `f`, true when every byte reached it
+static bool run_write(FILE* f, SortRecord* const* records, int count) {
+    for (int i = 0; i < count; i++) {
+        if (fwrite(records[i], records[i]->size, 1, f) != 1) return false;
+    }
+    return fflush(f) == 0 && !ferror(f);
+}
+
+// Merges runs[first..run_count) into one run of `level`. When the merged
+// run cannot be written the inputs are left as they were.
+static bool runs_merge(Sorter* s, int first, int level) {
+    FILE* merged = tmpfile();
+    if (!merged) return false;
+    merge_open(s, first, false);
+    bool ok = true;
+    SortRecord* rec;
+    while (ok && (rec = merge_next(s))) {
+        ok = fwrite(rec, rec->size, 1, merged) == 1;
+        free(rec);
+    }
+    ok = ok && !s->failed && fflush(merged) == 0 && !ferror(merged);
+    for (int r = first; r < s->run_count; r++) {
+        free(s->runs[r].head);
+        s->runs[r].head = NULL;
+    }
+    if (!ok) {
+        fclose(merged);
+        return false;
+    }
+    for (int r = first; r < s->run_count; r++) fclose(s->runs[r].file);
+    s->run_count = first;
+    s->runs[s->run_count++] = (SortRun){merged, NULL, level};
+    return true;
+}
+
+// Writes the buffered records out as one sorted run. Every SORT_MERGE_WAYS
+// runs of one level are merged into a run of the next, so a record is
+// rewritten once per level rather than on every spill; when the slots run
+// out anyway the trailing runs are merged whatever their level. If a run
+// cannot be written the records stay in memory and so do all later ones.
+static void sorter_spill(Sorter* s) {
+    sort_pointers((void**)s->records, s->count, record_compare, s);
+    FILE* f = s->run_count < SORT_MERGE_FANIN ? tmpfile() : NULL;
+    if (!f || !run_write(f, s->records, s->count)) {
+        if (f) fclose(f);
+        fprintf(stderr, "ORDER BY: cannot write a temporary file, sorting in memory\n");
+        s->budget = (size_t)-1;
+        return;
+    }
+    for (int i = 0; i < s->count; i++) free(s->records[i]);
+    s->count = 0;
+    s->bytes = 0;
+    s->runs[s->run_count++] = (SortRun){f, NULL, 0};
+
+    while (s->run_count >= SORT_MERGE_WAYS) {
+        int first = s->run_count - SORT_MERGE_WAYS;
+        int level = s->runs[first].level;
+        bool same = s->runs[s->run_count - 1].level == level;
+        if (!same && s->run_count < SORT_MERGE_FANIN) return;
+        // A forced merge keeps the highest level so the order holds. On
+        // failure the slots may all be taken: the next spill then keeps its
+        // records in memory.
+        if (!runs_merge(s, first, same ? level + 1 : level)) return;
+    }
+}
+
+static void sorter_add(Sorter* s, const MatchingPath* mp) {
+    if (s->keep == 0) return;
+    SortRecord* rec = sorter_record(s, mp);
+    if (s->heap && s->count == s->keep) {
+        // Full: the new path replaces the worst kept one if it sorts before it
+        if (record_compare(s, rec, s->records[0]) >= 0) {
+            free(rec);
+            return;
+        }
+        s->bytes -= s->records[0]->size;
+        free(s->records[0]);
+        s->records[0] = rec;
+        s->bytes += rec->size;
+        heap_sift_down((void**)s->records, s->count, 0, 1, record_compare, s);
+        return;
+    }
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 256;
+        s->records = realloc(s->records, s->capacity * sizeof(SortRecord*));
+    }
+    s->records[s->count++] = rec;
+    s->bytes += rec->size + sizeof(SortRecord*);
+    if (s->heap) heap_sift_up((void**)s->records, s->count - 1, 1, record_compare, s);
+    if (s->bytes <= s->budget) return;
+    // SKIP + LIMIT rows do not fit in memory after all: spill like an unbounded sort
+    s->heap = false;
+    sorter_spill(s);
+}
+
+// Called once every path has been added
+static void sorter_finish(Sorter* s) {
+    sort_pointers((void**)s->records, s->count, record_compare, s);
+    if (s->run_count == 0) return;
+    // The records left in memory, the tail below the budget or those a
+    // failed spill kept, are merged with the runs without being written
+    s->merging = true;
+    merge_open(s, 0, true);
+}
+
+// Next path in order, or NULL when exhausted. The path and its strings are
+// only valid until the next call.
+static const MatchingPath* sorter_next(Sorter* s) {
+    free(s->current);
+    s->current = NULL;
+    const SortRecord* rec;
+    if (s->merging) rec = s->current = merge_next(s);
+    else rec = s->next < s->count ? s->records[s->next++] : NULL;
+    if (!rec) return NULL;
+
+    if (rec->num_nodes > s->out_node_capacity) {
+        s->out_node_capacity = rec->num_nodes;
+        s->out.node_ids = realloc(s->out.node_ids, s->out_node_capacity * sizeof(char*));
+    }
+    if (rec->num_rels > s->out_rel_capacity) {
+        s->out_rel_capacity = rec->num_rels;
+        s->out.rel_types = realloc(s->out.rel_types, s->out_rel_capacity * sizeof(char*));
+    }
+    int pattern_count = s->pq->match->count;
+    s->out.pattern_pos = (int*)(rec + 1);
+    s->out.num_nodes = rec->num_nodes;
+    s->out.num_rels = rec->num_rels;
+    const char* in = record_keys(rec, pattern_count);
+    for (int i = 0; i < s->pq->order_count; i++) record_get_string(&in);
+    for (int i = 0; i < rec->num_nodes; i++) s->out.node_ids[i] = (char*)record_get_string(&in);
+    for (int i = 0; i < rec->num_rels; i++) s->out.rel_types[i] = (char*)record_get_string(&in);
+    return &s->out;
+}
+
+/*******************************
+ * Aggregation
+ *******************************/
+
+typedef struct {
+    long long count;
+    double sum;
+    const char* best;  // min / max, in the arena
+    char** items;      // collect, in the arena
+    int item_count;
+    int item_capacity;
+} AggState;
+
+typedef struct {
+    char** keys;       // grouping values in item order, NULL at aggregate items
+    AggState* states;  // per item
+} AggGroup;
+
+// Hash aggregation over matched paths: rows are folded into per-group state
+// as they stream past, so no row is ever materialized
+typedef struct {
+    GraphDB* gdb;
+    const ParsedQuery* pq;
+    VarRef* refs;      // per item
+    const char** values;
+    char** owned;
+    CypherArena* arena;
+    StrMap* index;     // encoded grouping values -> group
+    StrMap* seen;      // group, item and value of DISTINCT aggregates
+    AggGroup* groups;
+    int group_capacity;
+    char* key;
+    size_t key_capacity;
+} Aggregator;
+
+static void aggregator_key_append(Aggregator* ag, size_t* len, const char* s, size_t n) {
+    if (*len + n + 1 > ag->key_capacity) {
+        ag->key_capacity = (*len + n + 1) * 2;
+        ag->key = realloc(ag->key, ag->key_capacity);
+    }
+    memcpy(ag->key + *len, s, n);
+    *len += n;
+}
+
+static Aggregator* aggregator_create(GraphDB* gdb, const ParsedQuery* pq) {
+    Aggregator* ag = calloc(1, sizeof(Aggregator));
+    int n = pq->return_count;
+    ag->gdb = gdb;
+    ag->pq = pq;
+    ag->refs = malloc(n * sizeof(VarRef));
+    ag->values = malloc(n * sizeof(char*));
+    ag->owned = malloc(n * sizeof(char*));
+    for (int i = 0; i < n; i++) ag->refs[i] = var_ref(pq->match, pq->return_items[i].var);
+    ag->arena = cypher_arena_acquire();
+    ag->index = strmap_create(64);
+    ag->seen = strmap_create(64);
+    return ag;
+}
+
+static void aggregator_destroy(Aggregator* ag) {
+    free(ag->refs);
+    free(ag->values);
+    free(ag->owned);
+    cypher_arena_release(ag->arena);
+    strmap_destroy(ag->index);
+    strmap_destroy(ag->seen);
+    free(ag->key);
+    free(ag);
+}
+
+// As path_value, "*" for count(*)
+static const char* aggregator_value(Aggregator* ag, int i, const MatchingPath* mp) {
+    const ReturnItem* item = &ag->pq->return_items[i];
+    ag->owned[i] = NULL;
+    if (!item->var) return "*";
+    return path_value(ag->gdb, mp, ag->refs[i], item->prop, &ag->owned[i]);
+}
+
+static int aggregator_group(Aggregator* ag) {
+    const ParsedQuery* pq = ag->pq;
+    size_t len = 0;
+    for (int i = 0; i < pq->return_count; i++) {
+        if (pq->return_items[i].agg != AGG_NONE) continue;
+        const char* v = ag->values[i];
+        // Values end in 0x1f; a missing one is a lone 0x1e
+        if (v) aggregator_key_append(ag, &len, v, strlen(v));
+        aggregator_key_append(ag, &len, v ? "\x1f" : "\x1e", 1);
+    }
+    int inserted;
+    int g = strmap_intern(ag->index, ag->key ? ag->key : "", len, &inserted);
+    if (inserted) {
+        ag->groups = cypher_arena_grow(ag->arena, ag->groups, g, &ag->group_capacity, sizeof(AggGroup));
+        AggGroup* group = &ag->groups[g];
+        group->keys = cypher_arena_alloc(ag->arena, pq->return_count * sizeof(char*));
+        group->states = cypher_arena_alloc(ag->arena, pq->return_count * sizeof(AggState));
+        for (int i = 0; i < pq->return_count; i++) {
+            const char* v = ag->values[i];
+            if (pq->return_items[i].agg == AGG_NONE && v) group->keys[i] = cypher_arena_strndup(ag->arena, v, strlen(v));
+        }
+    }
+    return g;
+}
+
+static bool aggregator_first_seen(Aggregator* ag, int g, int i, const char* v) {
+    char prefix[32];
+    int n = snprintf(prefix, sizeof(prefix), "%d:%d:", g, i);
+    size_t len = 0;
+    aggregator_key_append(ag, &len, prefix, n);
+    aggregator_key_append(ag, &len, v, strlen(v));
+    int inserted;
+    strmap_intern(ag->seen, ag->key, len, &inserted);
+    return inserted;
+}
+
+static void aggregator_add(Aggregator* ag, const MatchingPath* mp) {
+    const ParsedQuery* pq = ag->pq;
+    for (int i = 0; i < pq->return_count; i++) ag->values[i] = aggregator_value(ag, i, mp);
+    int g = aggregator_group(ag);
+    for (int i = 0; i < pq->return_count; i++) {
+        const ReturnItem* item = &pq->return_items[i];
+        const char* v = ag->values[i];
+        if (item->agg == AGG_NONE || !v) continue;
+        if (item->distinct && !aggregator_first_seen(ag, g, i, v)) continue;
+        AggState* st = &ag->groups[g].states[i];
+        st->count++;
+        double x;
+        switch (item->agg) {
+            case AGG_SUM:
+                if (parse_number(v, &x)) st->sum += x;
+                break;
+            case AGG_MIN:
+            case AGG_MAX: {
+                int cmp = st->best ? compare_values(v, st->best) : 0;
+                if (!st->best || (item->agg == AGG_MIN ? cmp < 0 : cmp > 0)) st->best = cypher_arena_strndup(ag->arena, v, strlen(v));
+                break;
+            }
+            case AGG_COLLECT:
+                st->items = cypher_arena_grow(ag->arena, st->items, st->item_count, &st->item_capacity, sizeof(char*));
+                st->items[st->item_count++] = cypher_arena_strndup(ag->arena, v, strlen(v));
+                break;
+            default:
+                break;
+        }
+    }
+    for (int i = 0; i < pq->return_count; i++) free(ag->owned[i]);
+}
+
+static char* aggregate_text(CypherResult* result, const ReturnItem* item, const AggState* st) {
+    char buf[64];
+    switch (item->agg) {
+        case AGG_COUNT:
+            snprintf(buf, sizeof(buf), "%lld", st->count);
+            return result_strdup(result, buf);
+        case AGG_SUM:
+            snprintf(buf, sizeof(buf), "%.15g", st->sum);
+            return result_strdup(result, buf);
+        case AGG_MIN:
+        case AGG_MAX:
+            return result_strdup(result, st->best ? st->best : "null");
+        default: {
+            size_t len = 3;
+            for (int i = 0; i < st->item_count; i++) len += strlen(st->items[i]) + 2;
+            char* text = cypher_arena_alloc(result_arena(result), len);
+            strcpy(text, "[");
+            for (int i = 0; i < st->item_count; i++) {
+                if (i > 0) strcat(text, ", ");
+                strcat(text, st->items[i]);
+            }
+            strcat(text, "]");
+            return text;
+        }
+    }
+}
+
+typedef struct {
+    GraphDB* gdb;
+    long long count;
+    char* id;
+    size_t id_capacity;
+} NeighborCount;
+
+// Counts the neighbors that have a node record, as a match binds them; an
+// edge to an id that was never created is skipped
+static int count_existing_neighbor(void* ctx, const char* id, size_t id_len, const char* type, size_t type_len) {
+    NeighborCount* nc = ctx;
+    if (id_len + 1 > nc->id_capacity) {
+        nc->id_capacity = (id_len + 1) * 2;
+        nc->id = realloc(nc->id, nc->id_capacity);
+    }
+    memcpy(nc->id, id, id_len);
+    nc->id[id_len] = '\0';
+    char* label = graphdb_get_node_label(nc->gdb, nc->id);
+    if (label) nc->count++;
+    free(label);
+    return 0;
+}
+
+// count(*) or count(x) over a whole label, or over one directed hop from a
+// node pinned by id. A label is counted off its index keys alone; a hop walks
+// the pinned node's adjacency keys and reads each neighbor's node record, one
+// point get per neighbor, so that dangling edges are left out. False when the query needs the general path; a NULL
+// `count` only asks which (EXPLAIN).
+static bool count_from_index(GraphDB* gdb, const ParsedQuery* pq, long long* count) {
+    const PathPattern* path = pq->match;
+    const ReturnItem* item = &pq->return_items[0];
+    if (pq->return_count != 1 || item->agg != AGG_COUNT || item->distinct || path->count > 2) return false;
+    if (pattern_needs_join(path)) return false;
+    if (item->prop && strcmp(item->prop, "id") != 0) return false;
+    bool bound = !item->var;
+    const char* pinned[2] = {NULL, NULL};
+    for (int h = 0; h < path->count; h++) {
+        pinned[h] = pattern_node_id(&path->nodes[h]);
+        if (item->var && path->nodes[h].var && strcmp(path->nodes[h].var, item->var) == 0) bound = true;
+    }
+    if (path->count == 2 && item->var && !item->prop && path->rels[0].var && strcmp(path->rels[0].var, item->var) == 0) bound = true;
+    if (!bound) return false;
+    for (int c = 0; c < pq->cond_count; c++) {
+        const WhereCondition* wc = &pq->conditions[c];
+        int h = -1;
+        for (int k = 0; k < path->count; k++) {
+            if (path->nodes[k].var && strcmp(path->nodes[k].var, wc->var) == 0) h = k;
+        }
+        if (h == -1 || strcmp(wc->prop, "id") != 0) return false;
+        if (pinned[h] && strcmp(pinned[h], wc->val) != 0) {
+            if (count) *count = 0;
+            return true;
+        }
+        pinned[h] = wc->val;
+    }
+    int p = pinned[0] ? 0 : 1;
+    if (path->count == 2) {
+        const RelPattern* rp = &path->rels[0];
+        if (!rp->direction || rp->min_hops != 1 || rp->max_hops != 1) return false;
+        if (!pinned[p] || pinned[1 - p] || path->nodes[1 - p].label) return false;
+    }
+    if (!count) return true;
+    if (path->count == 1 && !pinned[0]) {
+        *count = graphdb_count_nodes(gdb, path->nodes[0].label, LLONG_MAX);
+        return true;
+    }
+    char* label = graphdb_get_node_label(gdb, pinned[p]);
+    bool exists = label && (!path->nodes[p].label || strcmp(path->nodes[p].label, label) == 0);
+    free(label);
+    if (!exists) *count = 0;
+    else if (path->count == 1) *count = 1;
+    else {
+        NeighborCount nc = {gdb, 0, NULL, 0};
+        graphdb_foreach_neighbor(gdb, pinned[p], path->rels[0].type, rel_walk_direction(&path->rels[0], p == 1), count_existing_neighbor, &nc);
+        free(nc.id);
+        *count = nc.count;
+    }
+    return true;
+}
+
+typedef struct {
+    const Aggregator* ag;
+    const CypherRowResult* rows;
+} GroupOrder;
+
+// ORDER BY over group rows: grouping keys by value (null when missing),
+// aggregates by their text
+static int group_compare(const void* ctx, const void* a, const void* b) {
+    const GroupOrder* o = ctx;
+    const ParsedQuery* pq = o->ag->pq;
+    const CypherRowResult* x = a;
+    const CypherRowResult* y = b;
+    for (int i = 0; i < pq->order_count; i++) {
+        int c = pq->order_by[i].column;
+        const ReturnItem* item = &pq->return_items[c];
+        const AggGroup* gx = &o->ag->groups[x - o->rows];
+        const AggGroup* gy = &o->ag->groups[y - o->rows];
+        const char* vx = x->values[c].value;
+        const char* vy = y->values[c].value;
+        if (item->agg == AGG_NONE) {
+            vx = gx->keys[c];
+            vy = gy->keys[c];
+        } else if (item->agg == AGG_MIN || item->agg == AGG_MAX) {
+            vx = gx->states[c].best;
+            vy = gy->states[c].best;
+        }
+        int cmp = compare_order_key(&pq->order_by[i], vx, vy);
+        if (cmp) return cmp;
+    }
+    return 0;
+}
+
+// Sorts one row per group, then keeps the SKIP / LIMIT window
+static void aggregate_order(CypherResult* result, const Aggregator* ag) {
+    const ParsedQuery* pq = ag->pq;
+    int n = result->row_count;
+    CypherRowResult** order = malloc((n > 0 ? n : 1) * sizeof(CypherRowResult*));
+    for (int r = 0; r < n; r++) order[r] = &result->rows[r];
+    GroupOrder ctx = {ag, result->rows};
+    sort_pointers((void**)order, n, group_compare, &ctx);
+    int first = pq->skip < n ? pq->skip : n;
+    int count = n - first;
+    if (pq->limit >= 0 && pq->limit < count) count = pq->limit;
+    CypherRowResult* rows = cypher_arena_alloc(result_arena(result), (count > 0 ? count : 1) * sizeof(CypherRowResult));
+    for (int r = 0; r < count; r++) rows[r] = *order[first + r];
+    result->rows = rows;
+    result->row_count = count;
+    free(order);
+}
+
+// RETURN with aggregates: one row of values per group (a single row when
+// there are no grouping keys), in first-seen order or by ORDER BY, SKIP /
+// LIMIT applied
+static CypherResult* execute_aggregate(GraphDB* gdb, const ParsedQuery* pq, Profile* profile) {
+    CypherResult* result = cypher_result_create();
+    result_set_columns(result, pq);
+    int capacity = 0;
+    long long count;
+    if (pq->skip == 0 && pq->limit != 0 && count_from_index(gdb, pq, NULL)) {
+        int op = profile_add(profile, "CountFromIndex", describe_path(pq->match), -1, false);
+        if (profile_plan_only(profile)) return result;
+        ProfileMark mark;
+        profile_enter(profile, &mark);
+        count_from_index(gdb, pq, &count);
+        profile_leave(profile, op, &mark, 1);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%lld", count);
+        CypherRowResult* row = result_add_row(result, &capacity);
+        row->value_count = 1;
+        row->values = cypher_arena_alloc(result_arena(result), sizeof(CypherValueResult));
+        row->values[0].name = result_strdup(result, pq->returns[0]);
+        row->values[0].value = result_strdup(result, buf);
+        return result;
+    }
+
+    Aggregator* ag = aggregator_create(gdb, pq);
+    PatternFilters* filters = pattern_filters_create(pq);
+    PatternMatch* match = pattern_match_create(gdb, pq, filters, profile);
+    int filter_op = row_filter_profile(profile, pq, filters, match->prof);
+    int op = profile_add(profile, "Aggregate", describe_items(pq->returns, pq->return_count), filter_op >= 0 ? filter_op : match->prof, false);
+    int sort_op = pq->order_count > 0 ? profile_add(profile, "Sort", describe_order(pq), op, false) : -1;
+    if (profile_plan_only(profile)) {
+        pattern_match_destroy(match);
+        pattern_filters_free(filters, pq->match->count);
+        aggregator_destroy(ag);
+        return result;
+    }
+    const MatchingPath* mp;
+    ProfileMark mark;
+    while ((mp = pattern_match_next(match))) {
+        if (!row_filter_pass(gdb, pq, filters, mp, profile, filter_op)) continue;
+        profile_enter(profile, &mark);
+        aggregator_add(ag, mp);
+        profile_leave(profile, op, &mark, 0);
+    }
+    pattern_match_destroy(match);
+    pattern_filters_free(filters, pq->match->count);
+    profile_enter(profile, &mark);
+
+    if (ag->index->count == 0 && pq->aggregate_count == pq->return_count) {
+        for (int i = 0; i < pq->return_count; i++) ag->values[i] = NULL;
+        aggregator_group(ag);
+    }
+    // Ordered groups are all turned into rows first, so row g is group g
+    bool ordered = pq->order_count > 0;
+    for (int g = 0; g < ag->index->count; g++) {
+        if (!ordered && g < pq->skip) continue;
+        if (!ordered && pq->limit >= 0 && result->row_count >= pq->limit) break;
+        CypherRowResult* row = result_add_row(result, &capacity);
+        row->value_count = pq->return_count;
+        row->values = cypher_arena_alloc(result_arena(result), pq->return_count * sizeof(CypherValueResult));
+        for (int i = 0; i < pq->return_count; i++) {
+            const ReturnItem* item = &pq->return_items[i];
+            row->values[i].name = result_strdup(result, pq->returns[i]);
+            if (item->agg != AGG_NONE) row->values[i].value = aggregate_text(result, item, &ag->groups[g].states[i]);
+            else row->values[i].value = result_strdup(result, ag->groups[g].keys[i] ? ag->groups[g].keys[i] : "null");
+        }
+    }
+    profile_leave(profile, op, &mark, ag->index->count);
+    if (ordered) {
+        profile_enter(profile, &mark);
+        aggregate_order(result, ag);
+        profile_leave(profile, sort_op, &mark, result->row_count);
+    }
+    aggregator_destroy(ag);
+    return result;
+}
+
+static void print_cypher_row(const CypherRowResult* row) {
+    for (int n = 0; n < row->node_count; n++) {
+        const CypherNodeResult* node = &row->nodes[n];
+        printf("(%s:%s)", node->id, node->label ? node->label : "");
+        if (n < row->edge_count) {
+            const CypherEdgeResult* edge = &row->edges[n];
+            printf("-[:%s]->", edge->type ? edge->type : "");
+        }
+    }
+    for (int v = 0; v < row->value_count; v++) {
+        printf("%s%s=%s", (row->node_count > 0 || v > 0) ? " " : "", row->values[v].name, row->values[v].value);
+    }
+    printf("\n");
+}
+
+// Simple pretty-printer for the new structured result
+void print_cypher_result(const CypherResult* result) {
+    if (!result || result->row_count == 0) {
+        printf("No results\n");
+        return;
+    }
+    for (int r = 0; r < result->row_count; r++) print_cypher_row(&result->rows[r]);
+}
+
+// Column-aligned table, numbers right-aligned (EXPLAIN / PROFILE)
+static void print_cypher_table(const CypherResult* result) {
+    int* widths = calloc(result->column_count, sizeof(int));
+    for (int c = 0; c < result->column_count; c++) {
+        widths[c] = (int)strlen(result->columns[c]);
+        for (int r = 0; r < result->row_count; r++) {
+            int len = (int)strlen(result->rows[r].values[c].value);
+            if (len > widths[c]) widths[c] = len;
+        }
+    }
+    for (int r = -1; r < result->row_count; r++) {
+        for (int c = 0; c < result->column_count; c++) {
+            const char* text = r < 0 ? result->columns[c] : result->rows[r].values[c].value;
+            // Text columns are padded on the right, except the last
+            int width = c < 2 ? (c == result->column_count - 1 ? 0 : -widths[c]) : widths[c];
+            printf("%s%*s", c > 0 ? "  " : "", width, text);
+        }
+        printf("\n");
+    }
+    free(widths);
+}
+
+static const CypherResult* cursor_take_plan(CypherCursor* cursor);
+
+// Prints rows as they are produced
+void print_cypher_cursor(CypherCursor* cursor) {
+    const CypherResult* plan = cursor_take_plan(cursor);
+    if (plan) {
+        print_cypher_table(plan);
+        return;
+    }
+    int rows = 0;
+    const CypherRowResult* row;
+    while ((row = cypher_cursor_next(cursor))) {
+        print_cypher_row(row);
+        rows++;
+    }
+    if (rows == 0) printf("No results\n");
+}
+
+/*******************************
+ * Plan cache and prepared statements
+ *******************************/
+
+#define PLAN_CACHE_CAPACITY 256
+
+typedef struct CypherPlan {
+    char* key;          // normalized query text
+    size_t hash;
+    CypherArena* arena; // owns `query`
+    ParsedQuery* query;
+    int refs;           // the cache's own reference plus one per statement
+    struct CypherPlan* prev; // LRU list, most recently used first
+    struct CypherPlan* next;
+    struct CypherPlan* chain; // hash bucket
+} CypherPlan;
+
+typedef struct {
+    CypherPlan** buckets;
+    size_t mask;
+    CypherPlan* head;
+    CypherPlan* tail;
+    int size;
+    long long hits;
+    long long misses;
+} PlanCache;
+
+struct CypherStatement {
+    GraphDB* gdb;
+    CypherPlan* plan;
+    char** values; // bound parameter values, aligned with plan->query->params
+};
+
+static void plan_free(CypherPlan* plan) {
+    free(plan->key);
+    cypher_arena_destroy(plan->arena);
+    free(plan);
+}
+
+// Caller holds plan_mutex
+static void plan_release_locked(CypherPlan* plan) {
+    if (--plan->refs == 0) plan_free(plan);
+}
+
+static void plan_cache_free(void* arg) {
+    PlanCache* cache = (PlanCache*)arg;
+    CypherPlan* plan = cache->head;
+    while (plan) {
+        CypherPlan* next = plan->next;
+        plan_release_locked(plan);
+        plan = next;
+    }
+    free(cache->buckets);
+    free(cache);
+}
+
+static void lru_unlink(PlanCache* cache, CypherPlan* plan) {
+    if (plan->prev) plan->prev->next = plan->next;
+    else cache->head = plan->next;
+    if (plan->next) plan->next->prev = plan->prev;
+    else cache->tail = plan->prev;
+    plan->prev = plan->next = NULL;
+}
+
+static void lru_push_front(PlanCache* cache, CypherPlan* plan) {
+    plan->next = cache->head;
+    if (cache->head) cache->head->prev = plan;
+    cache->head = plan;
+    if (!cache->tail) cache->tail = plan;
+}
+
+// Caller holds plan_mutex
+static void plan_cache_evict_tail(PlanCache* cache) {
+    CypherPlan* victim = cache->tail;
+    CypherPlan** link = &cache->buckets[victim->hash & cache->mask];
+    while (*link != victim) link = &(*link)->chain;
+    *link = victim->chain;
+    lru_unlink(cache, victim);
+    cache->size--;
+    // Statements still holding the plan keep it alive
+    plan_release_locked(victim);
+}
+
+static PlanCache* plan_cache_for(GraphDB* gdb) {
+    if (!gdb->plan_cache) {
+        PlanCache* cache = (PlanCache*)calloc(1, sizeof(PlanCache));
+        size_t buckets = 1;
+        while (buckets < PLAN_CACHE_CAPACITY * 2) buckets *= 2;
+        cache->buckets = (CypherPlan**)calloc(buckets, sizeof(CypherPlan*));
+        cache->mask = buckets - 1;
+        gdb->plan_cache = cache;
+        gdb->plan_cache_free = plan_cache_free;
+    }
+    return (PlanCache*)gdb->plan_cache;
+}
+
+// Returns a referenced plan for `query`, parsing it only on a cache miss
+static CypherPlan* plan_acquire(GraphDB* gdb, const char* query) {
+    char* key = cypher_normalize(query);
+    size_t hash = strmap_hash(key, strlen(key));
+
+    pthread_mutex_lock(&gdb->plan_mutex);
+    PlanCache* cache = plan_cache_for(gdb);
+    for (CypherPlan* plan = cache->buckets[hash & cache->mask]; plan; plan = plan->chain) {
+        if (plan->hash == hash && strcmp(plan->key, key) == 0) {
+            cache->hits++;
+            plan->refs++;
+            lru_unlink(cache, plan);
+            lru_push_front(cache, plan);
+            pthread_mutex_unlock(&gdb->plan_mutex);
+            free(key);
+            return plan;
+        }
+    }
+    cache->misses++;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+
+    // Parse outside the lock so misses on different queries do not serialize
+    CypherArena* arena = cypher_arena_create(4096);
+    CypherParseError err;
+    ParsedQuery* pq = cypher_parse(arena, query, &err);
+    if (!pq) {
+        fprintf(stderr, "Syntax error at line %d, column %d: %s\n", err.line, err.column, err.message);
+        cypher_arena_destroy(arena);
+        free(key);
+        return NULL;
+    }
+    CypherPlan* plan = (CypherPlan*)calloc(1, sizeof(CypherPlan));
+    plan->key = key;
+    plan->hash = hash;
+    plan->arena = arena;
+    plan->query = pq;
+    plan->refs = 2;
+
+    pthread_mutex_lock(&gdb->plan_mutex);
+    for (CypherPlan* other = cache->buckets[hash & cache->mask]; other; other = other->chain) {
+        if (other->hash == hash && strcmp(other->key, key) == 0) {
+            // Lost a race with a concurrent miss: keep the cached copy
+            other->refs++;
+            pthread_mutex_unlock(&gdb->plan_mutex);
+            plan_free(plan);
+            return other;
+        }
+    }
+    if (cache->size >= PLAN_CACHE_CAPACITY) plan_cache_evict_tail(cache);
+    plan->chain = cache->buckets[hash & cache->mask];
+    cache->buckets[hash & cache->mask] = plan;
+    lru_push_front(cache, plan);
+    cache->size++;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+    return plan;
+}
+
+static void plan_release(GraphDB* gdb, CypherPlan* plan) {
+    pthread_mutex_lock(&gdb->plan_mutex);
+    plan_release_locked(plan);
+    pthread_mutex_unlock(&gdb->plan_mutex);
+}
+
+// SKIP / LIMIT parameters: a non-negative integer, anything else counts as 0
+static int bind_count(const char* name, const char* value) {
+    char* end = NULL;
+    long n = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || n < 0) {
+        fprintf(stderr, "Parameter $%s must be a non-negative integer\n", name);
+        return 0;
+    }
+    return n > INT_MAX ? INT_MAX : (int)n;
+}
+
+// Shallow copy of `plan` with bound values in the parameter slots; strings
+// are shared, only arrays holding parameters are copied (into `arena`)
+static ParsedQuery* bind_query(CypherArena* arena, const ParsedQuery* plan, char** values) {
+    ParsedQuery* pq = (ParsedQuery*)cypher_arena_alloc(arena, sizeof(ParsedQuery));
+    *pq = *plan;
+    if (plan->match) {
+        pq->match = (PathPattern*)cypher_arena_alloc(arena, sizeof(PathPattern));
+        *pq->match = *plan->match;
+        pq->match->nodes = (NodePattern*)cypher_arena_alloc(arena, sizeof(NodePattern) * plan->match->count);
+        for (int i = 0; i < plan->match->count; i++) {
+            pq->match->nodes[i] = plan->match->nodes[i];
+            if (plan->match->nodes[i].prop_param) pq->match->nodes[i].prop_value = values[plan->match->nodes[i].prop_param - 1];
+        }
+    }
+    if (plan->cond_count > 0) {
+        pq->conditions = (WhereCondition*)cypher_arena_alloc(arena, sizeof(WhereCondition) * plan->cond_count);
+        for (int i = 0; i < plan->cond_count; i++) {
+            pq->conditions[i] = plan->conditions[i];
+            if (plan->conditions[i].param) pq->conditions[i].val = values[plan->conditions[i].param - 1];
+        }
+    }
+    if (plan->skip_param) pq->skip = bind_count(plan->params[plan->skip_param - 1], values[plan->skip_param - 1]);
+    if (plan->limit_param) pq->limit = bind_count(plan->params[plan->limit_param - 1], values[plan->limit_param - 1]);
+    if (plan->call_arg_count > 0) {
+        pq->call_args = (char**)cypher_arena_alloc(arena, sizeof(char*) * plan->call_arg_count);
+        for (int i = 0; i < plan->call_arg_count; i++) {
+            pq->call_args[i] = plan->call_arg_params[i] ? values[plan->call_arg_params[i] - 1] : plan->call_args[i];
+        }
+    }
+    return pq;
+}
+
+/*******************************
+ * Cursors
+ *******************************/
+
+struct CypherCursor {
+    GraphDB* gdb;
+    CypherPlan* plan;       // referenced until the cursor is closed
+    CypherArena* bound;     // copied parameter values and the bound query (pooled)
+    ParsedQuery* query;
+    PatternFilters* filters;
+    PatternMatch* match;    // MATCH ... RETURN, pulled one row at a time
+    Sorter* sorter;         // or, with ORDER BY, every row sorted on open
+    int skipped;
+    int produced;
+    Projection* projection; // RETURN items of the current MATCH row
+    CypherResult* result;   // any other statement runs to completion on open
+    int result_next;
+    Profile* profile;       // PROFILE / EXPLAIN of the query, with its row operators
+    int filter_op;
+    int distinct_op;
+    int sort_op;
+    int limit_op;
+    int project_op;
+};
+
+// Registers the operators between the match and the rows: Filter, Distinct,
+// Sort (Top under a LIMIT), Limit and Project
+static void cursor_profile(CypherCursor* cursor) {
+    Profile* profile = cursor->profile;
+    const ParsedQuery* pq = cursor->query;
+    cursor->filter_op = cursor->distinct_op = cursor->sort_op = cursor->limit_op = cursor->project_op = -1;
+    if (!profile) return;
+    int last = cursor->match->prof;
+    cursor->filter_op = row_filter_profile(profile, pq, cursor->filters, last);
+    if (cursor->filter_op >= 0) last = cursor->filter_op;
+    if (pq->distinct) last = cursor->distinct_op = profile_add(profile, "Distinct", describe_items(pq->returns, pq->return_count), last, false);
+    if (pq->order_count > 0) last = cursor->sort_op = profile_add(profile, pq->limit >= 0 ? "Top" : "Sort", describe_order(pq), last, false);
+    if (pq->skip > 0 || pq->limit >= 0) {
+        last = cursor->limit_op = profile_add(profile, "Limit", describe_text("skip %d, limit %d", pq->skip, pq->limit), last, false);
+    }
+    cursor->project_op = profile_add(profile, "Project", describe_items(pq->returns, pq->return_count), last, false);
+}
+
+// The row of `mp` the first time it is seen (RETURN DISTINCT), else NULL
+static const CypherRowResult* cursor_distinct(CypherCursor* cursor, const MatchingPath* mp) {
+    ProfileMark mark;
+    profile_enter(cursor->profile, &mark);
+    const CypherRowResult* row = projection_row(cursor->projection, mp);
+    if (!projection_first_seen(cursor->projection, mp)) row = NULL;
+    profile_leave(cursor->profile, cursor->distinct_op, &mark, row != NULL);
+    return row;
+}
+
+// Builds the cursor's operators for cursor->query and, unless it is only
+// explained, runs everything that has to happen before the first row
+static void cursor_start(CypherCursor* cursor) {
+    GraphDB* gdb = cursor->gdb;
+    ParsedQuery* pq = cursor->query;
+    Profile* profile = cursor->profile;
+    if (pq->type == Q_MATCH_RETURN && pq->aggregate_count > 0) {
+        cursor->result = execute_aggregate(gdb, pq, profile);
+    } else if (pq->type == Q_MATCH_RETURN) {
+        cursor->filters = pattern_filters_create(pq);
+        cursor->match = pattern_match_create(gdb, pq, cursor->filters, profile);
+        cursor->projection = projection_create(gdb, pq);
+        cursor_profile(cursor);
+        if (pq->order_count > 0 && !profile_plan_only(profile)) {
+            cursor->sorter = sorter_create(gdb, pq);
+            const MatchingPath* mp;
+            ProfileMark mark;
+            while ((mp = pattern_match_next(cursor->match))) {
+                if (!row_filter_pass(gdb, pq, cursor->filters, mp, profile, cursor->filter_op)) continue;
+                // Duplicates are dropped before they can take a top-k slot
+                if (pq->distinct && !cursor_distinct(cursor, mp)) continue;
+                profile_enter(profile, &mark);
+                sorter_add(cursor->sorter, mp);
+                profile_leave(profile, cursor->sort_op, &mark, 0);
+            }
+            profile_enter(profile, &mark);
+            sorter_finish(cursor->sorter);
+            profile_leave(profile, cursor->sort_op, &mark, 0);
+            pattern_match_destroy(cursor->match);
+            cursor->match = NULL;
+        }
+    } else {
+        cursor->result = execute_parsed_query(gdb, pq, profile);
+    }
+}
+
+static const char* const PROFILE_COLUMNS[] = {
+    "operator", "detail", "rows_in", "rows_out", "seeks", "nexts", "gets",
+    "bytes_read", "bytes_allocated", "block_reads", "cache_hits", "time_ms"
+};
+
+// One row per operator, the one producing the query's rows first. EXPLAIN
+// has the operator and detail columns only. PROFILE figures leave out the
+// input's share when the operator pulls from its input itself.
+static CypherResult* profile_result(const Profile* profile) {
+    CypherResult* result = cypher_result_create();
+    CypherArena* arena = result_arena(result);
+    int columns = profile->analyze ? (int)(sizeof(PROFILE_COLUMNS) / sizeof(PROFILE_COLUMNS[0])) : 2;
+    result->column_count = columns;
+    result->columns = cypher_arena_alloc(arena, columns * sizeof(char*));
+    for (int c = 0; c < columns; c++) result->columns[c] = result_strdup(result, PROFILE_COLUMNS[c]);
+    int capacity = 0;
+    for (int i = profile->count - 1; i >= 0; i--) {
+        const ProfileOp* op = &profile->ops[i];
+        const ProfileOp* in = op->input >= 0 ? &profile->ops[op->input] : NULL;
+        const ProfileOp* sub = op->nested ? in : NULL;
+        CypherRowResult* row = result_add_row(result, &capacity);
+        row->value_count = columns;
+        row->values = cypher_arena_alloc(arena, columns * sizeof(CypherValueResult));
+        for (int c = 0; c < columns; c++) row->values[c].name = result->columns[c];
+        row->values[0].value = result_strdup(result, op->name);
+        row->values[1].value = result_strdup(result, op->detail ? op->detail : "");
+        if (!profile->analyze) continue;
+        long long figures[] = {
+            in ? in->rows : 0,
+            op->rows,
+            (long long)(op->io.seeks - (sub ? sub->io.seeks : 0)),
+            (long long)(op->io.nexts - (sub ? sub->io.nexts : 0)),
+            (long long)(op->io.gets - (sub ? sub->io.gets : 0)),
+            (long long)(op->io.get_bytes - (sub ? sub->io.get_bytes : 0)),
+            (long long)(op->bytes - (sub ? sub->bytes : 0)),
+            (long long)(op->io.block_reads - (sub ? sub->io.block_reads : 0)),
+            (long long)(op->io.cache_hits - (sub ? sub->io.cache_hits : 0)),
+        };
+        char buf[32];
+        for (int c = 2; c < columns - 1; c++) {
+            snprintf(buf, sizeof(buf), "%lld", figures[c - 2] > 0 ? figures[c - 2] : 0);
+            row->values[c].value = result_strdup(result, buf);
+        }
+        long long ns = op->ns - (sub ? sub->ns : 0);
+        snprintf(buf, sizeof(buf), "%.3f", (ns > 0 ? ns : 0) / 1e6);
+        row->values[columns - 1].value = result_strdup(result, buf);
+    }
+    return result;
+}
+
+// EXPLAIN builds the operators of `pq` and stops; PROFILE also runs it to
+// the end, discarding its rows, with RocksDB's perf context counting block
+// reads on this thread and the scan workers
+static CypherResult* profile_query(GraphDB* gdb, ParsedQuery* pq) {
+    Profile profile = {0};
+    profile.analyze = pq->explain == EXPLAIN_PROFILE;
+    if (profile.analyze) graphdb_io_perf(1);
+    if (pq->type == Q_CREATE || pq->type == Q_CALL) {
+        char* detail = pq->type == Q_CALL ? strdup(pq->call_proc) : pq->match ? describe_path(pq->match) : NULL;
+        int op = profile_add(&profile, pq->type == Q_CALL ? "ProcedureCall" : "Create", detail, -1, false);
+        if (profile.analyze) {
+            ProfileMark mark;
+            profile_enter(&profile, &mark);
+            CypherResult* result = execute_parsed_query(gdb, pq, &profile);
+            profile_leave(&profile, op, &mark, result->row_count);
+            free_cypher_result(result);
+        }
+    } else {
+        CypherCursor* cursor = calloc(1, sizeof(CypherCursor));
+        cursor->gdb = gdb;
+        cursor->query = pq;
+        cursor->profile = &profile;
+        cursor_start(cursor);
+        if (profile.analyze) {
+            while (cypher_cursor_next(cursor)) {}
+        }
+        cypher_cursor_close(cursor);
+    }
+    if (profile.analyze) graphdb_io_perf(0);
+    CypherResult* result = profile_result(&profile);
+    profile_free(&profile);
+    return result;
+}
+
+// The EXPLAIN / PROFILE table of `cursor`, which counts as drained from
+// here on; NULL for any other query
+static const CypherResult* cursor_take_plan(CypherCursor* cursor) {
+    if (!cursor || !cursor->query || cursor->query->explain == EXPLAIN_NONE || !cursor->result) return NULL;
+    cursor->result_next = cursor->result->row_count;
+    return cursor->result;
+}
+
+static CypherCursor* cursor_open(GraphDB* gdb, CypherPlan* plan, char** values) {
+    CypherCursor* cursor = (CypherCursor*)calloc(1, sizeof(CypherCursor));
+    cursor->gdb = gdb;
+    cursor->plan = plan;
+    pthread_mutex_lock(&gdb->plan_mutex);
+    plan->refs++;
+    pthread_mutex_unlock(&gdb->plan_mutex);
+
+    ParsedQuery* pq = plan->query;
+    if (pq->param_count > 0) {
+        for (int i = 0; i < pq->param_count; i++) {
+            if (!values || !values[i]) {
+                fprintf(stderr, "Parameter $%s is not bound\n", pq->params[i]);
+                cursor->result = cypher_result_create();
+                return cursor;
+            }
+        }
+        // The statement may be rebound while the cursor is still open
+        cursor->bound = cypher_arena_acquire();
+        char** copies = (char**)cypher_arena_alloc(cursor->bound, sizeof(char*) * pq->param_count);
+        for (int i = 0; i < pq->param_count; i++) copies[i] = cypher_arena_strndup(cursor->bound, values[i], strlen(values[i]));
+        pq = bind_query(cursor->bound, pq, copies);
+    }
+    cursor->query = pq;
+    if (pq->explain != EXPLAIN_NONE) cursor->result = profile_query(gdb, pq);
+    else cursor_start(cursor);
+    return cursor;
+}
+
+static char* copy_string(CypherResult* result, const char* s) {
+    return s ? result_strdup(result, s) : NULL;
+}
+
+// Appends a copy of `src` to `result`
+static void copy_row(CypherResult* result, int* capacity, const CypherRowResult* src) {
+    CypherArena* arena = result_arena(result);
+    CypherRowResult* dst = result_add_row(result, capacity);
+    dst->node_count = src->node_count;
+    dst->nodes = cypher_arena_alloc(arena, sizeof(CypherNodeResult) * src->node_count);
+    for (int i = 0; i < src->node_count; i++) {
+        dst->nodes[i].var = copy_string(result, src->nodes[i].var);
+        dst->nodes[i].id = copy_string(result, src->nodes[i].id);
+        dst->nodes[i].label = copy_string(result, src->nodes[i].label);
+    }
+    dst->edge_count = src->edge_count;
+    dst->edges = cypher_arena_alloc(arena, sizeof(CypherEdgeResult) * src->edge_count);
+    for (int i = 0; i < src->edge_count; i++) {
+        dst->edges[i].var = copy_string(result, src->edges[i].var);
+        dst->edges[i].from_id = copy_string(result, src->edges[i].from_id);
+        dst->edges[i].to_id = copy_string(result, src->edges[i].to_id);
+        dst->edges[i].type = copy_string(result, src->edges[i].type ? src->edges[i].type : "");
+    }
+    dst->value_count = src->value_count;
+    if (src->value_count > 0) {
+        dst->values = cypher_arena_alloc(arena, sizeof(CypherValueResult) * src->value_count);
+        for (int i = 0; i < src->value_count; i++) {
+            dst->values[i].name = copy_string(result, src->values[i].name);
+            dst->values[i].value = copy_string(result, src->values[i].value);
+        }
+    }
+}
+
+// Drains and closes `cursor` into a materialized result
+static CypherResult* cursor_collect(CypherCursor* cursor) {
+    CypherResult* result;
+    if (cursor->result && cursor->result_next == 0) {
+        result = cursor->result;
+        cursor->result = NULL;
+    } else {
+        result = cypher_result_create();
+        if (cursor->query && cursor->query->type == Q_MATCH_RETURN) result_set_columns(result, cursor->query);
+        int capacity = 0;
+        const CypherRowResult* row;
+        while ((row = cypher_cursor_next(cursor))) copy_row(result, &capacity, row);
+    }
+    cypher_cursor_close(cursor);
+    return result;
+}
+
+// Next path that passes the WHERE conditions, in ORDER BY order when sorted
+static const MatchingPath* cursor_next_path(CypherCursor* cursor) {
+    const MatchingPath* mp;
+    if (cursor->sorter) {
+        ProfileMark mark;
+        profile_enter(cursor->profile, &mark);
+        mp = sorter_next(cursor->sorter);
+        profile_leave(cursor->profile, cursor->sort_op, &mark, mp != NULL);
+        return mp;
+    }
+    while ((mp = pattern_match_next(cursor->match))) {
+        if (row_filter_pass(cursor->gdb, cursor->query, cursor->filters, mp, cursor->profile, cursor->filter_op)) return mp;
+    }
+    return NULL;
+}
+
+CypherCursor* cypher_execute_cursor(GraphDB* gdb, const char* query) {
+    if (!gdb || !query) return NULL;
+    CypherPlan* plan = plan_acquire(gdb, query);
+    if (!plan) return NULL;
+    CypherCursor* cursor = cursor_open(gdb, plan, NULL);
+    plan_release(gdb, plan);
+    return cursor;
+}
+
+const CypherRowResult* cypher_cursor_next(CypherCursor* cursor) {
+    if (!cursor) return NULL;
+    if (cursor->result) {
+        if (cursor->result_next >= cursor->result->row_count) return NULL;
+        return &cursor->result->rows[cursor->result_next++];
+    }
+    ParsedQuery* pq = cursor->query;
+    if ((!cursor->match && !cursor->sorter) || (pq->limit >= 0 && cursor->produced >= pq->limit)) return NULL;
+    const MatchingPath* mp;
+    while ((mp = cursor_next_path(cursor))) {
+        // DISTINCT rows are projected to be compared; the others are only
+        // projected once past SKIP. Sorted rows were deduplicated on open.
+        const CypherRowResult* row = NULL;
+        if (pq->distinct && !cursor->sorter && !(row = cursor_distinct(cursor, mp))) continue;
+        if (cursor->skipped < pq->skip) {
+            cursor->skipped++;
+            continue;
+        }
+        cursor->produced++;
+        profile_count(cursor->profile, cursor->limit_op, 1);
+        ProfileMark mark;
+        profile_enter(cursor->profile, &mark);
+        if (!row) row = projection_row(cursor->projection, mp);
+        profile_leave(cursor->profile, cursor->project_op, &mark, 1);
+        return row;
+    }
+    return NULL;
+}
+
+void cypher_cursor_close(CypherCursor* cursor) {
+    if (!cursor) return;
+    projection_destroy(cursor->projection);
+    pattern_match_destroy(cursor->match);
+    sorter_destroy(cursor->sorter);
+    if (cursor->filters) pattern_filters_free(cursor->filters, cursor->query->match->count);
+    free_cypher_result(cursor->result);
+    cypher_arena_release(cursor->bound);
+    if (cursor->plan) plan_release(cursor->gdb, cursor->plan);
+    free(cursor);
+}
+
+CypherStatement* cypher_prepare(GraphDB* gdb, const char* query) {
+    if (!gdb || !query) return NULL;
+    CypherPlan* plan = plan_acquire(gdb, query);
+    if (!plan) return NULL;
+    CypherStatement* stmt = (CypherStatement*)calloc(1, sizeof(CypherStatement));
+    stmt->gdb = gdb;
+    stmt->plan = plan;
+    stmt->values = (char**)calloc(plan->query->param_count > 0 ? plan->query->param_count : 1, sizeof(char*));
+    return stmt;
+}
+
+static int bind_value(CypherStatement* stmt, const char* name, char* value) {
+    if (name[0] == '$') name++;
+    ParsedQuery* pq = stmt->plan->query;
+    for (int i = 0; i < pq->param_count; i++) {
+        if (strcmp(pq->params[i], name) == 0) {
+            free(stmt->values[i]);
+            stmt->values[i] = value;
+            return 0;
+        }
+    }
+    fprintf(stderr, "Unknown parameter $%s\n", name);
+    free(value);
+    return -1;
+}
+
+int cypher_bind_string(CypherStatement* stmt, const char* name, const char* value) {
+    if (!stmt || !name || !value) return -1;
+    return bind_value(stmt, name, strdup(value));
+}
+
+int cypher_bind_int(CypherStatement* stmt, const char* name, long long value) {
+    if (!stmt || !name) return -1;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld", value);
+    return bind_value(stmt, name, strdup(buf));
+}
+
+int cypher_bind_double(CypherStatement* stmt, const char* name, double value) {
+    if (!stmt || !name) return -1;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", value);
+    return bind_value(stmt, name, strdup(buf));
+}
+
+void cypher_clear_bindings(CypherStatement* stmt) {
+    if (!stmt) return;
+    for (int i = 0; i < stmt->plan->query->param_count; i++) {
+        free(stmt->values[i]);
+        stmt->values[i] = NULL;
+    }
+}
+
+CypherResult* cypher_execute(CypherStatement* stmt) {
+    if (!stmt) return cypher_result_create();
+    return cursor_collect(cursor_open(stmt->gdb, stmt->plan, stmt->values));
+}
+
+CypherCursor* cypher_execute_statement_cursor(CypherStatement* stmt) {
+    if (!stmt) return NULL;
+    return cursor_open(stmt->gdb, stmt->plan, stmt->values);
+}
+
+void cypher_finalize(CypherStatement* stmt) {
+    if (!stmt) return;
+    cypher_clear_bindings(stmt);
+    free(stmt->values);
+    plan_release(stmt->gdb, stmt->plan);
+    free(stmt);
+}
+
+void cypher_plan_cache_stats(GraphDB* gdb, CypherPlanCacheStats* stats) {
+    memset(stats, 0, sizeof(CypherPlanCacheStats));
+    if (!gdb) return;
+    pthread_mutex_lock(&gdb->plan_mutex);
+    PlanCache* cache = (PlanCache*)gdb->plan_cache;
+    if (cache) {
+        stats->hits = cache->hits;
+        stats->misses = cache->misses;
+        stats->size = cache->size;
+    }
+    pthread_mutex_unlock(&gdb->plan_mutex);
+}
+
+CypherResult* execute_cypher(GraphDB* gdb, const char* query) {
+    CypherCursor* cursor = cypher_execute_cursor(gdb, query);
+    if (!cursor) return cypher_result_create();
+    return cursor_collect(cursor);
+}
+
+/***************************************
+ * NEW STRUCTURED RESULT IMPLEMENTATION *
+ ***************************************/
+
+// Free result helper (public via header)
+void free_cypher_result(CypherResult* result) {
+    if (!result) return;
+    ResultStorage* storage = (ResultStorage*)result;
+    cypher_arena_release(storage->arena);
+    free(storage);
+}
+
+// Simple JSON serializer for D3.js - produces { "nodes": [{ "id": "...", "label": "..." }], "links": [{ "source": "...", "target": "...", "type": "..." }] }
+// Merges all rows into one graph, deduplicating nodes by id. Nodes and links
+// are written out as rows arrive, so only the set of seen ids is kept.
+typedef struct {
+    StrMap* seen;
+    FILE* nodes;
+    char* nodes_buf;
+    size_t nodes_len;
+    FILE* links;
+    char* links_buf;
+    size_t links_len;
+    int link_count;
+} D3Writer;
+
+static bool d3_begin(D3Writer* w) {
+    memset(w, 0, sizeof(D3Writer));
+    w->nodes = open_memstream(&w->nodes_buf, &w->nodes_len);
+    w->links = open_memstream(&w->links_buf, &w->links_len);
+    if (!w->nodes || !w->links) {
+        if (w->nodes) fclose(w->nodes);
+        if (w->links) fclose(w->links);
+        free(w->nodes_buf);
+        free(w->links_buf);
+        return false;
+    }
+    w->seen = strmap_create(64);
+    return true;
+}
+
+static void d3_add_row(D3Writer* w, const CypherRowResult* row) {
+    for (int n = 0; n < row->node_count; n++) {
+        const CypherNodeResult* node = &row->nodes[n];
+        if (!node->id) continue;
+        int inserted = 0;
+        strmap_intern(w->seen, node->id, strlen(node->id), &inserted);
+        if (!inserted) continue;
+        fprintf(w->nodes, "%s{\"id\":\"%s\",\"label\":\"%s\"}", w->seen->count > 1 ? "," : "", node->id, node->label ? node->label : "");
+    }
+    for (int e = 0; e < row->edge_count; e++) {
+        const CypherEdgeResult* edge = &row->edges[e];
+        if (!edge->from_id || !edge->to_id) continue;
+        fprintf(w->links, "%s{\"source\":\"%s\",\"target\":\"%s\",\"type\":\"%s\"}", w->link_count++ > 0 ? "," : "", edge->from_id, edge->to_id, edge->type ? edge->type : "");
+    }
+}
+
+static char* d3_finish(D3Writer* w) {
+    fclose(w->nodes);
+    fclose(w->links);
+    char* json = NULL;
+    size_t len = 0;
+    FILE* stream = open_memstream(&json, &len);
+    if (stream) {
+        fprintf(stream, "{ \"nodes\": [%s], \"links\": [%s] }", w->nodes_buf, w->links_buf);
+        fclose(stream);
+    } else {
+        json = strdup("{ \"error\": \"Memory error\" }");
+    }
+    free(w->nodes_buf);
+    free(w->links_buf);
+    strmap_destroy(w->seen);
+    return json;
+}
+
+char* cypher_result_to_d3_json(const CypherResult* result) {
+    D3Writer w;
+    if (!d3_begin(&w)) return strdup("{ \"error\": \"Memory error\" }");
+    for (int r = 0; result && r < result->row_count; r++) d3_add_row(&w, &result->rows[r]);
+    return d3_finish(&w);
+}
+
+char* cypher_cursor_to_d3_json(CypherCursor* cursor) {
+    D3Writer w;
+    if (!d3_begin(&w)) return strdup("{ \"error\": \"Memory error\" }");
+    const CypherRowResult* row;
+    while ((row = cypher_cursor_next(cursor))) d3_add_row(&w, row);
+    return d3_finish(&w);
 }
 
 void free_d3_json(char* json) {
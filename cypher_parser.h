@@ -18,27 +18,98 @@ typedef struct {
     char* type;    // Relationship type
 } CypherEdgeResult;
 
+typedef struct {
+    char* name;  // Column name, e.g. "score"
+    char* value; // Scalar value rendered as text
+} CypherValueResult;
+
+// A MATCH ... RETURN row has one value per RETURN column, in order: the
+// value itself ("null" when missing), a node's id, a relationship's type
+// ("[T1, T2]" over a variable-length hop) or a path's text. Returned nodes,
+// relationships and paths are also listed in nodes / edges with their
+// labels and endpoints; nothing else is, so `RETURN b.id` carries no nodes.
 typedef struct {
     CypherNodeResult* nodes;
     int node_count;
     CypherEdgeResult* edges;
     int edge_count;
+    CypherValueResult* values;
+    int value_count;
 } CypherRowResult;
 
 typedef struct {
     CypherRowResult* rows;
     int row_count;
+    char** columns;  // RETURN column names of a MATCH query, the EXPLAIN / PROFILE columns, else NULL
+    int column_count;
 } CypherResult;
 
 // Core API
 CypherResult* execute_cypher(GraphDB* gdb, const char* query);
 void free_cypher_result(CypherResult* result);
 
+// Prepared statements. The parsed plan is shared through a per-database LRU
+// cache keyed by the normalized query text, so preparing (or executing) the
+// same query shape again skips parsing. `$name` placeholders are bound by name
+// (with or without the '$') and keep their value across executions. A
+// statement may be used by one thread at a time; different statements can
+// run concurrently.
+typedef struct CypherStatement CypherStatement;
+
+CypherStatement* cypher_prepare(GraphDB* gdb, const char* query); // NULL on syntax error
+int cypher_bind_string(CypherStatement* stmt, const char* name, const char* value); // 0, or -1 if unknown
+int cypher_bind_int(CypherStatement* stmt, const char* name, long long value);
+int cypher_bind_double(CypherStatement* stmt, const char* name, double value);
+void cypher_clear_bindings(CypherStatement* stmt);
+// Empty result if a parameter is unbound
+CypherResult* cypher_execute(CypherStatement* stmt);
+void cypher_finalize(CypherStatement* stmt);
+
+typedef struct {
+    long long hits;
+    long long misses;
+    int size;
+} CypherPlanCacheStats;
+
+void cypher_plan_cache_stats(GraphDB* gdb, CypherPlanCacheStats* stats);
+
+// Depth explored by variable-length hops without an upper bound (`*`,
+// `*2..`); 0 restores the default of 20. Explicit bounds are not capped.
+void cypher_set_max_hops(GraphDB* gdb, int hops);
+
+// Bytes of rows an ORDER BY without LIMIT holds in memory before it spills
+// sorted runs to temporary files; 0 restores the default of 64 MiB
+void cypher_set_sort_memory(GraphDB* gdb, size_t bytes);
+
+// Threads that expand a MATCH whose start node is scanned (a label or all
+// nodes) once the scan spans more than 1024 nodes; 1 runs every query on
+// the calling thread, 0 restores the default of one per core. Rows keep
+// their serial order.
+void cypher_set_query_threads(GraphDB* gdb, int threads);
+
+// Streaming execution. MATCH ... RETURN rows are produced one at a time by a
+// pull-based walk, so the first row is available before the rest are
+// matched; other statements run to completion when the cursor is opened.
+// The returned row and every string it points to are reused by the next
+// call to cypher_cursor_next and released by cypher_cursor_close. Rows come
+// in traversal order unless the query has an ORDER BY, in which case every
+// row is matched and sorted when the cursor is opened. execute_cypher /
+// cypher_execute collect a cursor into a CypherResult.
+typedef struct CypherCursor CypherCursor;
+
+CypherCursor* cypher_execute_cursor(GraphDB* gdb, const char* query); // NULL on syntax error
+// Parameter values are copied, so the statement may be rebound while it is open
+CypherCursor* cypher_execute_statement_cursor(CypherStatement* stmt);
+const CypherRowResult* cypher_cursor_next(CypherCursor* cursor); // NULL when exhausted
+void cypher_cursor_close(CypherCursor* cursor);
+
 // Convenience utility for CLI output
 void print_cypher_result(const CypherResult* result);
+void print_cypher_cursor(CypherCursor* cursor); // drains the cursor; EXPLAIN / PROFILE print as a table
 
 // Convenience utility for D3.js integration
 char* cypher_result_to_d3_json(const CypherResult* result);
+char* cypher_cursor_to_d3_json(CypherCursor* cursor); // drains the cursor
 void free_d3_json(char* json);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,1460 @@
+// graph_algo.c
+#include "graph_algo.h"
+#include "strmap.h"
+#include <rocksdb/c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <math.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static int default_threads(int threads) {
+    if (threads > 0) return threads;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+static int key_compare(const char* a, size_t alen, const char* b, size_t blen) {
+    int c = memcmp(a, b, alen < blen ? alen : blen);
+    if (c != 0) return c;
+    return (alen > blen) - (alen < blen);
+}
+
+/*******************************
+ * Parallel helpers
+ *******************************/
+
+typedef void (*ParallelFn)(void* ctx, int worker, int begin, int end);
+
+typedef struct {
+    ParallelFn fn;
+    void* ctx;
+    int worker;
+    int begin;
+    int end;
+} ParallelTask;
+
+static void* parallel_task_main(void* arg) {
+    ParallelTask* task = (ParallelTask*)arg;
+    task->fn(task->ctx, task->worker, task->begin, task->end);
+    return NULL;
+}
+
+// Runs fn over [bounds[w], bounds[w + 1]) for every worker w, the last one on the calling thread
+static void parallel_run(int workers, const int* bounds, ParallelFn fn, void* ctx) {
+    ParallelTask* tasks = (ParallelTask*)malloc(sizeof(ParallelTask) * workers);
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * workers);
+    for (int w = 0; w < workers; w++) {
+        tasks[w].fn = fn;
+        tasks[w].ctx = ctx;
+        tasks[w].worker = w;
+        tasks[w].begin = bounds[w];
+        tasks[w].end = bounds[w + 1];
+    }
+    for (int w = 0; w < workers - 1; w++) {
+        pthread_create(&threads[w], NULL, parallel_task_main, &tasks[w]);
+    }
+    parallel_task_main(&tasks[workers - 1]);
+    for (int w = 0; w < workers - 1; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    free(threads);
+    free(tasks);
+}
+
+static void even_bounds(int n, int parts, int* bounds) {
+    for (int p = 0; p <= parts; p++) bounds[p] = (int)((long long)n * p / parts);
+}
+
+// Splits nodes so every chunk covers roughly the same number of edges (plus one unit per node)
+static void degree_balanced_bounds(const long long* offsets, int n, int parts, int* bounds) {
+    long long total = offsets[n] + n;
+    bounds[0] = 0;
+    int v = 0;
+    for (int p = 1; p < parts; p++) {
+        long long target = total * p / parts;
+        while (v < n && offsets[v] + v < target) v++;
+        bounds[p] = v;
+    }
+    bounds[parts] = n;
+}
+
+// Reusable barrier (pthread_barrier_t is not available on macOS)
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int count;
+    int waiting;
+    int generation;
+} AlgoBarrier;
+
+static void barrier_init(AlgoBarrier* b, int count) {
+    pthread_mutex_init(&b->mutex, NULL);
+    pthread_cond_init(&b->cond, NULL);
+    b->count = count;
+    b->waiting = 0;
+    b->generation = 0;
+}
+
+static void barrier_wait(AlgoBarrier* b) {
+    pthread_mutex_lock(&b->mutex);
+    int generation = b->generation;
+    if (++b->waiting == b->count) {
+        b->waiting = 0;
+        b->generation++;
+        pthread_cond_broadcast(&b->cond);
+    } else {
+        while (generation == b->generation) pthread_cond_wait(&b->cond, &b->mutex);
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+static void barrier_destroy(AlgoBarrier* b) {
+    pthread_mutex_destroy(&b->mutex);
+    pthread_cond_destroy(&b->cond);
+}
+
+/*******************************
+ * CSR snapshot
+ *******************************/
+
+static int csr_lookup(const GraphCSR* csr, const char* id, size_t len) {
+    size_t slot = strmap_hash(id, len) & csr->index_mask;
+    while (csr->index_table[slot] != -1) {
+        const char* cand = csr->ids[csr->index_table[slot]];
+        if (strncmp(cand, id, len) == 0 && cand[len] == '\0') return csr->index_table[slot];
+        slot = (slot + 1) & csr->index_mask;
+    }
+    return -1;
+}
+
+int graphdb_csr_index_of(const GraphCSR* csr, const char* node_id) {
+    if (!csr || !node_id) return -1;
+    return csr_lookup(csr, node_id, strlen(node_id));
+}
+
+// Reads every `N` key into one contiguous pool and builds the id -> index table
+static void csr_load_nodes(GraphCSR* csr, rocksdb_t* db, rocksdb_readoptions_t* readoptions) {
+    size_t pool_len = 0, pool_cap = 4096;
+    size_t* starts = NULL;
+    int cap = 0;
+    csr->id_pool = (char*)malloc(pool_cap);
+    csr->node_count = 0;
+
+    rocksdb_iterator_t* it = rocksdb_create_iterator(db, readoptions);
+    rocksdb_iter_seek(it, "N", 1);
+    while (rocksdb_iter_valid(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen <= 1 || key[0] != 'N') break;
+        size_t id_len = klen - 1;
+        if (pool_len + id_len + 1 > pool_cap) {
+            while (pool_len + id_len + 1 > pool_cap) pool_cap *= 2;
+            csr->id_pool = (char*)realloc(csr->id_pool, pool_cap);
+        }
+        if (csr->node_count >= cap) {
+            cap = cap ? cap * 2 : 1024;
+            starts = (size_t*)realloc(starts, sizeof(size_t) * cap);
+        }
+        memcpy(csr->id_pool + pool_len, key + 1, id_len);
+        csr->id_pool[pool_len + id_len] = '\0';
+        starts[csr->node_count++] = pool_len;
+        pool_len += id_len + 1;
+        rocksdb_iter_next(it);
+    }
+    rocksdb_iter_destroy(it);
+
+    csr->ids = (char**)malloc(sizeof(char*) * (csr->node_count + 1));
+    for (int i = 0; i < csr->node_count; i++) csr->ids[i] = csr->id_pool + starts[i];
+    free(starts);
+
+    size_t table_size = 16;
+    while (table_size < (size_t)csr->node_count * 2) table_size *= 2;
+    csr->index_mask = table_size - 1;
+    csr->index_table = (int*)malloc(sizeof(int) * table_size);
+    memset(csr->index_table, 0xff, sizeof(int) * table_size);
+    for (int i = 0; i < csr->node_count; i++) {
+        size_t slot = strmap_hash(csr->ids[i], strlen(csr->ids[i])) & csr->index_mask;
+        while (csr->index_table[slot] != -1) slot = (slot + 1) & csr->index_mask;
+        csr->index_table[slot] = i;
+    }
+}
+
+typedef struct EdgeScanRange EdgeScanRange;
+typedef void (*EdgeVisitFn)(EdgeScanRange* range, int from, int to);
+
+// Key-range partition of the `O` keyspace scanned by one worker
+struct EdgeScanRange {
+    rocksdb_t* db;
+    rocksdb_readoptions_t* readoptions;
+    const GraphCSR* csr;
+    const char* type;
+    size_t type_len;
+    char* lo;
+    size_t lo_len;
+    char* hi;
+    size_t hi_len;
+    EdgeVisitFn visit;
+    void* visit_ctx;
+    int* edges; // (from, to) pairs, filled by collect_edge
+    long long edge_count;
+    long long edge_cap;
+};
+
+// Splits an `O<from>:<type>:<to>` key; returns 0 for malformed keys
+static int parse_edge_key(const char* key, size_t klen, const char** from, size_t* from_len,
+                          const char** type, size_t* type_len, const char** to, size_t* to_len) {
+    const char* end = key + klen;
+    const char* p = key + 1;
+    const char* colon = memchr(p, ':', end - p);
+    if (!colon) return 0;
+    *from = p;
+    *from_len = colon - p;
+    p = colon + 1;
+    colon = memchr(p, ':', end - p);
+    if (!colon) return 0;
+    *type = p;
+    *type_len = colon - p;
+    *to = colon + 1;
+    *to_len = end - (colon + 1);
+    return 1;
+}
+
+static void edge_scan_worker(void* ctx, int worker, int begin, int end) {
+    EdgeScanRange* range = &((EdgeScanRange*)ctx)[worker];
+    rocksdb_iterator_t* it = rocksdb_create_iterator(range->db, range->readoptions);
+    rocksdb_iter_seek(it, range->lo, range->lo_len);
+    while (rocksdb_iter_valid(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen == 0 || key[0] != 'O') break;
+        if (range->hi && key_compare(key, klen, range->hi, range->hi_len) >= 0) break;
+        const char *from, *type, *to;
+        size_t from_len, type_len, to_len;
+        if (parse_edge_key(key, klen, &from, &from_len, &type, &type_len, &to, &to_len) &&
+            (range->type_len == 0 || graphdb_type_matches(range->type, type, type_len))) {
+            int u = csr_lookup(range->csr, from, from_len);
+            int v = csr_lookup(range->csr, to, to_len);
+            if (u >= 0 && v >= 0) range->visit(range, u, v);
+        }
+        rocksdb_iter_next(it);
+    }
+    rocksdb_iter_destroy(it);
+}
+
+static void collect_edge(EdgeScanRange* range, int u, int v) {
+    if (range->edge_count >= range->edge_cap) {
+        range->edge_cap = range->edge_cap ? range->edge_cap * 2 : 4096;
+        range->edges = (int*)realloc(range->edges, sizeof(int) * 2 * range->edge_cap);
+    }
+    range->edges[2 * range->edge_count] = u;
+    range->edges[2 * range->edge_count + 1] = v;
+    range->edge_count++;
+}
+
+// Streams every edge of `type` between known nodes through `visit`. The `O`
+// keyspace is partitioned by node id boundaries, one key range per worker.
+static EdgeScanRange* scan_edges(GraphDB* gdb, rocksdb_readoptions_t* readoptions, const GraphCSR* csr,
+                                 const char* type, int workers, EdgeVisitFn visit, void* visit_ctx) {
+    EdgeScanRange* ranges = (EdgeScanRange*)calloc(workers, sizeof(EdgeScanRange));
+    int* bounds = (int*)malloc(sizeof(int) * (workers + 1));
+    even_bounds(csr->node_count, workers, bounds);
+    size_t type_len = type ? strlen(type) : 0;
+    for (int w = 0; w < workers; w++) {
+        EdgeScanRange* r = &ranges[w];
+        r->db = gdb->db;
+        r->readoptions = readoptions;
+        r->csr = csr;
+        r->type = type;
+        r->type_len = type_len;
+        r->visit = visit;
+        r->visit_ctx = visit_ctx;
+        if (w == 0) {
+            r->lo = strdup("O");
+            r->lo_len = 1;
+        } else {
+            r->lo_len = 1 + strlen(csr->ids[bounds[w]]);
+            r->lo = (char*)malloc(r->lo_len + 1);
+            sprintf(r->lo, "O%s", csr->ids[bounds[w]]);
+        }
+        if (w < workers - 1) {
+            r->hi_len = 1 + strlen(csr->ids[bounds[w + 1]]);
+            r->hi = (char*)malloc(r->hi_len + 1);
+            sprintf(r->hi, "O%s", csr->ids[bounds[w + 1]]);
+        }
+    }
+    parallel_run(workers, bounds, edge_scan_worker, ranges);
+    free(bounds);
+    return ranges;
+}
+
+static void free_edge_ranges(EdgeScanRange* ranges, int workers) {
+    for (int w = 0; w < workers; w++) {
+        free(ranges[w].edges);
+        free(ranges[w].lo);
+        free(ranges[w].hi);
+    }
+    free(ranges);
+}
+
+// Read options pinned to a fresh snapshot, without polluting the block cache
+static rocksdb_readoptions_t* scan_readoptions_create(GraphDB* gdb, const rocksdb_snapshot_t** snapshot) {
+    *snapshot = rocksdb_create_snapshot(gdb->db);
+    rocksdb_readoptions_t* readoptions = rocksdb_readoptions_create();
+    rocksdb_readoptions_set_snapshot(readoptions, *snapshot);
+    rocksdb_readoptions_set_fill_cache(readoptions, 0);
+    rocksdb_readoptions_set_readahead_size(readoptions, 2ULL * 1024 * 1024);
+    return readoptions;
+}
+
+static void scan_readoptions_destroy(GraphDB* gdb, rocksdb_readoptions_t* readoptions, const rocksdb_snapshot_t* snapshot) {
+    rocksdb_readoptions_destroy(readoptions);
+    rocksdb_release_snapshot(gdb->db, snapshot);
+}
+
+static int clamp_workers(int threads, int n) {
+    threads = default_threads(threads);
+    if (threads > n) threads = n > 0 ? n : 1;
+    return threads;
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int is_sorted_ints(const int* a, long long n) {
+    for (long long i = 1; i < n; i++) {
+        if (a[i - 1] > a[i]) return 0;
+    }
+    return 1;
+}
+
+// Keys under one `O<from>:<type>:` prefix already arrive in id order, so most
+// lists only need the check; multi-type and incoming lists may need a sort.
+static void sort_adjacency_worker(void* ctx, int worker, int begin, int end) {
+    GraphCSR* csr = (GraphCSR*)ctx;
+    for (int v = begin; v < end; v++) {
+        int* list = csr->out_targets + csr->out_offsets[v];
+        long long deg = csr->out_offsets[v + 1] - csr->out_offsets[v];
+        if (!is_sorted_ints(list, deg)) qsort(list, deg, sizeof(int), compare_ints);
+        list = csr->in_sources + csr->in_offsets[v];
+        deg = csr->in_offsets[v + 1] - csr->in_offsets[v];
+        if (!is_sorted_ints(list, deg)) qsort(list, deg, sizeof(int), compare_ints);
+    }
+}
+
+GraphCSR* graphdb_csr_build(GraphDB* gdb, const char* type, int threads) {
+    if (!gdb) return NULL;
+    GraphCSR* csr = (GraphCSR*)calloc(1, sizeof(GraphCSR));
+
+    // Both scans read from one snapshot so nodes and edges are consistent
+    const rocksdb_snapshot_t* snapshot;
+    rocksdb_readoptions_t* readoptions = scan_readoptions_create(gdb, &snapshot);
+    csr_load_nodes(csr, gdb->db, readoptions);
+    int n = csr->node_count;
+    threads = clamp_workers(threads, n);
+    EdgeScanRange* ranges = scan_edges(gdb, readoptions, csr, type, threads, collect_edge, NULL);
+    scan_readoptions_destroy(gdb, readoptions, snapshot);
+
+    // Counting sort of the collected pairs into out/in adjacency
+    long long m = 0;
+    for (int w = 0; w < threads; w++) m += ranges[w].edge_count;
+    csr->edge_count = m;
+    csr->out_offsets = (long long*)calloc(n + 1, sizeof(long long));
+    csr->in_offsets = (long long*)calloc(n + 1, sizeof(long long));
+    csr->out_targets = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    csr->in_sources = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    for (int w = 0; w < threads; w++) {
+        for (long long e = 0; e < ranges[w].edge_count; e++) {
+            csr->out_offsets[ranges[w].edges[2 * e] + 1]++;
+            csr->in_offsets[ranges[w].edges[2 * e + 1] + 1]++;
+        }
+    }
+    for (int v = 0; v < n; v++) {
+        csr->out_offsets[v + 1] += csr->out_offsets[v];
+        csr->in_offsets[v + 1] += csr->in_offsets[v];
+    }
+    long long* out_pos = (long long*)malloc(sizeof(long long) * (n + 1));
+    long long* in_pos = (long long*)malloc(sizeof(long long) * (n + 1));
+    memcpy(out_pos, csr->out_offsets, sizeof(long long) * (n + 1));
+    memcpy(in_pos, csr->in_offsets, sizeof(long long) * (n + 1));
+    for (int w = 0; w < threads; w++) {
+        for (long long e = 0; e < ranges[w].edge_count; e++) {
+            int u = ranges[w].edges[2 * e];
+            int v = ranges[w].edges[2 * e + 1];
+            csr->out_targets[out_pos[u]++] = v;
+            csr->in_sources[in_pos[v]++] = u;
+        }
+    }
+    free(out_pos);
+    free(in_pos);
+    free_edge_ranges(ranges, threads);
+
+    // Sorted neighbor arrays make merges and intersections cheap for callers
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    degree_balanced_bounds(csr->out_offsets, n, threads, bounds);
+    parallel_run(threads, bounds, sort_adjacency_worker, csr);
+    free(bounds);
+    return csr;
+}
+
+void graphdb_csr_free(GraphCSR* csr) {
+    if (!csr) return;
+    free(csr->ids);
+    free(csr->id_pool);
+    free(csr->index_table);
+    free(csr->out_offsets);
+    free(csr->out_targets);
+    free(csr->in_offsets);
+    free(csr->in_sources);
+    free(csr);
+}
+
+static GraphNodeScores* scores_create(GraphCSR* csr, double* values) {
+    GraphNodeScores* scores = (GraphNodeScores*)malloc(sizeof(GraphNodeScores));
+    scores->count = csr->node_count;
+    scores->ids = csr->ids;
+    scores->values = values;
+    scores->error_bound = 0.0;
+    scores->graph = csr;
+    return scores;
+}
+
+void graphdb_free_node_scores(GraphNodeScores* scores) {
+    if (!scores) return;
+    graphdb_csr_free(scores->graph);
+    free(scores->values);
+    free(scores);
+}
+
+double graphdb_node_score(const GraphNodeScores* scores, const char* node_id) {
+    int v = scores ? graphdb_csr_index_of(scores->graph, node_id) : -1;
+    return v >= 0 ? scores->values[v] : 0.0;
+}
+
+void graphdb_write_node_scores(GraphDB* gdb, const GraphNodeScores* scores, const char* prop) {
+    if (!gdb || !scores || scores->count == 0) return;
+    char** values = (char**)malloc(sizeof(char*) * scores->count);
+    char* buffer = (char*)malloc((size_t)scores->count * 32);
+    for (int i = 0; i < scores->count; i++) {
+        values[i] = buffer + (size_t)i * 32;
+        snprintf(values[i], 32, "%.10g", scores->values[i]);
+    }
+    graphdb_set_node_properties(gdb, prop, (const char**)scores->ids, (const char**)values, scores->count);
+    free(buffer);
+    free(values);
+}
+
+/*******************************
+ * PageRank
+ *******************************/
+
+typedef struct {
+    const GraphCSR* csr;
+    int iters;
+    double damping;
+    int workers;
+    int* bounds;
+    double* rank;
+    double* next;
+    double* contrib;      // rank[u] / outdeg(u) for the current iteration
+    double* next_contrib;
+    double* dangling;     // per-worker rank mass of nodes without out-edges
+    double dangling_total;
+    AlgoBarrier barrier;
+} PageRankState;
+
+typedef struct {
+    PageRankState* state;
+    int worker;
+} PageRankWorker;
+
+static void* pagerank_worker(void* arg) {
+    PageRankWorker* pw = (PageRankWorker*)arg;
+    PageRankState* st = pw->state;
+    const GraphCSR* csr = st->csr;
+    int begin = st->bounds[pw->worker], end = st->bounds[pw->worker + 1];
+    double n = (double)csr->node_count;
+    double* contrib = st->contrib;
+    double* next_contrib = st->next_contrib;
+
+    for (int it = 0; it < st->iters; it++) {
+        double base = (1.0 - st->damping) / n + st->damping * st->dangling_total / n;
+        double dangling = 0.0;
+        for (int v = begin; v < end; v++) {
+            double sum = 0.0;
+            for (long long e = csr->in_offsets[v]; e < csr->in_offsets[v + 1]; e++) {
+                sum += contrib[csr->in_sources[e]];
+            }
+            double r = base + st->damping * sum;
+            st->next[v] = r;
+            long long outdeg = csr->out_offsets[v + 1] - csr->out_offsets[v];
+            if (outdeg > 0) {
+                next_contrib[v] = r / (double)outdeg;
+            } else {
+                next_contrib[v] = 0.0;
+                dangling += r;
+            }
+        }
+        st->dangling[pw->worker] = dangling;
+        barrier_wait(&st->barrier);
+        if (pw->worker == 0) {
+            double total = 0.0;
+            for (int w = 0; w < st->workers; w++) total += st->dangling[w];
+            st->dangling_total = total;
+            double* tmp = st->rank;
+            st->rank = st->next;
+            st->next = tmp;
+        }
+        double* tmp = contrib;
+        contrib = next_contrib;
+        next_contrib = tmp;
+        barrier_wait(&st->barrier);
+    }
+    return NULL;
+}
+
+GraphNodeScores* graphdb_pagerank(GraphDB* gdb, const char* type, int iters, double damping, int threads) {
+    threads = default_threads(threads);
+    GraphCSR* csr = graphdb_csr_build(gdb, type, threads);
+    if (!csr) return NULL;
+    int n = csr->node_count;
+    if (n == 0) return scores_create(csr, NULL);
+    if (threads > n) threads = n;
+
+    PageRankState st;
+    st.csr = csr;
+    st.iters = iters;
+    st.damping = damping;
+    st.workers = threads;
+    st.bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    degree_balanced_bounds(csr->in_offsets, n, threads, st.bounds);
+    st.rank = (double*)malloc(sizeof(double) * n);
+    st.next = (double*)malloc(sizeof(double) * n);
+    st.contrib = (double*)malloc(sizeof(double) * n);
+    st.next_contrib = (double*)malloc(sizeof(double) * n);
+    st.dangling = (double*)calloc(threads, sizeof(double));
+    st.dangling_total = 0.0;
+    for (int v = 0; v < n; v++) {
+        st.rank[v] = 1.0 / n;
+        long long outdeg = csr->out_offsets[v + 1] - csr->out_offsets[v];
+        st.contrib[v] = outdeg > 0 ? st.rank[v] / (double)outdeg : 0.0;
+        if (outdeg == 0) st.dangling_total += st.rank[v];
+    }
+    barrier_init(&st.barrier, threads);
+
+    PageRankWorker* workers = (PageRankWorker*)malloc(sizeof(PageRankWorker) * threads);
+    pthread_t* tids = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    for (int w = 0; w < threads; w++) {
+        workers[w].state = &st;
+        workers[w].worker = w;
+        if (w > 0) pthread_create(&tids[w], NULL, pagerank_worker, &workers[w]);
+    }
+    pagerank_worker(&workers[0]);
+    for (int w = 1; w < threads; w++) pthread_join(tids[w], NULL);
+
+    barrier_destroy(&st.barrier);
+    free(tids);
+    free(workers);
+    free(st.bounds);
+    free(st.next);
+    free(st.contrib);
+    free(st.next_contrib);
+    free(st.dangling);
+    return scores_create(csr, st.rank);
+}
+
+/*******************************
+ * Weakly connected components
+ *******************************/
+
+// Path-halving find; concurrent unions only ever move parents towards smaller roots
+static int uf_find(atomic_int* parent, int x) {
+    while (1) {
+        int p = atomic_load_explicit(&parent[x], memory_order_relaxed);
+        if (p == x) return x;
+        int gp = atomic_load_explicit(&parent[p], memory_order_relaxed);
+        if (gp != p) atomic_compare_exchange_weak_explicit(&parent[x], &p, gp, memory_order_relaxed, memory_order_relaxed);
+        x = gp;
+    }
+}
+
+// Links the larger root under the smaller one with a CAS, retrying if either root moved
+static void uf_union(atomic_int* parent, int u, int v) {
+    while (1) {
+        u = uf_find(parent, u);
+        v = uf_find(parent, v);
+        if (u == v) return;
+        if (u < v) {
+            int tmp = u;
+            u = v;
+            v = tmp;
+        }
+        int expected = u;
+        if (atomic_compare_exchange_strong_explicit(&parent[u], &expected, v, memory_order_acq_rel, memory_order_relaxed)) return;
+    }
+}
+
+static void union_edge(EdgeScanRange* range, int u, int v) {
+    uf_union((atomic_int*)range->visit_ctx, u, v);
+}
+
+typedef struct {
+    atomic_int* parent;
+    int* component;
+} CompressCtx;
+
+static void compress_worker(void* ctx, int worker, int begin, int end) {
+    CompressCtx* cc = (CompressCtx*)ctx;
+    for (int v = begin; v < end; v++) cc->component[v] = uf_find(cc->parent, v);
+}
+
+GraphComponents* graphdb_connected_components(GraphDB* gdb, const char* type, int threads) {
+    if (!gdb) return NULL;
+    GraphCSR* nodes = (GraphCSR*)calloc(1, sizeof(GraphCSR));
+    const rocksdb_snapshot_t* snapshot;
+    rocksdb_readoptions_t* readoptions = scan_readoptions_create(gdb, &snapshot);
+    csr_load_nodes(nodes, gdb->db, readoptions);
+    int n = nodes->node_count;
+    threads = clamp_workers(threads, n);
+
+    atomic_int* parent = (atomic_int*)malloc(sizeof(atomic_int) * (n > 0 ? n : 1));
+    for (int v = 0; v < n; v++) atomic_init(&parent[v], v);
+    EdgeScanRange* ranges = scan_edges(gdb, readoptions, nodes, type, threads, union_edge, parent);
+    free_edge_ranges(ranges, threads);
+    scan_readoptions_destroy(gdb, readoptions, snapshot);
+
+    GraphComponents* comps = (GraphComponents*)calloc(1, sizeof(GraphComponents));
+    comps->count = n;
+    comps->ids = nodes->ids;
+    comps->graph = nodes;
+    comps->component = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    even_bounds(n, threads, bounds);
+    CompressCtx cc = { parent, comps->component };
+    parallel_run(threads, bounds, compress_worker, &cc);
+    free(bounds);
+    free(parent);
+
+    comps->component_size = (int*)calloc(n > 0 ? n : 1, sizeof(int));
+    for (int v = 0; v < n; v++) comps->component_size[comps->component[v]]++;
+    for (int v = 0; v < n; v++) {
+        int size = comps->component_size[v];
+        if (size == 0) continue;
+        comps->component_count++;
+        if (size == 1) comps->singleton_count++;
+        if (size > comps->largest_component) comps->largest_component = size;
+    }
+    return comps;
+}
+
+const char* graphdb_component_of(const GraphComponents* comps, const char* node_id) {
+    int v = comps ? graphdb_csr_index_of(comps->graph, node_id) : -1;
+    return v >= 0 ? comps->ids[comps->component[v]] : NULL;
+}
+
+void graphdb_free_components(GraphComponents* comps) {
+    if (!comps) return;
+    graphdb_csr_free(comps->graph);
+    free(comps->component);
+    free(comps->component_size);
+    free(comps);
+}
+
+/*******************************
+ * Triangle counting
+ *******************************/
+
+// Writes the elements common to the sorted, duplicate-free arrays a and b to out
+static long long intersect_scalar(const int* a, long long na, const int* b, long long nb, int* out) {
+    long long i = 0, j = 0, k = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (a[i] > b[j]) {
+            j++;
+        } else {
+            out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+// Block-wise all-pairs comparison: each step compares a block of a against
+// every rotation of a block of b, then advances whichever block ends lower.
+static long long intersect_sorted(const int* a, long long na, const int* b, long long nb, int* out) {
+    long long i = 0, j = 0, k = 0;
+#if defined(__AVX2__)
+    const __m256i rot1 = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (i + 8 <= na && j + 8 <= nb) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+        __m256i cmp = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; r++) {
+            vb = _mm256_permutevar8x32_epi32(vb, rot1);
+            cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(va, vb));
+        }
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            out[k++] = a[i + lane];
+            mask &= mask - 1;
+        }
+        int amax = a[i + 7], bmax = b[j + 7];
+        if (amax <= bmax) i += 8;
+        if (bmax <= amax) j += 8;
+    }
+#elif defined(__SSE2__)
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        __m128i cmp = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)), _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            out[k++] = a[i + lane];
+            mask &= mask - 1;
+        }
+        int amax = a[i + 3], bmax = b[j + 3];
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+#endif
+    return k + intersect_scalar(a + i, na - i, b + j, nb - j, out + k);
+}
+
+typedef struct {
+    const GraphCSR* csr;
+    long long* degree;      // undirected, de-duplicated, without self loops
+    long long* fwd_offsets; // oriented adjacency: neighbors of higher rank
+    int* fwd;
+    atomic_llong* triangles;
+    int pass;
+} TriangleCtx;
+
+// Merges sorted out- and in-neighbors of v into a de-duplicated list without v
+static long long undirected_neighbors(const GraphCSR* csr, int v, int* out) {
+    const int* a = csr->out_targets + csr->out_offsets[v];
+    const int* b = csr->in_sources + csr->in_offsets[v];
+    long long na = csr->out_offsets[v + 1] - csr->out_offsets[v];
+    long long nb = csr->in_offsets[v + 1] - csr->in_offsets[v];
+    long long i = 0, j = 0, k = 0;
+    while (i < na || j < nb) {
+        int next;
+        if (j >= nb || (i < na && a[i] <= b[j])) next = a[i++];
+        else next = b[j++];
+        if (next != v && (k == 0 || out[k - 1] != next)) out[k++] = next;
+    }
+    return k;
+}
+
+static int rank_higher(const long long* degree, int u, int v) {
+    return degree[u] > degree[v] || (degree[u] == degree[v] && u > v);
+}
+
+static void orient_worker(void* ctx, int worker, int begin, int end) {
+    TriangleCtx* tc = (TriangleCtx*)ctx;
+    const GraphCSR* csr = tc->csr;
+    long long max_deg = 0;
+    for (int v = begin; v < end; v++) {
+        long long d = (csr->out_offsets[v + 1] - csr->out_offsets[v]) + (csr->in_offsets[v + 1] - csr->in_offsets[v]);
+        if (d > max_deg) max_deg = d;
+    }
+    int* scratch = (int*)malloc(sizeof(int) * (max_deg > 0 ? max_deg : 1));
+    for (int v = begin; v < end; v++) {
+        long long k = undirected_neighbors(csr, v, scratch);
+        if (tc->pass == 0) {
+            tc->degree[v] = k;
+            continue;
+        }
+        long long pos = tc->pass == 1 ? 0 : tc->fwd_offsets[v];
+        for (long long i = 0; i < k; i++) {
+            if (!rank_higher(tc->degree, scratch[i], v)) continue;
+            if (tc->pass == 2) tc->fwd[pos] = scratch[i];
+            pos++;
+        }
+        if (tc->pass == 1) tc->fwd_offsets[v + 1] = pos;
+    }
+    free(scratch);
+}
+
+static void triangle_worker(void* ctx, int worker, int begin, int end) {
+    TriangleCtx* tc = (TriangleCtx*)ctx;
+    long long max_deg = 0;
+    for (int v = begin; v < end; v++) {
+        long long d = tc->fwd_offsets[v + 1] - tc->fwd_offsets[v];
+        if (d > max_deg) max_deg = d;
+    }
+    int* common = (int*)malloc(sizeof(int) * (max_deg > 0 ? max_deg : 1));
+    for (int v = begin; v < end; v++) {
+        const int* nv = tc->fwd + tc->fwd_offsets[v];
+        long long dv = tc->fwd_offsets[v + 1] - tc->fwd_offsets[v];
+        long long local = 0;
+        for (long long i = 0; i < dv; i++) {
+            int u = nv[i];
+            const int* nu = tc->fwd + tc->fwd_offsets[u];
+            long long du = tc->fwd_offsets[u + 1] - tc->fwd_offsets[u];
+            long long k = intersect_sorted(nv, dv, nu, du, common);
+            if (k == 0) continue;
+            local += k;
+            atomic_fetch_add_explicit(&tc->triangles[u], k, memory_order_relaxed);
+            for (long long c = 0; c < k; c++) {
+                atomic_fetch_add_explicit(&tc->triangles[common[c]], 1, memory_order_relaxed);
+            }
+        }
+        if (local) atomic_fetch_add_explicit(&tc->triangles[v], local, memory_order_relaxed);
+    }
+    free(common);
+}
+
+GraphTriangles* graphdb_triangle_count(GraphDB* gdb, const char* type, int threads) {
+    threads = default_threads(threads);
+    GraphCSR* csr = graphdb_csr_build(gdb, type, threads);
+    if (!csr) return NULL;
+    int n = csr->node_count;
+    threads = clamp_workers(threads, n);
+
+    TriangleCtx tc;
+    tc.csr = csr;
+    tc.degree = (long long*)calloc(n + 1, sizeof(long long));
+    tc.fwd_offsets = (long long*)calloc(n + 1, sizeof(long long));
+    tc.fwd = NULL;
+    tc.triangles = (atomic_llong*)malloc(sizeof(atomic_llong) * (n > 0 ? n : 1));
+    for (int v = 0; v < n; v++) atomic_init(&tc.triangles[v], 0);
+
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    degree_balanced_bounds(csr->out_offsets, n, threads, bounds);
+    tc.pass = 0; // undirected degrees
+    parallel_run(threads, bounds, orient_worker, &tc);
+    tc.pass = 1; // oriented degrees
+    parallel_run(threads, bounds, orient_worker, &tc);
+    for (int v = 0; v < n; v++) tc.fwd_offsets[v + 1] += tc.fwd_offsets[v];
+    tc.fwd = (int*)malloc(sizeof(int) * (tc.fwd_offsets[n] > 0 ? tc.fwd_offsets[n] : 1));
+    tc.pass = 2; // oriented adjacency
+    parallel_run(threads, bounds, orient_worker, &tc);
+
+    degree_balanced_bounds(tc.fwd_offsets, n, threads, bounds);
+    parallel_run(threads, bounds, triangle_worker, &tc);
+    free(bounds);
+
+    GraphTriangles* tris = (GraphTriangles*)calloc(1, sizeof(GraphTriangles));
+    tris->count = n;
+    tris->ids = csr->ids;
+    tris->graph = csr;
+    tris->triangles = (long long*)malloc(sizeof(long long) * (n > 0 ? n : 1));
+    tris->clustering = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    long long sum = 0;
+    double cc_sum = 0.0;
+    for (int v = 0; v < n; v++) {
+        long long t = atomic_load(&tc.triangles[v]);
+        long long d = tc.degree[v];
+        tris->triangles[v] = t;
+        tris->clustering[v] = d >= 2 ? 2.0 * (double)t / ((double)d * (double)(d - 1)) : 0.0;
+        sum += t;
+        cc_sum += tris->clustering[v];
+    }
+    tris->total_triangles = sum / 3;
+    tris->average_clustering = n > 0 ? cc_sum / n : 0.0;
+
+    free(tc.degree);
+    free(tc.fwd_offsets);
+    free(tc.fwd);
+    free(tc.triangles);
+    return tris;
+}
+
+void graphdb_free_triangles(GraphTriangles* tris) {
+    if (!tris) return;
+    graphdb_csr_free(tris->graph);
+    free(tris->triangles);
+    free(tris->clustering);
+    free(tris);
+}
+
+/*******************************
+ * Random walks and neighbor sampling
+ *******************************/
+
+// splitmix64; every walk / sample row seeds its own generator from (seed, row)
+// so output does not depend on how rows are split across threads
+static unsigned long long rng_next(unsigned long long* state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static unsigned long long rng_seed(unsigned long long seed, long long row) {
+    unsigned long long state = seed ^ ((unsigned long long)row * 0xD1B54A32D192ED03ULL);
+    return rng_next(&state);
+}
+
+static long long rng_below(unsigned long long* state, long long n) {
+    return (long long)(((rng_next(state) >> 32) * (unsigned long long)n) >> 32);
+}
+
+static double rng_double(unsigned long long* state) {
+    return (double)(rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int has_out_edge(const GraphCSR* csr, int u, int v) {
+    long long lo = csr->out_offsets[u], hi = csr->out_offsets[u + 1];
+    while (lo < hi) {
+        long long mid = lo + (hi - lo) / 2;
+        if (csr->out_targets[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < csr->out_offsets[u + 1] && csr->out_targets[lo] == v;
+}
+
+typedef struct {
+    const GraphCSR* csr;
+    const int* starts;
+    int walk_length;
+    int biased;
+    double inv_p;
+    double inv_q;
+    double max_weight;
+    unsigned long long seed;
+    int* walks;
+} WalkCtx;
+
+// node2vec second-order step by rejection: propose a uniform neighbor, accept
+// it with probability weight / max_weight. Needs no per-edge alias tables and
+// costs one binary search per proposal on the sorted adjacency.
+static int biased_step(const WalkCtx* wc, unsigned long long* rng, int prev, int cur) {
+    const GraphCSR* csr = wc->csr;
+    const int* list = csr->out_targets + csr->out_offsets[cur];
+    long long deg = csr->out_offsets[cur + 1] - csr->out_offsets[cur];
+    int x = list[0];
+    for (int attempt = 0; attempt < 64; attempt++) {
+        x = list[rng_below(rng, deg)];
+        double weight = x == prev ? wc->inv_p : has_out_edge(csr, prev, x) ? 1.0 : wc->inv_q;
+        if (rng_double(rng) * wc->max_weight < weight) break;
+    }
+    return x;
+}
+
+static void walk_worker(void* ctx, int worker, int begin, int end) {
+    WalkCtx* wc = (WalkCtx*)ctx;
+    const GraphCSR* csr = wc->csr;
+    for (int i = begin; i < end; i++) {
+        int* row = wc->walks + (long long)i * wc->walk_length;
+        int cur = wc->starts ? wc->starts[i] : i % csr->node_count;
+        for (int s = 0; s < wc->walk_length; s++) row[s] = -1;
+        if (cur < 0 || cur >= csr->node_count) continue;
+        unsigned long long rng = rng_seed(wc->seed, i);
+        int prev = -1;
+        row[0] = cur;
+        for (int s = 1; s < wc->walk_length; s++) {
+            long long deg = csr->out_offsets[cur + 1] - csr->out_offsets[cur];
+            if (deg == 0) break; // dead end, rest stays -1
+            int next;
+            if (wc->biased && prev >= 0) {
+                next = biased_step(wc, &rng, prev, cur);
+            } else {
+                next = csr->out_targets[csr->out_offsets[cur] + rng_below(&rng, deg)];
+            }
+            prev = cur;
+            cur = next;
+            row[s] = cur;
+        }
+    }
+}
+
+int graphdb_random_walks(const GraphCSR* csr, const int* starts, int walk_count, int walk_length,
+                         double p, double q, unsigned long long seed, int threads, int* walks) {
+    if (!csr || !walks || walk_count < 0 || walk_length <= 0 || p <= 0.0 || q <= 0.0) {
+        fprintf(stderr, "graphdb_random_walks: invalid arguments\n");
+        return -1;
+    }
+    if (walk_count == 0) return 0;
+    if (csr->node_count == 0 && !starts) {
+        for (long long i = 0; i < (long long)walk_count * walk_length; i++) walks[i] = -1;
+        return walk_count;
+    }
+
+    WalkCtx wc;
+    wc.csr = csr;
+    wc.starts = starts;
+    wc.walk_length = walk_length;
+    wc.biased = p != 1.0 || q != 1.0;
+    wc.inv_p = 1.0 / p;
+    wc.inv_q = 1.0 / q;
+    wc.max_weight = wc.inv_p > 1.0 ? wc.inv_p : 1.0;
+    if (wc.inv_q > wc.max_weight) wc.max_weight = wc.inv_q;
+    wc.seed = seed;
+    wc.walks = walks;
+
+    threads = clamp_workers(threads, walk_count);
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    even_bounds(walk_count, threads, bounds);
+    parallel_run(threads, bounds, walk_worker, &wc);
+    free(bounds);
+    return walk_count;
+}
+
+typedef struct {
+    const GraphCSR* csr;
+    const int* nodes;
+    int fanout;
+    unsigned long long seed;
+    int* out;
+} SampleCtx;
+
+static void sample_worker(void* ctx, int worker, int begin, int end) {
+    SampleCtx* sc = (SampleCtx*)ctx;
+    const GraphCSR* csr = sc->csr;
+    int fanout = sc->fanout;
+    long long* picks = (long long*)malloc(sizeof(long long) * fanout);
+    for (int i = begin; i < end; i++) {
+        int* row = sc->out + (long long)i * fanout;
+        int v = sc->nodes[i];
+        for (int s = 0; s < fanout; s++) row[s] = -1;
+        if (v < 0 || v >= csr->node_count) continue;
+        const int* list = csr->out_targets + csr->out_offsets[v];
+        long long deg = csr->out_offsets[v + 1] - csr->out_offsets[v];
+        if (deg <= fanout) {
+            memcpy(row, list, sizeof(int) * deg);
+            continue;
+        }
+        unsigned long long rng = rng_seed(sc->seed, i);
+        if ((long long)fanout * fanout > deg) {
+            // Reservoir over edge positions: O(deg)
+            for (int s = 0; s < fanout; s++) picks[s] = s;
+            for (long long j = fanout; j < deg; j++) {
+                long long r = rng_below(&rng, j + 1);
+                if (r < fanout) picks[r] = j;
+            }
+        } else {
+            // Floyd's algorithm: O(fanout^2), independent of the hub's degree
+            int k = 0;
+            for (long long j = deg - fanout; j < deg; j++) {
+                long long t = rng_below(&rng, j + 1);
+                int seen = 0;
+                for (int s = 0; s < k; s++) {
+                    if (picks[s] == t) {
+                        seen = 1;
+                        break;
+                    }
+                }
+                picks[k++] = seen ? j : t;
+            }
+        }
+        for (int s = 0; s < fanout; s++) row[s] = list[picks[s]];
+    }
+    free(picks);
+}
+
+int graphdb_sample_neighbors(const GraphCSR* csr, const int* nodes, int count, int fanout,
+                             unsigned long long seed, int threads, int* out) {
+    if (!csr || !nodes || !out || count < 0 || fanout <= 0) {
+        fprintf(stderr, "graphdb_sample_neighbors: invalid arguments\n");
+        return -1;
+    }
+    if (count == 0) return 0;
+    SampleCtx sc;
+    sc.csr = csr;
+    sc.nodes = nodes;
+    sc.fanout = fanout;
+    sc.seed = seed;
+    sc.out = out;
+
+    threads = clamp_workers(threads, count);
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    even_bounds(count, threads, bounds);
+    parallel_run(threads, bounds, sample_worker, &sc);
+    free(bounds);
+    return count;
+}
+
+/*******************************
+ * Community detection
+ *******************************/
+
+#define COMMUNITY_WRITE_BATCH 10000
+
+typedef struct {
+    const GraphCSR* csr;
+    atomic_int* label;
+    atomic_char* active;
+    atomic_char* next_active;
+    int** counts;    // per worker, dense by label
+    int** touched;   // per worker, labels with a non-zero count
+    long long* changed;
+} PropagationCtx;
+
+static void activate_neighbors(PropagationCtx* pc, int v) {
+    const GraphCSR* csr = pc->csr;
+    for (long long e = csr->out_offsets[v]; e < csr->out_offsets[v + 1]; e++) {
+        atomic_store_explicit(&pc->next_active[csr->out_targets[e]], 1, memory_order_relaxed);
+    }
+    for (long long e = csr->in_offsets[v]; e < csr->in_offsets[v + 1]; e++) {
+        atomic_store_explicit(&pc->next_active[csr->in_sources[e]], 1, memory_order_relaxed);
+    }
+}
+
+// Asynchronous: neighbors' labels are read as they are, including updates
+// made earlier in the same round by any worker
+static void propagate_worker(void* ctx, int worker, int begin, int end) {
+    PropagationCtx* pc = (PropagationCtx*)ctx;
+    const GraphCSR* csr = pc->csr;
+    int* counts = pc->counts[worker];
+    int* touched = pc->touched[worker];
+    long long changed = 0;
+    for (int v = begin; v < end; v++) {
+        if (!atomic_load_explicit(&pc->active[v], memory_order_relaxed)) continue;
+        atomic_store_explicit(&pc->active[v], 0, memory_order_relaxed);
+        int touched_count = 0;
+        for (int side = 0; side < 2; side++) {
+            const long long* offsets = side ? csr->in_offsets : csr->out_offsets;
+            const int* adj = side ? csr->in_sources : csr->out_targets;
+            for (long long e = offsets[v]; e < offsets[v + 1]; e++) {
+                int l = atomic_load_explicit(&pc->label[adj[e]], memory_order_relaxed);
+                if (counts[l]++ == 0) touched[touched_count++] = l;
+            }
+        }
+        if (touched_count == 0) continue;
+        int current = atomic_load_explicit(&pc->label[v], memory_order_relaxed);
+        // Most frequent label; ties keep the current one, else go to a
+        // per-node hash of the label. Always taking the smallest label would
+        // let one label flood across every bridge between dense groups.
+        int best = current;
+        int best_count = counts[current];
+        unsigned long long best_rank = 0;
+        for (int t = 0; t < touched_count; t++) {
+            int l = touched[t];
+            if (counts[l] < best_count || l == current) continue;
+            unsigned long long rank = rng_seed((unsigned long long)v, l);
+            if (counts[l] > best_count || (best != current && rank > best_rank)) {
+                best = l;
+                best_count = counts[l];
+                best_rank = rank;
+            }
+        }
+        for (int t = 0; t < touched_count; t++) counts[touched[t]] = 0;
+        if (best != current) {
+            atomic_store_explicit(&pc->label[v], best, memory_order_relaxed);
+            activate_neighbors(pc, v);
+            changed++;
+        }
+    }
+    pc->changed[worker] = changed;
+}
+
+// Sequential Louvain local moving on the undirected multigraph (every stored
+// edge counts once at each endpoint). Returns the number of nodes moved.
+static long long louvain_refine(const GraphCSR* csr, int* community, int max_passes) {
+    int n = csr->node_count;
+    double two_m = 2.0 * (double)csr->edge_count;
+    if (two_m == 0.0) return 0;
+    double* tot = (double*)calloc(n, sizeof(double));
+    double* weight = (double*)calloc(n, sizeof(double));
+    int* touched = (int*)malloc(sizeof(int) * n);
+    for (int v = 0; v < n; v++) {
+        tot[community[v]] += (double)(csr->out_offsets[v + 1] - csr->out_offsets[v] + csr->in_offsets[v + 1] - csr->in_offsets[v]);
+    }
+    long long moved_total = 0;
+    for (int pass = 0; pass < max_passes; pass++) {
+        long long moved = 0;
+        for (int v = 0; v < n; v++) {
+            double k = (double)(csr->out_offsets[v + 1] - csr->out_offsets[v] + csr->in_offsets[v + 1] - csr->in_offsets[v]);
+            if (k == 0.0) continue;
+            int own = community[v];
+            int touched_count = 0;
+            for (int side = 0; side < 2; side++) {
+                const long long* offsets = side ? csr->in_offsets : csr->out_offsets;
+                const int* adj = side ? csr->in_sources : csr->out_targets;
+                for (long long e = offsets[v]; e < offsets[v + 1]; e++) {
+                    if (adj[e] == v) continue;
+                    int c = community[adj[e]];
+                    if (weight[c] == 0.0) touched[touched_count++] = c;
+                    weight[c] += 1.0;
+                }
+            }
+            // Gain of joining c after leaving own: w_c - tot_c * k / 2m
+            tot[own] -= k;
+            int best = own;
+            double best_gain = weight[own] - tot[own] * k / two_m;
+            for (int t = 0; t < touched_count; t++) {
+                int c = touched[t];
+                double gain = weight[c] - tot[c] * k / two_m;
+                if (gain > best_gain + 1e-12) {
+                    best = c;
+                    best_gain = gain;
+                }
+            }
+            tot[best] += k;
+            for (int t = 0; t < touched_count; t++) weight[touched[t]] = 0.0;
+            weight[own] = 0.0;
+            if (best != own) {
+                community[v] = best;
+                moved++;
+            }
+        }
+        moved_total += moved;
+        if (moved == 0) break;
+    }
+    free(tot);
+    free(weight);
+    free(touched);
+    return moved_total;
+}
+
+static double modularity(const GraphCSR* csr, const int* community, int community_count) {
+    double two_m = 2.0 * (double)csr->edge_count;
+    if (two_m == 0.0) return 0.0;
+    double* tot = (double*)calloc(community_count, sizeof(double));
+    double inside = 0.0;
+    for (int v = 0; v < csr->node_count; v++) {
+        tot[community[v]] += (double)(csr->out_offsets[v + 1] - csr->out_offsets[v] + csr->in_offsets[v + 1] - csr->in_offsets[v]);
+        for (long long e = csr->out_offsets[v]; e < csr->out_offsets[v + 1]; e++) {
+            if (community[csr->out_targets[e]] == community[v]) inside += 2.0;
+        }
+    }
+    double q = inside / two_m;
+    for (int c = 0; c < community_count; c++) q -= (tot[c] / two_m) * (tot[c] / two_m);
+    free(tot);
+    return q;
+}
+
+GraphCommunities* graphdb_communities(GraphDB* gdb, const char* type, int max_iters, int refine, int threads) {
+    GraphCSR* csr = graphdb_csr_build(gdb, type, threads);
+    if (!csr) return NULL;
+    int n = csr->node_count;
+    int n_alloc = n > 0 ? n : 1;
+    threads = clamp_workers(threads, n);
+    if (max_iters <= 0) max_iters = 20;
+
+    PropagationCtx pc;
+    pc.csr = csr;
+    pc.label = (atomic_int*)malloc(sizeof(atomic_int) * n_alloc);
+    pc.active = (atomic_char*)malloc(sizeof(atomic_char) * n_alloc);
+    pc.next_active = (atomic_char*)malloc(sizeof(atomic_char) * n_alloc);
+    for (int v = 0; v < n; v++) {
+        atomic_init(&pc.label[v], v);
+        atomic_init(&pc.active[v], 1);
+        atomic_init(&pc.next_active[v], 0);
+    }
+    pc.counts = (int**)malloc(sizeof(int*) * threads);
+    pc.touched = (int**)malloc(sizeof(int*) * threads);
+    pc.changed = (long long*)calloc(threads, sizeof(long long));
+    for (int w = 0; w < threads; w++) {
+        pc.counts[w] = (int*)calloc(n_alloc, sizeof(int));
+        pc.touched[w] = (int*)malloc(sizeof(int) * n_alloc);
+    }
+
+    // Combined out + in offsets, for degree-balanced chunks
+    long long* degree_offsets = (long long*)malloc(sizeof(long long) * (n + 1));
+    for (int v = 0; v <= n; v++) degree_offsets[v] = csr->out_offsets[v] + csr->in_offsets[v];
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    degree_balanced_bounds(degree_offsets, n, threads, bounds);
+
+    // Only nodes whose neighborhood changed in the last round are revisited
+    int iterations = 0;
+    while (iterations < max_iters) {
+        iterations++;
+        parallel_run(threads, bounds, propagate_worker, &pc);
+        long long changed = 0;
+        for (int w = 0; w < threads; w++) changed += pc.changed[w];
+        if (changed == 0) break;
+        atomic_char* tmp = pc.active;
+        pc.active = pc.next_active;
+        pc.next_active = tmp;
+    }
+    free(bounds);
+    free(degree_offsets);
+
+    GraphCommunities* comms = (GraphCommunities*)calloc(1, sizeof(GraphCommunities));
+    comms->count = n;
+    comms->ids = csr->ids;
+    comms->graph = csr;
+    comms->iterations = iterations;
+    comms->community = (int*)malloc(sizeof(int) * n_alloc);
+    for (int v = 0; v < n; v++) comms->community[v] = atomic_load(&pc.label[v]);
+    if (refine) louvain_refine(csr, comms->community, 10);
+
+    // Renumber 0..k-1 in order of first member
+    int* renumber = pc.counts[0];
+    for (int v = 0; v < n; v++) renumber[v] = -1;
+    for (int v = 0; v < n; v++) {
+        int c = comms->community[v];
+        if (renumber[c] < 0) renumber[c] = comms->community_count++;
+        comms->community[v] = renumber[c];
+    }
+    comms->modularity = modularity(csr, comms->community, comms->community_count);
+
+    for (int w = 0; w < threads; w++) {
+        free(pc.counts[w]);
+        free(pc.touched[w]);
+    }
+    free(pc.counts);
+    free(pc.touched);
+    free(pc.changed);
+    free(pc.label);
+    free(pc.active);
+    free(pc.next_active);
+    return comms;
+}
+
+int graphdb_community_of(const GraphCommunities* comms, const char* node_id) {
+    int v = comms ? graphdb_csr_index_of(comms->graph, node_id) : -1;
+    return v >= 0 ? comms->community[v] : -1;
+}
+
+void graphdb_write_communities(GraphDB* gdb, const GraphCommunities* comms, const char* prop) {
+    if (!gdb || !comms || comms->count == 0) return;
+    char** values = (char**)malloc(sizeof(char*) * COMMUNITY_WRITE_BATCH);
+    char* buffer = (char*)malloc((size_t)COMMUNITY_WRITE_BATCH * 16);
+    for (int i = 0; i < COMMUNITY_WRITE_BATCH; i++) values[i] = buffer + (size_t)i * 16;
+    // One write batch per chunk keeps memtable inserts bounded on big graphs
+    for (int begin = 0; begin < comms->count; begin += COMMUNITY_WRITE_BATCH) {
+        int count = comms->count - begin < COMMUNITY_WRITE_BATCH ? comms->count - begin : COMMUNITY_WRITE_BATCH;
+        for (int i = 0; i < count; i++) snprintf(values[i], 16, "%d", comms->community[begin + i]);
+        graphdb_set_node_properties(gdb, prop, (const char**)comms->ids + begin, (const char**)values, count);
+    }
+    free(buffer);
+    free(values);
+}
+
+void graphdb_free_communities(GraphCommunities* comms) {
+    if (!comms) return;
+    graphdb_csr_free(comms->graph);
+    free(comms->community);
+    free(comms);
+}
+
+/*******************************
+ * Betweenness centrality
+ *******************************/
+
+#define BETWEENNESS_SEED 0x6265747765656EULL
+
+// Dense per-worker BFS workspace, reused across all of the worker's sources
+typedef struct {
+    int* dist;
+    double* sigma;  // shortest path counts
+    double* delta;  // dependencies
+    int* order;     // BFS order; walked backwards as the Brandes stack
+    double* partial;
+} BetweennessWorkspace;
+
+typedef struct {
+    const GraphCSR* csr;
+    const int* sources;
+    BetweennessWorkspace* ws;
+} BetweennessCtx;
+
+static void betweenness_worker(void* ctx, int worker, int begin, int end) {
+    BetweennessCtx* bc = (BetweennessCtx*)ctx;
+    const GraphCSR* csr = bc->csr;
+    BetweennessWorkspace* ws = &bc->ws[worker];
+    int n = csr->node_count;
+    for (int v = 0; v < n; v++) ws->dist[v] = -1;
+    for (int i = begin; i < end; i++) {
+        int s = bc->sources[i];
+        int head = 0, tail = 0;
+        ws->order[tail++] = s;
+        ws->dist[s] = 0;
+        ws->sigma[s] = 1.0;
+        while (head < tail) {
+            int u = ws->order[head++];
+            for (long long e = csr->out_offsets[u]; e < csr->out_offsets[u + 1]; e++) {
+                int w = csr->out_targets[e];
+                if (ws->dist[w] < 0) {
+                    ws->dist[w] = ws->dist[u] + 1;
+                    ws->sigma[w] = 0.0;
+                    ws->delta[w] = 0.0;
+                    ws->order[tail++] = w;
+                }
+                if (ws->dist[w] == ws->dist[u] + 1) ws->sigma[w] += ws->sigma[u];
+            }
+        }
+        ws->delta[s] = 0.0;
+        // Successors are re-derived from dist, so no predecessor lists are kept
+        for (int j = tail - 1; j >= 0; j--) {
+            int u = ws->order[j];
+            double acc = 0.0;
+            for (long long e = csr->out_offsets[u]; e < csr->out_offsets[u + 1]; e++) {
+                int w = csr->out_targets[e];
+                if (ws->dist[w] == ws->dist[u] + 1) acc += (1.0 + ws->delta[w]) / ws->sigma[w];
+            }
+            ws->delta[u] = ws->sigma[u] * acc;
+            if (u != s) ws->partial[u] += ws->delta[u];
+        }
+        // Only the visited nodes need resetting
+        for (int j = 0; j < tail; j++) ws->dist[ws->order[j]] = -1;
+    }
+}
+
+GraphNodeScores* graphdb_betweenness(GraphDB* gdb, const char* type, int samples, int threads) {
+    GraphCSR* csr = graphdb_csr_build(gdb, type, threads);
+    if (!csr) return NULL;
+    int n = csr->node_count;
+    double* values = (double*)calloc(n > 0 ? n : 1, sizeof(double));
+    if (n == 0) return scores_create(csr, values);
+    int exact = samples <= 0 || samples >= n;
+    if (exact) samples = n;
+    threads = clamp_workers(threads, samples);
+
+    // Sources: a fixed-seed partial Fisher-Yates shuffle, so runs are repeatable
+    int* sources = (int*)malloc(sizeof(int) * n);
+    for (int v = 0; v < n; v++) sources[v] = v;
+    if (!exact) {
+        unsigned long long rng = rng_seed(BETWEENNESS_SEED, n);
+        for (int i = 0; i < samples; i++) {
+            int j = i + (int)rng_below(&rng, n - i);
+            int tmp = sources[i];
+            sources[i] = sources[j];
+            sources[j] = tmp;
+        }
+    }
+
+    BetweennessCtx bc;
+    bc.csr = csr;
+    bc.sources = sources;
+    bc.ws = (BetweennessWorkspace*)malloc(sizeof(BetweennessWorkspace) * threads);
+    for (int w = 0; w < threads; w++) {
+        bc.ws[w].dist = (int*)malloc(sizeof(int) * n);
+        bc.ws[w].sigma = (double*)malloc(sizeof(double) * n);
+        bc.ws[w].delta = (double*)malloc(sizeof(double) * n);
+        bc.ws[w].order = (int*)malloc(sizeof(int) * n);
+        bc.ws[w].partial = (double*)calloc(n, sizeof(double));
+    }
+    int* bounds = (int*)malloc(sizeof(int) * (threads + 1));
+    even_bounds(samples, threads, bounds);
+    parallel_run(threads, bounds, betweenness_worker, &bc);
+
+    double scale = exact ? 1.0 : (double)n / (double)samples;
+    for (int w = 0; w < threads; w++) {
+        for (int v = 0; v < n; v++) values[v] += bc.ws[w].partial[v];
+        free(bc.ws[w].dist);
+        free(bc.ws[w].sigma);
+        free(bc.ws[w].delta);
+        free(bc.ws[w].order);
+        free(bc.ws[w].partial);
+    }
+    for (int v = 0; v < n; v++) values[v] *= scale;
+    free(bc.ws);
+    free(bounds);
+    free(sources);
+
+    GraphNodeScores* scores = scores_create(csr, values);
+    if (!exact) {
+        // Each sampled dependency lies in [0, n - 2]; Hoeffding over the mean
+        // of `samples` draws, union bound over n nodes at 95% confidence
+        double eps = sqrt(log(2.0 * n / 0.05) / (2.0 * samples));
+        scores->error_bound = eps * (double)n * (double)(n > 2 ? n - 2 : 0);
+    }
+    return scores;
+}
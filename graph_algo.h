@@ -0,0 +1,129 @@
+#ifndef GRAPH_ALGO_H
+#define GRAPH_ALGO_H
+
+#include "graphdb.h"
+
+// Read-only, in-memory snapshot of the adjacency index in compressed sparse
+// row form. Nodes are numbered 0..node_count-1 in `N` key order, so dense
+// arrays returned by the analytics below line up with `ids`.
+typedef struct GraphCSR {
+    int node_count;
+    char** ids;             // dense index -> node id
+    long long edge_count;
+    long long* out_offsets; // node_count + 1 entries into out_targets
+    int* out_targets;
+    long long* in_offsets;  // node_count + 1 entries into in_sources
+    int* in_sources;
+    char* id_pool;          // backing storage for ids
+    int* index_table;       // open-addressing id -> dense index
+    size_t index_mask;
+} GraphCSR;
+
+// One value per node, aligned with `ids`
+typedef struct {
+    int count;
+    char** ids;
+    double* values;
+    double error_bound; // sampled estimates only, 0 when exact
+    GraphCSR* graph; // owner of ids
+} GraphNodeScores;
+
+// Builds the snapshot from the `N` and `O` keyspaces. `type` restricts edges to
+// one relationship type, or several separated by '|' (NULL or "" for all).
+// Edges whose endpoints have no node record are skipped. `threads` <= 0 uses
+// one thread per core.
+GraphCSR* graphdb_csr_build(GraphDB* gdb, const char* type, int threads);
+void graphdb_csr_free(GraphCSR* csr);
+int graphdb_csr_index_of(const GraphCSR* csr, const char* node_id);
+
+// Pull-style PageRank over the incoming adjacency, split into in-degree
+// balanced chunks across `threads` workers.
+GraphNodeScores* graphdb_pagerank(GraphDB* gdb, const char* type, int iters, double damping, int threads);
+
+// Writes every score as node property `prop` in one batch
+void graphdb_write_node_scores(GraphDB* gdb, const GraphNodeScores* scores, const char* prop);
+double graphdb_node_score(const GraphNodeScores* scores, const char* node_id);
+void graphdb_free_node_scores(GraphNodeScores* scores);
+
+// Betweenness centrality along outgoing edges (unnormalized, directed), by
+// Brandes' dependency accumulation from `samples` sources drawn without
+// replacement; <= 0 or >= node_count runs every source and is exact. Sampled
+// sums are scaled by node_count / samples, and with 95% probability every
+// value is within `error_bound` of the exact score (Hoeffding plus a union
+// bound over nodes, so it shrinks as 1 / sqrt(samples)).
+GraphNodeScores* graphdb_betweenness(GraphDB* gdb, const char* type, int samples, int threads);
+
+// Weakly connected components. `component[i]` is the dense index of the
+// representative (smallest index) of node i's component.
+typedef struct {
+    int count;
+    char** ids;
+    int* component;
+    int* component_size;  // indexed by representative, 0 for non-representatives
+    int component_count;
+    int largest_component;
+    int singleton_count;
+    GraphCSR* graph;      // node index only, no adjacency
+} GraphComponents;
+
+// Lock-free parallel union-find fed directly by key-range partitioned
+// iterators over the `O` keyspace; memory is O(V) regardless of edge count.
+GraphComponents* graphdb_connected_components(GraphDB* gdb, const char* type, int threads);
+const char* graphdb_component_of(const GraphComponents* comps, const char* node_id);
+void graphdb_free_components(GraphComponents* comps);
+
+// Triangle counts and local clustering coefficients on the undirected,
+// de-duplicated view of the edges of `type`.
+typedef struct {
+    int count;
+    char** ids;
+    long long* triangles; // per node
+    double* clustering;   // 2 * triangles / (deg * (deg - 1)), 0 when deg < 2
+    long long total_triangles;
+    double average_clustering;
+    GraphCSR* graph;
+} GraphTriangles;
+
+// Orients every edge from lower to higher (degree, index) rank and intersects
+// the sorted oriented neighbor arrays with SSE2/AVX2 kernels when available.
+GraphTriangles* graphdb_triangle_count(GraphDB* gdb, const char* type, int threads);
+void graphdb_free_triangles(GraphTriangles* tris);
+
+// Communities on the undirected view of the `O`/`I` adjacency
+typedef struct {
+    int count;
+    char** ids;
+    int* community;      // 0..community_count-1, numbered by first member
+    int community_count;
+    double modularity;
+    int iterations;      // label propagation rounds run
+    GraphCSR* graph;
+} GraphCommunities;
+
+// Parallel asynchronous label propagation: each round only revisits nodes
+// whose neighborhood changed in the previous one, and stops when no label
+// moves or after `max_iters` rounds (<= 0 for 20). With `refine`, a Louvain
+// local-moving pass then improves modularity starting from those labels.
+GraphCommunities* graphdb_communities(GraphDB* gdb, const char* type, int max_iters, int refine, int threads);
+int graphdb_community_of(const GraphCommunities* comms, const char* node_id);
+// Writes community numbers as node property `prop`, in bounded write batches
+void graphdb_write_communities(GraphDB* gdb, const GraphCommunities* comms, const char* prop);
+void graphdb_free_communities(GraphCommunities* comms);
+
+// Random walks along outgoing edges of a snapshot, written as dense node
+// indices into the caller's flat buffer of walk_count * walk_length ints.
+// Walk i starts at starts[i] (or node i % node_count when starts is NULL);
+// positions after a dead end are -1. p and q are the node2vec return and
+// in-out parameters, p = q = 1 gives uniform walks. Output depends only on
+// `seed`, not on `threads`. Returns walk_count, or -1 on invalid arguments.
+int graphdb_random_walks(const GraphCSR* csr, const int* starts, int walk_count, int walk_length,
+                         double p, double q, unsigned long long seed, int threads, int* walks);
+
+// Up to `fanout` distinct out-neighbor positions per node, sampled without
+// replacement into out[i * fanout ..], padded with -1. Picks edges by index
+// (Floyd's algorithm, or a reservoir when fanout is large relative to the
+// degree), so hubs cost O(fanout^2) rather than O(degree).
+int graphdb_sample_neighbors(const GraphCSR* csr, const int* nodes, int count, int fanout,
+                             unsigned long long seed, int threads, int* out);
+
+#endif
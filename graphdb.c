@@ -1,11 +1,58 @@
 // graphdb.c
 #include "graphdb.h"
+#include "strmap.h"
 #include <rocksdb/c.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <ctype.h>
+#include <math.h>
+
+/*******************************
+ * I/O counters
+ *******************************/
+
+// RocksDB calls made by this thread, read by query profiles
+static _Thread_local GraphIOStats io_stats;
+static _Thread_local rocksdb_perfcontext_t* io_perf;
+
+static void io_seek(rocksdb_iterator_t* it, const char* key, size_t len) {
+    io_stats.seeks++;
+    rocksdb_iter_seek(it, key, len);
+}
+
+static void io_next(rocksdb_iterator_t* it) {
+    io_stats.nexts++;
+    rocksdb_iter_next(it);
+}
+
+static char* io_get(GraphDB* gdb, const char* key, size_t key_len, size_t* val_len, char** err) {
+    io_stats.gets++;
+    char* value = rocksdb_get(gdb->db, gdb->readoptions, key, key_len, val_len, err);
+    if (value) io_stats.get_bytes += *val_len;
+    return value;
+}
+
+void graphdb_io_stats(GraphIOStats* stats) {
+    *stats = io_stats;
+    if (io_perf) {
+        stats->block_reads = rocksdb_perfcontext_metric(io_perf, rocksdb_block_read_count);
+        stats->cache_hits = rocksdb_perfcontext_metric(io_perf, rocksdb_block_cache_hit_count);
+    }
+}
+
+void graphdb_io_perf(int enable) {
+    if (enable && !io_perf) {
+        rocksdb_set_perf_level(rocksdb_enable_count);
+        io_perf = rocksdb_perfcontext_create();
+        rocksdb_perfcontext_reset(io_perf);
+    } else if (!enable && io_perf) {
+        rocksdb_set_perf_level(rocksdb_disable);
+        rocksdb_perfcontext_destroy(io_perf);
+        io_perf = NULL;
+    }
+}
 
 // Queue for thread-safe operations
 typedef struct Node {
@@ -130,7 +177,7 @@ void* prefetch_thread(void* arg) {
         char* prefix = (char*)malloc(prefix_len + 1);
         sprintf(prefix, "O%s:%s:", node, pa->type);
         rocksdb_iterator_t* it = rocksdb_create_iterator(pa->db, pa->readoptions);
-        rocksdb_iter_seek(it, prefix, prefix_len);
+        io_seek(it, prefix, prefix_len);
         Neighbor* neighbors = NULL;
         int neigh_count = 0;
         while (rocksdb_iter_valid(it)) {
@@ -148,7 +195,7 @@ void* prefetch_thread(void* arg) {
             neighbors = (Neighbor*)realloc(neighbors, sizeof(Neighbor) * (neigh_count + 1));
             neighbors[neigh_count] = neigh;
             neigh_count++;
-            rocksdb_iter_next(it);
+            io_next(it);
         }
         rocksdb_iter_destroy(it);
         free(prefix);
@@ -158,9 +205,135 @@ void* prefetch_thread(void* arg) {
     return NULL;
 }
 
+int graphdb_type_matches(const char* spec, const char* type, size_t type_len) {
+    if (!spec || !*spec) return 1;
+    const char* p = spec;
+    while (1) {
+        const char* bar = strchr(p, '|');
+        size_t len = bar ? (size_t)(bar - p) : strlen(p);
+        if (len == type_len && memcmp(p, type, len) == 0) return 1;
+        if (!bar) return 0;
+        p = bar + 1;
+    }
+}
+
+// Reachability index markers are `R<spec>` keys; labels live under `R<spec>:`.
+// Loads the markers, seeking past each spec's labels.
+static void load_reach_types(GraphDB* gdb) {
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    io_seek(it, "R", 1);
+    while (rocksdb_iter_valid(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen == 0 || key[0] != 'R') break;
+        const char* colon = memchr(key, ':', klen);
+        if (!colon) {
+            gdb->reach_types = (char**)realloc(gdb->reach_types, sizeof(char*) * (gdb->reach_type_count + 1));
+            gdb->reach_types[gdb->reach_type_count++] = strndup(key + 1, klen - 1);
+            io_next(it);
+            continue;
+        }
+        // Orphaned labels of an invalidated spec: jump to "R<spec>;"
+        size_t skip_len = colon - key + 1;
+        char* skip = (char*)malloc(skip_len);
+        memcpy(skip, key, skip_len - 1);
+        skip[skip_len - 1] = ':' + 1;
+        io_seek(it, skip, skip_len);
+        free(skip);
+    }
+    rocksdb_iter_destroy(it);
+}
+
+// Deletes the `R<spec>` marker of reach_types[i]; reach_mutex must be held
+static void drop_reach_type(GraphDB* gdb, int i) {
+    const char* spec = gdb->reach_types[i];
+    size_t key_len = 1 + strlen(spec);
+    char* key = (char*)malloc(key_len + 1);
+    sprintf(key, "R%s", spec);
+    char* err = NULL;
+    rocksdb_delete(gdb->db, gdb->writeoptions, key, key_len, &err);
+    if (err) {
+        fprintf(stderr, "Error invalidating reachability index: %s\n", err);
+        free(err);
+    }
+    free(key);
+    free(gdb->reach_types[i]);
+    gdb->reach_types[i] = gdb->reach_types[--gdb->reach_type_count];
+    gdb->reach_epoch++;
+}
+
+void graphdb_reach_unmark(GraphDB* gdb, const char* spec) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    for (int i = gdb->reach_type_count - 1; i >= 0; i--) {
+        if (strcmp(gdb->reach_types[i], spec) == 0) drop_reach_type(gdb, i);
+    }
+    pthread_mutex_unlock(&gdb->reach_mutex);
+}
+
+// Called before an edge of `type` is added or removed. Covered specs lose
+// their marker first, so a crash between this and the edge write leaves the
+// index stale rather than wrong. reach_keep reads labels, so it runs without
+// reach_mutex; an invalidation in the meantime means asking again.
+static void edge_changing(GraphDB* gdb, const char* from, const char* to, const char* type, int added) {
+    size_t type_len = strlen(type);
+    char** covered = NULL;
+    int* keep = NULL;
+    pthread_mutex_lock(&gdb->reach_mutex);
+    for (;;) {
+        int n = 0;
+        covered = (char**)realloc(covered, sizeof(char*) * (gdb->reach_type_count + 1));
+        for (int i = 0; i < gdb->reach_type_count; i++) {
+            if (graphdb_type_matches(gdb->reach_types[i], type, type_len)) covered[n++] = strdup(gdb->reach_types[i]);
+        }
+        if (n > 0 && added && gdb->reach_keep) {
+            unsigned long long epoch = gdb->reach_epoch;
+            pthread_mutex_unlock(&gdb->reach_mutex);
+            // A new edge between already connected nodes changes nothing
+            keep = (int*)realloc(keep, sizeof(int) * n);
+            for (int j = 0; j < n; j++) keep[j] = gdb->reach_keep(gdb, covered[j], from, to);
+            pthread_mutex_lock(&gdb->reach_mutex);
+            if (gdb->reach_epoch != epoch) {
+                for (int j = 0; j < n; j++) free(covered[j]);
+                continue;
+            }
+        }
+        for (int i = gdb->reach_type_count - 1; i >= 0; i--) {
+            const char* spec = gdb->reach_types[i];
+            if (!graphdb_type_matches(spec, type, type_len)) continue;
+            int kept = 0;
+            for (int j = 0; j < n && keep; j++) {
+                if (strcmp(covered[j], spec) == 0) kept = keep[j];
+            }
+            if (!kept) drop_reach_type(gdb, i);
+        }
+        for (int j = 0; j < n; j++) free(covered[j]);
+        break;
+    }
+    pthread_mutex_unlock(&gdb->reach_mutex);
+    free(covered);
+    free(keep);
+}
+
+// Brackets edge writes so an index build can tell whether any write raced
+// with its snapshot
+static void edge_write_begin(GraphDB* gdb) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    gdb->edges_in_flight++;
+    pthread_mutex_unlock(&gdb->reach_mutex);
+}
+
+static void edge_write_end(GraphDB* gdb) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    gdb->edges_in_flight--;
+    gdb->edge_generation++;
+    pthread_mutex_unlock(&gdb->reach_mutex);
+}
+
 GraphDB* graphdb_open(const char* path) {
-    GraphDB* gdb = (GraphDB*)malloc(sizeof(GraphDB));
+    GraphDB* gdb = (GraphDB*)calloc(1, sizeof(GraphDB));
     if (!gdb) return NULL;
+    pthread_mutex_init(&gdb->reach_mutex, NULL);
+    pthread_mutex_init(&gdb->plan_mutex, NULL);
 
     gdb->options = rocksdb_options_create();
     gdb->table_options = rocksdb_block_based_options_create();
@@ -199,22 +372,64 @@ GraphDB* graphdb_open(const char* path) {
     rocksdb_readoptions_set_readahead_size(gdb->readoptions, 2ULL * 1024 * 1024);
     rocksdb_readoptions_set_async_io(gdb->readoptions, 1);
 
+    load_reach_types(gdb);
     return gdb;
 }
 
 void graphdb_close(GraphDB* gdb) {
     if (!gdb) return;
+    if (gdb->reach_shutdown) gdb->reach_shutdown(gdb);
+    if (gdb->plan_cache_free) gdb->plan_cache_free(gdb->plan_cache);
     rocksdb_close(gdb->db);
     rocksdb_options_destroy(gdb->options);
     rocksdb_block_based_options_destroy(gdb->table_options);
     rocksdb_cache_destroy(gdb->cache);
     rocksdb_writeoptions_destroy(gdb->writeoptions);
     rocksdb_readoptions_destroy(gdb->readoptions);
+    for (int i = 0; i < gdb->reach_type_count; i++) free(gdb->reach_types[i]);
+    free(gdb->reach_types);
+    pthread_mutex_destroy(&gdb->reach_mutex);
+    pthread_mutex_destroy(&gdb->plan_mutex);
     free(gdb);
 }
 
+typedef struct {
+    GraphDB* gdb;
+    const char* node;
+    int outgoing;
+} NodeEdges;
+
+static int node_edge_changing(void* ctx, const char* id, size_t id_len, const char* type, size_t type_len) {
+    NodeEdges* ne = (NodeEdges*)ctx;
+    char* other = strndup(id, id_len);
+    char* edge_type = strndup(type, type_len);
+    if (ne->outgoing) edge_changing(ne->gdb, ne->node, other, edge_type, 1);
+    else edge_changing(ne->gdb, other, ne->node, edge_type, 1);
+    free(other);
+    free(edge_type);
+    return 0;
+}
+
+// Ids without a node record are left out of reachability, so creating one
+// brings its stored edges in as if each were added now
+static void node_edges_changing(GraphDB* gdb, const char* node_id) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    int indexed = gdb->reach_type_count > 0;
+    pthread_mutex_unlock(&gdb->reach_mutex);
+    if (!indexed) return;
+    NodeEdges ne = {gdb, node_id, 1};
+    graphdb_foreach_neighbor(gdb, node_id, NULL, GRAPHDB_DIR_OUT, node_edge_changing, &ne);
+    ne.outgoing = 0;
+    graphdb_foreach_neighbor(gdb, node_id, NULL, GRAPHDB_DIR_IN, node_edge_changing, &ne);
+}
+
 void graphdb_add_node(GraphDB* gdb, const char* node_id, const char* label) {
     if (!gdb) return;
+    char* old_label = graphdb_get_node_label(gdb, node_id);
+    if (!old_label) {
+        edge_write_begin(gdb);
+        node_edges_changing(gdb, node_id);
+    }
     size_t key_len = 1 + strlen(node_id); // 'N' + node_id
     char* key = (char*)malloc(key_len + 1);
     sprintf(key, "N%s", node_id);
@@ -223,8 +438,25 @@ void graphdb_add_node(GraphDB* gdb, const char* node_id, const char* label) {
     if (err) {
         fprintf(stderr, "Error adding node: %s\n", err);
         free(err);
+        err = NULL;
     }
     free(key);
+    if (!old_label) edge_write_end(gdb);
+
+    // A relabeled node leaves its old label's index
+    if (old_label && strcmp(old_label, label) != 0) {
+        size_t old_key_len = 1 + strlen(old_label) + 1 + strlen(node_id);
+        char* old_key = (char*)malloc(old_key_len + 1);
+        sprintf(old_key, "L%s:%s", old_label, node_id);
+        rocksdb_delete(gdb->db, gdb->writeoptions, old_key, old_key_len, &err);
+        if (err) {
+            fprintf(stderr, "Error removing label index: %s\n", err);
+            free(err);
+            err = NULL;
+        }
+        free(old_key);
+    }
+    free(old_label);
 
     // Add label index "L<label>:<node_id>" -> ""
     size_t l_key_len = 1 + strlen(label) + 1 + strlen(node_id);
@@ -240,6 +472,8 @@ void graphdb_add_node(GraphDB* gdb, const char* node_id, const char* label) {
 
 void graphdb_add_edge(GraphDB* gdb, const char* from, const char* to, const char* type) {
     if (!gdb) return;
+    edge_write_begin(gdb);
+    edge_changing(gdb, from, to, type, 1);
     size_t o_key_len = 1 + strlen(from) + 1 + strlen(type) + 1 + strlen(to); // 'O' + from + ':' + type + ':' + to
     char* o_key = (char*)malloc(o_key_len + 1);
     sprintf(o_key, "O%s:%s:%s", from, type, to);
@@ -259,6 +493,7 @@ void graphdb_add_edge(GraphDB* gdb, const char* from, const char* to, const char
         free(err);
     }
     free(i_key);
+    edge_write_end(gdb);
 }
 
 Neighbor* graphdb_get_outgoing(GraphDB* gdb, const char* node, const char* type, int* count) {
@@ -278,7 +513,7 @@ Neighbor* graphdb_get_outgoing(GraphDB* gdb, const char* node, const char* type,
         sprintf(prefix, "O%s:", node);
     }
     rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
-    rocksdb_iter_seek(it, prefix, prefix_len);
+    io_seek(it, prefix, prefix_len);
     Neighbor* neighbors = NULL;
     *count = 0;
     while (rocksdb_iter_valid(it)) {
@@ -294,7 +529,7 @@ Neighbor* graphdb_get_outgoing(GraphDB* gdb, const char* node, const char* type,
             const char* type_start = key + prefix_len;
             const char* colon = memchr(type_start, ':', klen - prefix_len);
             if (!colon) {
-                rocksdb_iter_next(it);
+                io_next(it);
                 continue;
             }
             size_t type_len = colon - type_start;
@@ -311,7 +546,7 @@ Neighbor* graphdb_get_outgoing(GraphDB* gdb, const char* node, const char* type,
         neighbors[*count].id = id;
         neighbors[*count].type = extracted_type;
         (*count)++;
-        rocksdb_iter_next(it);
+        io_next(it);
     }
     rocksdb_iter_destroy(it);
     free(prefix);
@@ -335,7 +570,7 @@ Neighbor* graphdb_get_incoming(GraphDB* gdb, const char* node, const char* type,
         sprintf(prefix, "I%s:", node);
     }
     rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
-    rocksdb_iter_seek(it, prefix, prefix_len);
+    io_seek(it, prefix, prefix_len);
     Neighbor* neighbors = NULL;
     *count = 0;
     while (rocksdb_iter_valid(it)) {
@@ -351,7 +586,7 @@ Neighbor* graphdb_get_incoming(GraphDB* gdb, const char* node, const char* type,
             const char* type_start = key + prefix_len;
             const char* colon = memchr(type_start, ':', klen - prefix_len);
             if (!colon) {
-                rocksdb_iter_next(it);
+                io_next(it);
                 continue;
             }
             size_t type_len = colon - type_start;
@@ -368,13 +603,66 @@ Neighbor* graphdb_get_incoming(GraphDB* gdb, const char* node, const char* type,
         neighbors[*count].id = id;
         neighbors[*count].type = extracted_type;
         (*count)++;
-        rocksdb_iter_next(it);
+        io_next(it);
     }
     rocksdb_iter_destroy(it);
     free(prefix);
     return neighbors;
 }
 
+// Scans one `O` or `I` adjacency prefix with an existing iterator. `buf` is a
+// reusable prefix buffer grown as needed.
+static int scan_neighbors(rocksdb_iterator_t* it, char dir, const char* node, const char* type,
+                          char** buf, size_t* buf_cap, GraphNeighborFn fn, void* ctx) {
+    size_t node_len = strlen(node);
+    size_t type_len = type ? strlen(type) : 0;
+    size_t prefix_len = 1 + node_len + 1 + (type_len > 0 ? type_len + 1 : 0);
+    if (prefix_len > *buf_cap) {
+        *buf_cap = prefix_len * 2;
+        *buf = (char*)realloc(*buf, *buf_cap);
+    }
+    char* prefix = *buf;
+    prefix[0] = dir;
+    memcpy(prefix + 1, node, node_len);
+    prefix[1 + node_len] = ':';
+    if (type_len > 0) {
+        memcpy(prefix + 2 + node_len, type, type_len);
+        prefix[prefix_len - 1] = ':';
+    }
+    for (io_seek(it, prefix, prefix_len); rocksdb_iter_valid(it); io_next(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen <= prefix_len || memcmp(key, prefix, prefix_len) != 0) break;
+        const char* id = key + prefix_len;
+        size_t id_len = klen - prefix_len;
+        const char* edge_type = type;
+        size_t edge_type_len = type_len;
+        if (type_len == 0) {
+            const char* colon = memchr(id, ':', id_len);
+            if (!colon) continue;
+            edge_type = id;
+            edge_type_len = colon - id;
+            id = colon + 1;
+            id_len = klen - (id - key);
+        }
+        if (fn(ctx, id, id_len, edge_type, edge_type_len)) return 1;
+    }
+    return 0;
+}
+
+int graphdb_foreach_neighbor(GraphDB* gdb, const char* node, const char* type, GraphDirection direction, GraphNeighborFn fn, void* ctx) {
+    if (!gdb || !node || !fn) return 0;
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    char* buf = NULL;
+    size_t buf_cap = 0;
+    int stopped = 0;
+    if (direction & GRAPHDB_DIR_OUT) stopped = scan_neighbors(it, 'O', node, type, &buf, &buf_cap, fn, ctx);
+    if (!stopped && (direction & GRAPHDB_DIR_IN)) stopped = scan_neighbors(it, 'I', node, type, &buf, &buf_cap, fn, ctx);
+    rocksdb_iter_destroy(it);
+    free(buf);
+    return stopped;
+}
+
 char* graphdb_get_node_label(GraphDB* gdb, const char* node_id) {
     size_t key_len = 1 + strlen(node_id); // Adjusted
     char* key = (char*)malloc(key_len + 1);
@@ -382,7 +670,7 @@ char* graphdb_get_node_label(GraphDB* gdb, const char* node_id) {
 
     size_t val_len;
     char* err = NULL;
-    char* value = rocksdb_get(gdb->db, gdb->readoptions, key, key_len, &val_len, &err);
+    char* value = io_get(gdb, key, key_len, &val_len, &err);
     free(key);
     if (err) {
         fprintf(stderr, "Error getting node label: %s\n", err);
@@ -398,6 +686,59 @@ char* graphdb_get_node_label(GraphDB* gdb, const char* node_id) {
     return label;
 }
 
+void graphdb_set_node_property(GraphDB* gdb, const char* node_id, const char* key, const char* value) {
+    graphdb_set_node_properties(gdb, key, &node_id, &value, 1);
+}
+
+// Writes one property for many nodes in a single write batch ("P<node_id>:<key>" -> value)
+void graphdb_set_node_properties(GraphDB* gdb, const char* key, const char** node_ids, const char** values, int count) {
+    if (!gdb || count <= 0) return;
+    rocksdb_writebatch_t* batch = rocksdb_writebatch_create();
+    char* p_key = NULL;
+    size_t p_key_cap = 0;
+    for (int i = 0; i < count; i++) {
+        size_t p_key_len = 1 + strlen(node_ids[i]) + 1 + strlen(key);
+        if (p_key_len + 1 > p_key_cap) {
+            p_key_cap = (p_key_len + 1) * 2;
+            p_key = (char*)realloc(p_key, p_key_cap);
+        }
+        sprintf(p_key, "P%s:%s", node_ids[i], key);
+        rocksdb_writebatch_put(batch, p_key, p_key_len, values[i], strlen(values[i]));
+    }
+    free(p_key);
+    char* err = NULL;
+    rocksdb_write(gdb->db, gdb->writeoptions, batch, &err);
+    if (err) {
+        fprintf(stderr, "Error writing node properties: %s\n", err);
+        free(err);
+    }
+    rocksdb_writebatch_destroy(batch);
+}
+
+char* graphdb_get_node_property(GraphDB* gdb, const char* node_id, const char* key) {
+    if (!gdb) return NULL;
+    size_t p_key_len = 1 + strlen(node_id) + 1 + strlen(key);
+    char* p_key = (char*)malloc(p_key_len + 1);
+    sprintf(p_key, "P%s:%s", node_id, key);
+
+    size_t val_len;
+    char* err = NULL;
+    char* value = io_get(gdb, p_key, p_key_len, &val_len, &err);
+    free(p_key);
+    if (err) {
+        fprintf(stderr, "Error getting node property: %s\n", err);
+        free(err);
+        return NULL;
+    }
+    if (!value) return NULL;
+
+    char* result = (char*)malloc(val_len + 1);
+    memcpy(result, value, val_len);
+    result[val_len] = '\0';
+    free(value);
+    return result;
+}
+
 char** graphdb_get_nodes_by_label(GraphDB* gdb, const char* label, int* count) {
     if (!gdb) {
         *count = 0;
@@ -407,7 +748,7 @@ char** graphdb_get_nodes_by_label(GraphDB* gdb, const char* label, int* count) {
     char* prefix = (char*)malloc(prefix_len + 1);
     sprintf(prefix, "L%s:", label);
     rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
-    rocksdb_iter_seek(it, prefix, prefix_len);
+    io_seek(it, prefix, prefix_len);
     char** nodes = NULL;
     *count = 0;
     while (rocksdb_iter_valid(it)) {
@@ -422,7 +763,7 @@ char** graphdb_get_nodes_by_label(GraphDB* gdb, const char* label, int* count) {
         nodes = (char**)realloc(nodes, sizeof(char*) * (*count + 1));
         nodes[*count] = id;
         (*count)++;
-        rocksdb_iter_next(it);
+        io_next(it);
     }
     rocksdb_iter_destroy(it);
     free(prefix);
@@ -438,7 +779,7 @@ char** graphdb_get_all_nodes(GraphDB* gdb, int* count) {
     char* prefix = (char*)malloc(prefix_len + 1);
     sprintf(prefix, "N");
     rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
-    rocksdb_iter_seek(it, prefix, prefix_len);
+    io_seek(it, prefix, prefix_len);
     char** nodes = NULL;
     *count = 0;
     while (rocksdb_iter_valid(it)) {
@@ -453,13 +794,82 @@ char** graphdb_get_all_nodes(GraphDB* gdb, int* count) {
         nodes = (char**)realloc(nodes, sizeof(char*) * (*count + 1));
         nodes[*count] = id;
         (*count)++;
-        rocksdb_iter_next(it);
+        io_next(it);
     }
     rocksdb_iter_destroy(it);
     free(prefix);
     return nodes;
 }
 
+char** graphdb_scan_nodes(GraphDB* gdb, const char* label, const char* after, int max, int* count) {
+    *count = 0;
+    if (!gdb || max <= 0) return NULL;
+    size_t prefix_len = label ? 1 + strlen(label) + 1 : 1;
+    size_t after_len = after ? strlen(after) : 0;
+    char* start = (char*)malloc(prefix_len + after_len + 1);
+    if (label) sprintf(start, "L%s:", label);
+    else sprintf(start, "N");
+    if (after) memcpy(start + prefix_len, after, after_len + 1);
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    io_seek(it, start, prefix_len + after_len);
+    char** nodes = (char**)malloc(sizeof(char*) * max);
+    while (rocksdb_iter_valid(it) && *count < max) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen <= prefix_len || memcmp(key, start, prefix_len) != 0) break;
+        if (after && klen == prefix_len + after_len && memcmp(key + prefix_len, after, after_len) == 0) {
+            io_next(it);
+            continue;
+        }
+        size_t id_len = klen - prefix_len;
+        char* id = (char*)malloc(id_len + 1);
+        memcpy(id, key + prefix_len, id_len);
+        id[id_len] = '\0';
+        nodes[(*count)++] = id;
+        io_next(it);
+    }
+    rocksdb_iter_destroy(it);
+    free(start);
+    return nodes;
+}
+
+long long graphdb_count_nodes(GraphDB* gdb, const char* label, long long limit) {
+    if (!gdb) return 0;
+    size_t prefix_len = label ? 1 + strlen(label) + 1 : 1;
+    char* prefix = (char*)malloc(prefix_len + 1);
+    if (label) sprintf(prefix, "L%s:", label);
+    else sprintf(prefix, "N");
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    long long count = 0;
+    for (io_seek(it, prefix, prefix_len); rocksdb_iter_valid(it) && count < limit; io_next(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen <= prefix_len || memcmp(key, prefix, prefix_len) != 0) break;
+        count++;
+    }
+    rocksdb_iter_destroy(it);
+    free(prefix);
+    return count;
+}
+
+typedef struct {
+    long long count;
+    long long limit;
+} DegreeCount;
+
+static int count_neighbor(void* ctx, const char* id, size_t id_len, const char* type, size_t type_len) {
+    (void)id; (void)id_len; (void)type; (void)type_len;
+    DegreeCount* dc = (DegreeCount*)ctx;
+    return ++dc->count >= dc->limit;
+}
+
+long long graphdb_degree(GraphDB* gdb, const char* node, const char* type, GraphDirection direction, long long limit) {
+    DegreeCount dc = {0, limit};
+    if (limit <= 0) return 0;
+    graphdb_foreach_neighbor(gdb, node, type, direction, count_neighbor, &dc);
+    return dc.count;
+}
+
 void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
     char* label = graphdb_get_node_label(gdb, node_id);
     if (label) {
@@ -481,12 +891,33 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
     free(n_key);
     if (err) free(err);
 
+    // Delete properties
+    size_t p_prefix_len = 1 + strlen(node_id) + 1;
+    char* p_prefix = (char*)malloc(p_prefix_len + 1);
+    sprintf(p_prefix, "P%s:", node_id);
+    rocksdb_iterator_t* p_it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    io_seek(p_it, p_prefix, p_prefix_len);
+    while (rocksdb_iter_valid(p_it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(p_it, &klen);
+        if (klen < p_prefix_len || memcmp(key, p_prefix, p_prefix_len) != 0) break;
+        rocksdb_delete(gdb->db, gdb->writeoptions, key, klen, &err);
+        if (err) {
+            free(err);
+            err = NULL;
+        }
+        io_next(p_it);
+    }
+    rocksdb_iter_destroy(p_it);
+    free(p_prefix);
+
     // Delete outgoing edges and their incoming counterparts
+    edge_write_begin(gdb);
     size_t o_prefix_len = 1 + strlen(node_id) + 1;
     char* o_prefix = (char*)malloc(o_prefix_len + 1);
     sprintf(o_prefix, "O%s:", node_id);
     rocksdb_iterator_t* o_it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
-    rocksdb_iter_seek(o_it, o_prefix, o_prefix_len);
+    io_seek(o_it, o_prefix, o_prefix_len);
     while (rocksdb_iter_valid(o_it)) {
         size_t klen;
         const char* key = rocksdb_iter_key(o_it, &klen);
@@ -495,7 +926,7 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
         const char* after_prefix = key + o_prefix_len;
         const char* colon = strchr(after_prefix, ':');
         if (!colon) {
-            rocksdb_iter_next(o_it);
+            io_next(o_it);
             continue;
         }
         size_t type_len = colon - after_prefix;
@@ -508,6 +939,7 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
         memcpy(to, to_start, to_len);
         to[to_len] = '\0';
         // Delete outgoing
+        edge_changing(gdb, node_id, to, type, 0);
         rocksdb_delete(gdb->db, gdb->writeoptions, key, klen, &err);
         if (err) free(err); err = NULL;
         // Delete corresponding incoming
@@ -519,7 +951,7 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
         if (err) free(err); err = NULL;
         free(type);
         free(to);
-        rocksdb_iter_next(o_it);
+        io_next(o_it);
     }
     rocksdb_iter_destroy(o_it);
     free(o_prefix);
@@ -529,7 +961,7 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
     char* i_prefix = (char*)malloc(i_prefix_len + 1);
     sprintf(i_prefix, "I%s:", node_id);
     rocksdb_iterator_t* i_it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
-    rocksdb_iter_seek(i_it, i_prefix, i_prefix_len);
+    io_seek(i_it, i_prefix, i_prefix_len);
     while (rocksdb_iter_valid(i_it)) {
         size_t klen;
         const char* key = rocksdb_iter_key(i_it, &klen);
@@ -538,7 +970,7 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
         const char* after_prefix = key + i_prefix_len;
         const char* colon = strchr(after_prefix, ':');
         if (!colon) {
-            rocksdb_iter_next(i_it);
+            io_next(i_it);
             continue;
         }
         size_t type_len = colon - after_prefix;
@@ -551,6 +983,7 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
         memcpy(from, from_start, from_len);
         from[from_len] = '\0';
         // Delete incoming
+        edge_changing(gdb, from, node_id, type, 0);
         rocksdb_delete(gdb->db, gdb->writeoptions, key, klen, &err);
         if (err) free(err); err = NULL;
         // Delete corresponding outgoing
@@ -562,13 +995,16 @@ void graphdb_delete_node(GraphDB* gdb, const char* node_id) {
         if (err) free(err); err = NULL;
         free(type);
         free(from);
-        rocksdb_iter_next(i_it);
+        io_next(i_it);
     }
     rocksdb_iter_destroy(i_it);
     free(i_prefix);
+    edge_write_end(gdb);
 }
 
 void graphdb_delete_edge(GraphDB* gdb, const char* from, const char* to, const char* type) {
+    edge_write_begin(gdb);
+    edge_changing(gdb, from, to, type, 0);
     size_t o_key_len = 1 + strlen(from) + 1 + strlen(type) + 1 + strlen(to);
     char* o_key = (char*)malloc(o_key_len + 1);
     sprintf(o_key, "O%s:%s:%s", from, type, to);
@@ -589,6 +1025,7 @@ void graphdb_delete_edge(GraphDB* gdb, const char* from, const char* to, const c
         fprintf(stderr, "Error deleting incoming edge: %s\n", err);
         free(err);
     }
+    edge_write_end(gdb);
 }
 
 void graphdb_execute_basic_cypher(GraphDB* gdb, const char* query) {
@@ -793,4 +1230,276 @@ void find_shortest_path(GraphDB* gdb, const char* start, const char* end, const
         free(parents[i].parent);
     }
     free(parents);
-}
\ No newline at end of file
+}
+
+typedef struct {
+    StrMap* visited; // node id -> discovery order; entry 0 is the start node
+    int* next;
+    int next_count;
+    int next_capacity;
+    int depth;
+    GraphKHopFn fn;
+    void* ctx;
+    int stopped;
+} KHopState;
+
+static int khop_visit(void* arg, const char* id, size_t id_len, const char* type, size_t type_len) {
+    (void)type;
+    (void)type_len;
+    KHopState* st = (KHopState*)arg;
+    int inserted;
+    int idx = strmap_intern(st->visited, id, id_len, &inserted);
+    if (!inserted) return 0;
+    if (st->next_count >= st->next_capacity) {
+        st->next_capacity = st->next_capacity ? st->next_capacity * 2 : 64;
+        st->next = (int*)realloc(st->next, sizeof(int) * st->next_capacity);
+    }
+    st->next[st->next_count++] = idx;
+    if (st->fn && st->fn(st->ctx, st->visited->entries[idx].key, st->depth)) {
+        st->stopped = 1;
+        return 1;
+    }
+    return 0;
+}
+
+long long graphdb_khop(GraphDB* gdb, const char* start, const char* type, int k, GraphDirection direction, GraphKHopFn fn, void* ctx) {
+    if (!gdb || !start || k <= 0) return 0;
+
+    KHopState st = {0};
+    st.visited = strmap_create(256);
+    st.fn = fn;
+    st.ctx = ctx;
+    strmap_intern(st.visited, start, strlen(start), NULL);
+
+    int frontier_capacity = 64;
+    int* frontier = (int*)malloc(sizeof(int) * frontier_capacity);
+    int frontier_count = 1;
+    frontier[0] = 0;
+
+    // One iterator and prefix buffer for the whole expansion
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    char* buf = NULL;
+    size_t buf_cap = 0;
+
+    for (int depth = 1; depth <= k && frontier_count > 0 && !st.stopped; depth++) {
+        st.depth = depth;
+        st.next_count = 0;
+        for (int i = 0; i < frontier_count && !st.stopped; i++) {
+            // Keys live in the map's chunk storage and survive entry growth
+            const char* node = st.visited->entries[frontier[i]].key;
+            if (direction & GRAPHDB_DIR_OUT) scan_neighbors(it, 'O', node, type, &buf, &buf_cap, khop_visit, &st);
+            if (!st.stopped && (direction & GRAPHDB_DIR_IN)) scan_neighbors(it, 'I', node, type, &buf, &buf_cap, khop_visit, &st);
+        }
+        // The new level becomes the frontier; the old buffer is reused for the next one
+        int* tmp = frontier;
+        frontier = st.next;
+        frontier_count = st.next_count;
+        st.next = tmp;
+        int tmp_capacity = frontier_capacity;
+        frontier_capacity = st.next_capacity;
+        st.next_capacity = tmp_capacity;
+    }
+
+    long long reached = st.visited->count - 1;
+    rocksdb_iter_destroy(it);
+    free(buf);
+    free(frontier);
+    free(st.next);
+    strmap_destroy(st.visited);
+    return reached;
+}
+
+typedef enum {
+    SIMILARITY_COMMON,
+    SIMILARITY_JACCARD,
+    SIMILARITY_ADAMIC_ADAR
+} SimilarityMetric;
+
+typedef struct {
+    StrMap* neighbors;  // the query node (entry 0) and its out-neighbors
+    StrMap* candidates; // two-hop nodes, entry index -> score/common/last_via
+    StrMap* scratch;    // distinct neighbors while measuring a degree
+    double* score;
+    int* common;
+    int* last_via;
+    int capacity;
+    int via;            // neighbors entry currently being expanded
+    int* pending;       // candidates reached through `via`
+    int pending_count;
+} SimilarityState;
+
+static int similarity_collect(void* arg, const char* id, size_t id_len, const char* type, size_t type_len) {
+    (void)type;
+    (void)type_len;
+    strmap_intern((StrMap*)arg, id, id_len, NULL);
+    return 0;
+}
+
+static int similarity_visit(void* arg, const char* id, size_t id_len, const char* type, size_t type_len) {
+    (void)type;
+    (void)type_len;
+    SimilarityState* st = (SimilarityState*)arg;
+    if (strmap_find(st->neighbors, id, id_len) >= 0) return 0;
+    int inserted;
+    int idx = strmap_intern(st->candidates, id, id_len, &inserted);
+    if (idx >= st->capacity) {
+        st->capacity *= 2;
+        st->score = (double*)realloc(st->score, sizeof(double) * st->capacity);
+        st->common = (int*)realloc(st->common, sizeof(int) * st->capacity);
+        st->last_via = (int*)realloc(st->last_via, sizeof(int) * st->capacity);
+        st->pending = (int*)realloc(st->pending, sizeof(int) * st->capacity);
+    }
+    if (inserted) {
+        st->score[idx] = 0.0;
+        st->common[idx] = 0;
+        st->last_via[idx] = -1;
+    }
+    // Parallel edges of different types count once per intermediate node
+    if (st->last_via[idx] == st->via) return 0;
+    st->last_via[idx] = st->via;
+    st->common[idx]++;
+    st->pending[st->pending_count++] = idx;
+    return 0;
+}
+
+// Number of distinct neighbors of `node` in `direction`
+static int similarity_degree(SimilarityState* st, rocksdb_iterator_t* it, const char* node, const char* type,
+                             GraphDirection direction, char** buf, size_t* buf_cap) {
+    strmap_clear(st->scratch);
+    if (direction & GRAPHDB_DIR_OUT) scan_neighbors(it, 'O', node, type, buf, buf_cap, similarity_collect, st->scratch);
+    if (direction & GRAPHDB_DIR_IN) scan_neighbors(it, 'I', node, type, buf, buf_cap, similarity_collect, st->scratch);
+    return st->scratch->count;
+}
+
+// Heap order: lower score first, then larger id, so the root is the weakest kept entry
+static int similarity_weaker(const SimilarityState* st, int a, int b) {
+    if (st->score[a] != st->score[b]) return st->score[a] < st->score[b];
+    return strcmp(st->candidates->entries[a].key, st->candidates->entries[b].key) > 0;
+}
+
+static void similarity_sift_down(const SimilarityState* st, int* heap, int size, int i) {
+    while (1) {
+        int smallest = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if (l < size && similarity_weaker(st, heap[l], heap[smallest])) smallest = l;
+        if (r < size && similarity_weaker(st, heap[r], heap[smallest])) smallest = r;
+        if (smallest == i) return;
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void similarity_offer(const SimilarityState* st, int* heap, int* size, int k, int idx) {
+    if (*size < k) {
+        int i = (*size)++;
+        heap[i] = idx;
+        while (i > 0 && similarity_weaker(st, heap[i], heap[(i - 1) / 2])) {
+            int parent = (i - 1) / 2;
+            heap[i] = heap[parent];
+            heap[parent] = idx;
+            i = parent;
+        }
+    } else if (similarity_weaker(st, heap[0], idx)) {
+        heap[0] = idx;
+        similarity_sift_down(st, heap, *size, 0);
+    }
+}
+
+static ScoredNode* top_k_similar(GraphDB* gdb, const char* node, const char* type, int k, SimilarityMetric metric, int* count) {
+    *count = 0;
+    if (!gdb || !node || k <= 0) return NULL;
+
+    SimilarityState st = {0};
+    st.neighbors = strmap_create(64);
+    st.candidates = strmap_create(256);
+    st.scratch = strmap_create(64);
+    st.capacity = 256;
+    st.score = (double*)malloc(sizeof(double) * st.capacity);
+    st.common = (int*)malloc(sizeof(int) * st.capacity);
+    st.last_via = (int*)malloc(sizeof(int) * st.capacity);
+    st.pending = (int*)malloc(sizeof(int) * st.capacity);
+
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    char* buf = NULL;
+    size_t buf_cap = 0;
+
+    strmap_intern(st.neighbors, node, strlen(node), NULL);
+    scan_neighbors(it, 'O', node, type, &buf, &buf_cap, similarity_collect, st.neighbors);
+    int node_degree = st.neighbors->count - 1;
+
+    for (int b = 1; b < st.neighbors->count; b++) {
+        const char* via = st.neighbors->entries[b].key;
+        st.via = b;
+        st.pending_count = 0;
+        scan_neighbors(it, 'O', via, type, &buf, &buf_cap, similarity_visit, &st);
+        if (metric == SIMILARITY_ADAMIC_ADAR && st.pending_count > 0) {
+            // At least 2: the query node in, the candidate out
+            int degree = similarity_degree(&st, it, via, type, GRAPHDB_DIR_BOTH, &buf, &buf_cap);
+            double weight = degree > 1 ? 1.0 / log((double)degree) : 0.0;
+            for (int i = 0; i < st.pending_count; i++) st.score[st.pending[i]] += weight;
+        }
+    }
+
+    int* heap = (int*)malloc(sizeof(int) * (k < st.candidates->count ? k : st.candidates->count) + sizeof(int));
+    int heap_size = 0;
+    for (int c = 0; c < st.candidates->count; c++) {
+        if (metric == SIMILARITY_COMMON) {
+            st.score[c] = (double)st.common[c];
+        } else if (metric == SIMILARITY_JACCARD) {
+            // The union is at least N(a), so common / |N(a)| bounds the score;
+            // candidates that cannot enter the heap skip the degree scan
+            if (heap_size == k && (double)st.common[c] / node_degree < st.score[heap[0]]) continue;
+            int degree = similarity_degree(&st, it, st.candidates->entries[c].key, type, GRAPHDB_DIR_IN, &buf, &buf_cap);
+            st.score[c] = (double)st.common[c] / (double)(node_degree + degree - st.common[c]);
+        }
+        similarity_offer(&st, heap, &heap_size, k, c);
+    }
+
+    ScoredNode* result = NULL;
+    if (heap_size > 0) {
+        result = (ScoredNode*)malloc(sizeof(ScoredNode) * heap_size);
+        *count = heap_size;
+        // Popping the weakest entry fills the result from the back
+        while (heap_size > 0) {
+            int c = heap[0];
+            ScoredNode* out = &result[heap_size - 1];
+            out->id = strdup(st.candidates->entries[c].key);
+            out->score = st.score[c];
+            out->common = st.common[c];
+            heap[0] = heap[--heap_size];
+            similarity_sift_down(&st, heap, heap_size, 0);
+        }
+    }
+
+    rocksdb_iter_destroy(it);
+    free(buf);
+    free(heap);
+    free(st.score);
+    free(st.common);
+    free(st.last_via);
+    free(st.pending);
+    strmap_destroy(st.neighbors);
+    strmap_destroy(st.candidates);
+    strmap_destroy(st.scratch);
+    return result;
+}
+
+ScoredNode* graphdb_top_k_common_neighbors(GraphDB* gdb, const char* node, const char* type, int k, int* count) {
+    return top_k_similar(gdb, node, type, k, SIMILARITY_COMMON, count);
+}
+
+ScoredNode* graphdb_top_k_jaccard(GraphDB* gdb, const char* node, const char* type, int k, int* count) {
+    return top_k_similar(gdb, node, type, k, SIMILARITY_JACCARD, count);
+}
+
+ScoredNode* graphdb_top_k_adamic_adar(GraphDB* gdb, const char* node, const char* type, int k, int* count) {
+    return top_k_similar(gdb, node, type, k, SIMILARITY_ADAMIC_ADAR, count);
+}
+
+void graphdb_free_scored_nodes(ScoredNode* nodes, int count) {
+    if (!nodes) return;
+    for (int i = 0; i < count; i++) free(nodes[i].id);
+    free(nodes);
+}
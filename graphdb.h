@@ -2,6 +2,7 @@
 #define GRAPHDB_H
 
 #include <rocksdb/c.h>
+#include <pthread.h>
 
 typedef struct GraphDB {
     rocksdb_t *db;
@@ -10,6 +11,31 @@ typedef struct GraphDB {
     rocksdb_cache_t *cache;
     rocksdb_writeoptions_t *writeoptions;
     rocksdb_readoptions_t *readoptions;
+
+    // Reachability indexes (reach_index.c). `reach_types` lists the type specs
+    // whose persisted `R` labels are current; any edge change of a covered type
+    // drops the spec before the edge is written.
+    pthread_mutex_t reach_mutex;
+    char** reach_types;
+    int reach_type_count;
+    unsigned long long reach_epoch;     // bumped on every invalidation
+    unsigned long long edge_generation; // bumped after every edge write
+    int edges_in_flight;                // edge writes started but not finished
+    // Optional: returns non-zero if adding from->to keeps the spec's index
+    // current (b already reachable from a). Called without reach_mutex.
+    int (*reach_keep)(struct GraphDB* gdb, const char* spec, const char* from, const char* to);
+    void (*reach_shutdown)(struct GraphDB* gdb);
+    void* reach_state;
+
+    // Cypher plan cache (cypher_parser.c), created on first use, the depth
+    // of unbounded variable-length hops, the ORDER BY memory budget and the
+    // threads per label scan (0 for the defaults); all guarded by plan_mutex
+    pthread_mutex_t plan_mutex;
+    void* plan_cache;
+    void (*plan_cache_free)(void* cache);
+    int max_var_hops;
+    size_t sort_memory;
+    int query_threads;
 } GraphDB;
 
 typedef struct {
@@ -17,17 +43,92 @@ typedef struct {
   char* type;
 } Neighbor;
 
+typedef enum {
+    GRAPHDB_DIR_OUT = 1,
+    GRAPHDB_DIR_IN = 2,
+    GRAPHDB_DIR_BOTH = 3
+} GraphDirection;
+
+// Neighbor visitor; `id` and `type` point into the iterator key (not NUL
+// terminated) and are only valid for the duration of the call. Return
+// non-zero to stop the scan.
+typedef int (*GraphNeighborFn)(void* ctx, const char* id, size_t id_len, const char* type, size_t type_len);
+
+// RocksDB calls made through graphdb_* on the calling thread since it
+// started, for query profiles. Block reads and cache hits come from
+// RocksDB's perf context and stay 0 unless graphdb_io_perf is on.
+typedef struct {
+    unsigned long long seeks;
+    unsigned long long nexts;
+    unsigned long long gets;
+    unsigned long long get_bytes;   // value bytes returned by gets
+    unsigned long long block_reads;
+    unsigned long long cache_hits;
+} GraphIOStats;
+
+// Called once per distinct node, in depth order; return non-zero to stop
+typedef int (*GraphKHopFn)(void* ctx, const char* node_id, int depth);
+
+// Friend-of-friend recommendation: a node two outgoing hops away that is not
+// already a direct neighbor, with `common` intermediate nodes
+typedef struct {
+    char* id;
+    double score;
+    int common;
+} ScoredNode;
+
 GraphDB* graphdb_open(const char* path);
+// True if `type` is one of the '|'-separated types in `spec`; an empty or
+// NULL spec matches every type
+int graphdb_type_matches(const char* spec, const char* type, size_t type_len);
+// Drops the reachability index marker for `spec` (its labels stay until rebuilt)
+void graphdb_reach_unmark(GraphDB* gdb, const char* spec);
 void graphdb_close(GraphDB* gdb);
+void graphdb_io_stats(GraphIOStats* stats);
+// Turns RocksDB's perf context on or off for the calling thread; its counts
+// restart from 0 each time it is turned on
+void graphdb_io_perf(int enable);
 void graphdb_add_node(GraphDB* gdb, const char* node_id, const char* label);
 void graphdb_add_edge(GraphDB* gdb, const char* from, const char* to, const char* type);
 Neighbor* graphdb_get_outgoing(GraphDB* gdb, const char* node, const char* type, int* count);
 Neighbor* graphdb_get_incoming(GraphDB* gdb, const char* node, const char* type, int* count);
+// Zero-copy alternative to get_outgoing/get_incoming; returns 1 if stopped early
+int graphdb_foreach_neighbor(GraphDB* gdb, const char* node, const char* type, GraphDirection direction, GraphNeighborFn fn, void* ctx);
 char* graphdb_get_node_label(GraphDB* gdb, const char* node_id);
+void graphdb_set_node_property(GraphDB* gdb, const char* node_id, const char* key, const char* value);
+void graphdb_set_node_properties(GraphDB* gdb, const char* key, const char** node_ids, const char** values, int count);
+char* graphdb_get_node_property(GraphDB* gdb, const char* node_id, const char* key);
 char** graphdb_get_nodes_by_label(GraphDB* gdb, const char* label, int* count);
 char** graphdb_get_all_nodes(GraphDB* gdb, int* count);
+// One page of node ids with `label` (NULL for all nodes) in key order: at
+// most `max` ids sorting after `after` (NULL for the first page). Lets a scan
+// stop early without materializing the whole label.
+char** graphdb_scan_nodes(GraphDB* gdb, const char* label, const char* after, int max, int* count);
+// Planner statistics: the number of nodes with `label` (NULL for all nodes)
+// and the number of edges of `node` over `type` (single type, or NULL/"" for
+// all) in `direction`. Both stop counting at `limit`, so a large label or a
+// hub costs at most `limit` iterator steps.
+long long graphdb_count_nodes(GraphDB* gdb, const char* label, long long limit);
+long long graphdb_degree(GraphDB* gdb, const char* node, const char* type, GraphDirection direction, long long limit);
 void graphdb_delete_node(GraphDB* gdb, const char* node_id);
 void graphdb_delete_edge(GraphDB* gdb, const char* from, const char* to, const char* type);
+// Distinct nodes within 1..k hops of `start` (start itself excluded). The
+// frontier is deduplicated with a visited set, so each node is expanded once.
+// `fn` may be NULL to only count. Returns the number of nodes reached.
+long long graphdb_khop(GraphDB* gdb, const char* start, const char* type, int k, GraphDirection direction, GraphKHopFn fn, void* ctx);
+// Top `k` nodes reachable in two outgoing hops over `type` (single type, or
+// NULL/"" for all), excluding `node` and its direct neighbors, best first with
+// ties broken by id. Two-hop counts are aggregated in a hash map and ranked
+// with a bounded heap, no paths are built. Scores are the number of common
+// neighbors, Jaccard |N(a) & N(c)| / |N(a) | N(c)| with N(a) the
+// out-neighbors of `node` and N(c) the in-neighbors of the candidate (the same
+// sets for symmetric relationships), or Adamic-Adar, the sum of 1 / log(degree)
+// over common neighbors (distinct in + out neighbors). Returns NULL with
+// *count = 0 when there are none.
+ScoredNode* graphdb_top_k_common_neighbors(GraphDB* gdb, const char* node, const char* type, int k, int* count);
+ScoredNode* graphdb_top_k_jaccard(GraphDB* gdb, const char* node, const char* type, int k, int* count);
+ScoredNode* graphdb_top_k_adamic_adar(GraphDB* gdb, const char* node, const char* type, int k, int* count);
+void graphdb_free_scored_nodes(ScoredNode* nodes, int count);
 void find_shortest_path(GraphDB* gdb, const char* start, const char* end, const char* type);
 
 #endif 
\ No newline at end of file
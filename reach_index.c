@@ -0,0 +1,672 @@
+// reach_index.c
+#include "reach_index.h"
+#include "graph_algo.h"
+#include "strmap.h"
+#include <rocksdb/c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define REACH_WRITE_BATCH 10000
+
+// One per type spec that has (or had) an index in this process
+typedef struct ReachBuilder {
+    char* spec;
+    GraphDB* gdb;
+    int indexed; // rebuild when found stale; cleared by drop
+    int running;
+    int joinable;
+    pthread_t thread;
+    struct ReachBuilder* next;
+} ReachBuilder;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t idle;
+    ReachBuilder* builders;
+} ReachState;
+
+/*******************************
+ * Label storage
+ *******************************/
+
+// Label value: int out_count, int in_count, out ranks, in ranks (ascending)
+static char* label_get(GraphDB* gdb, const char* spec, const char* node, size_t* len) {
+    size_t key_len = 1 + strlen(spec) + 1 + strlen(node);
+    char* key = (char*)malloc(key_len + 1);
+    sprintf(key, "R%s:%s", spec, node);
+    char* err = NULL;
+    char* value = rocksdb_get(gdb->db, gdb->readoptions, key, key_len, len, &err);
+    free(key);
+    if (err) {
+        fprintf(stderr, "Error reading reachability label: %s\n", err);
+        free(err);
+        return NULL;
+    }
+    if (value && *len < 2 * sizeof(int)) {
+        free(value);
+        return NULL;
+    }
+    return value;
+}
+
+static int ranks_intersect(const int* a, int na, const int* b, int nb) {
+    int i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (a[i] == b[j]) return 1;
+        if (a[i] < b[j]) i++;
+        else j++;
+    }
+    return 0;
+}
+
+// Nodes without a label had no edges of the spec when the index was built
+static int labels_reach(GraphDB* gdb, const char* spec, const char* a, const char* b) {
+    if (strcmp(a, b) == 0) return 1;
+    size_t alen, blen;
+    char* va = label_get(gdb, spec, a, &alen);
+    if (!va) return 0;
+    char* vb = label_get(gdb, spec, b, &blen);
+    if (!vb) {
+        free(va);
+        return 0;
+    }
+    int a_out, b_out, b_in;
+    memcpy(&a_out, va, sizeof(int));
+    memcpy(&b_out, vb, sizeof(int));
+    memcpy(&b_in, vb + sizeof(int), sizeof(int));
+    int reach = ranks_intersect((const int*)(va + 2 * sizeof(int)), a_out,
+                                (const int*)(vb + (2 + b_out) * sizeof(int)), b_in);
+    free(va);
+    free(vb);
+    return reach;
+}
+
+// reach_keep hook: an edge between already connected nodes keeps the index current
+static int keep_if_connected(GraphDB* gdb, const char* spec, const char* from, const char* to) {
+    return labels_reach(gdb, spec, from, to);
+}
+
+static int spec_current(GraphDB* gdb, const char* spec, unsigned long long* epoch) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    int current = 0;
+    for (int i = 0; i < gdb->reach_type_count; i++) {
+        if (strcmp(gdb->reach_types[i], spec) == 0) current = 1;
+    }
+    if (epoch) *epoch = gdb->reach_epoch;
+    pthread_mutex_unlock(&gdb->reach_mutex);
+    return current;
+}
+
+static int labels_exist(GraphDB* gdb, const char* spec) {
+    size_t prefix_len = 1 + strlen(spec) + 1;
+    char* prefix = (char*)malloc(prefix_len + 1);
+    sprintf(prefix, "R%s:", spec);
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    rocksdb_iter_seek(it, prefix, prefix_len);
+    int found = 0;
+    if (rocksdb_iter_valid(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        found = klen > prefix_len && memcmp(key, prefix, prefix_len) == 0;
+    }
+    rocksdb_iter_destroy(it);
+    free(prefix);
+    return found;
+}
+
+static void batch_flush(GraphDB* gdb, rocksdb_writebatch_t* batch) {
+    char* err = NULL;
+    rocksdb_write(gdb->db, gdb->writeoptions, batch, &err);
+    if (err) {
+        fprintf(stderr, "Error writing reachability labels: %s\n", err);
+        free(err);
+    }
+    rocksdb_writebatch_clear(batch);
+}
+
+static void delete_labels(GraphDB* gdb, const char* spec) {
+    size_t prefix_len = 1 + strlen(spec) + 1;
+    char* prefix = (char*)malloc(prefix_len + 1);
+    sprintf(prefix, "R%s:", spec);
+    rocksdb_writebatch_t* batch = rocksdb_writebatch_create();
+    rocksdb_iterator_t* it = rocksdb_create_iterator(gdb->db, gdb->readoptions);
+    for (rocksdb_iter_seek(it, prefix, prefix_len); rocksdb_iter_valid(it); rocksdb_iter_next(it)) {
+        size_t klen;
+        const char* key = rocksdb_iter_key(it, &klen);
+        if (klen < prefix_len || memcmp(key, prefix, prefix_len) != 0) break;
+        rocksdb_writebatch_delete(batch, key, klen);
+        if (rocksdb_writebatch_count(batch) >= REACH_WRITE_BATCH) batch_flush(gdb, batch);
+    }
+    rocksdb_iter_destroy(it);
+    if (rocksdb_writebatch_count(batch) > 0) batch_flush(gdb, batch);
+    rocksdb_writebatch_destroy(batch);
+    free(prefix);
+}
+
+/*******************************
+ * Condensation and labeling
+ *******************************/
+
+// Iterative Tarjan; returns the number of components
+static int scc_condense(const GraphCSR* csr, int* comp) {
+    int n = csr->node_count;
+    int* index = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int* low = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int* stack = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    char* on_stack = (char*)calloc(n > 0 ? n : 1, 1);
+    int* call_node = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    long long* call_edge = (long long*)malloc(sizeof(long long) * (n > 0 ? n : 1));
+    for (int v = 0; v < n; v++) index[v] = -1;
+
+    int next_index = 0, comp_count = 0, sp = 0;
+    for (int s = 0; s < n; s++) {
+        if (index[s] != -1) continue;
+        int depth = 0;
+        call_node[0] = s;
+        call_edge[0] = csr->out_offsets[s];
+        index[s] = low[s] = next_index++;
+        stack[sp++] = s;
+        on_stack[s] = 1;
+        while (depth >= 0) {
+            int v = call_node[depth];
+            if (call_edge[depth] < csr->out_offsets[v + 1]) {
+                int w = csr->out_targets[call_edge[depth]++];
+                if (index[w] == -1) {
+                    index[w] = low[w] = next_index++;
+                    stack[sp++] = w;
+                    on_stack[w] = 1;
+                    depth++;
+                    call_node[depth] = w;
+                    call_edge[depth] = csr->out_offsets[w];
+                } else if (on_stack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+            if (low[v] == index[v]) {
+                int w;
+                do {
+                    w = stack[--sp];
+                    on_stack[w] = 0;
+                    comp[w] = comp_count;
+                } while (w != v);
+                comp_count++;
+            }
+            depth--;
+            if (depth >= 0 && low[v] < low[call_node[depth]]) low[call_node[depth]] = low[v];
+        }
+    }
+    free(index);
+    free(low);
+    free(stack);
+    free(on_stack);
+    free(call_node);
+    free(call_edge);
+    return comp_count;
+}
+
+// Component DAG in CSR form, parallel edges removed
+typedef struct {
+    int count;
+    long long* out_offsets;
+    int* out_targets;
+    long long* in_offsets;
+    int* in_sources;
+} CompDAG;
+
+static void dag_build(const GraphCSR* csr, const int* comp, int comp_count, CompDAG* dag) {
+    int n = csr->node_count;
+    int c_alloc = comp_count > 0 ? comp_count : 1;
+    // Members grouped by component
+    long long* member_offsets = (long long*)calloc(comp_count + 1, sizeof(long long));
+    int* members = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    for (int v = 0; v < n; v++) member_offsets[comp[v] + 1]++;
+    for (int c = 0; c < comp_count; c++) member_offsets[c + 1] += member_offsets[c];
+    long long* pos = (long long*)malloc(sizeof(long long) * c_alloc);
+    memcpy(pos, member_offsets, sizeof(long long) * c_alloc);
+    for (int v = 0; v < n; v++) members[pos[comp[v]]++] = v;
+
+    int* mark = (int*)malloc(sizeof(int) * c_alloc);
+    for (int c = 0; c < comp_count; c++) mark[c] = -1;
+    dag->count = comp_count;
+    dag->out_offsets = (long long*)calloc(comp_count + 1, sizeof(long long));
+    dag->in_offsets = (long long*)calloc(comp_count + 1, sizeof(long long));
+    dag->out_targets = NULL;
+    // Pass 0 counts distinct successors, pass 1 fills them
+    for (int pass = 0; pass < 2; pass++) {
+        for (int c = 0; c < comp_count; c++) {
+            long long fill = pass ? dag->out_offsets[c] : 0;
+            for (long long m = member_offsets[c]; m < member_offsets[c + 1]; m++) {
+                int u = members[m];
+                for (long long e = csr->out_offsets[u]; e < csr->out_offsets[u + 1]; e++) {
+                    int cw = comp[csr->out_targets[e]];
+                    if (cw == c || mark[cw] == 2 * c + pass) continue;
+                    mark[cw] = 2 * c + pass;
+                    if (pass) dag->out_targets[fill++] = cw;
+                    else dag->out_offsets[c + 1]++;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int c = 0; c < comp_count; c++) dag->out_offsets[c + 1] += dag->out_offsets[c];
+            long long m = dag->out_offsets[comp_count];
+            dag->out_targets = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+        }
+    }
+    long long m = dag->out_offsets[comp_count];
+    dag->in_sources = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    for (long long e = 0; e < m; e++) dag->in_offsets[dag->out_targets[e] + 1]++;
+    for (int c = 0; c < comp_count; c++) dag->in_offsets[c + 1] += dag->in_offsets[c];
+    memcpy(pos, dag->in_offsets, sizeof(long long) * c_alloc);
+    for (int c = 0; c < comp_count; c++) {
+        for (long long e = dag->out_offsets[c]; e < dag->out_offsets[c + 1]; e++) {
+            dag->in_sources[pos[dag->out_targets[e]]++] = c;
+        }
+    }
+    free(member_offsets);
+    free(members);
+    free(pos);
+    free(mark);
+}
+
+static void dag_free(CompDAG* dag) {
+    free(dag->out_offsets);
+    free(dag->out_targets);
+    free(dag->in_offsets);
+    free(dag->in_sources);
+}
+
+typedef struct {
+    int* ranks;
+    int count;
+    int capacity;
+} RankList;
+
+static void rank_push(RankList* list, int rank) {
+    if (list->count >= list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->ranks = (int*)realloc(list->ranks, sizeof(int) * list->capacity);
+    }
+    list->ranks[list->count++] = rank;
+}
+
+typedef struct {
+    long long key;
+    int comp;
+} RankOrder;
+
+static int compare_rank_order(const void* a, const void* b) {
+    const RankOrder* x = (const RankOrder*)a;
+    const RankOrder* y = (const RankOrder*)b;
+    if (x->key != y->key) return x->key > y->key ? -1 : 1;
+    return (x->comp > y->comp) - (x->comp < y->comp);
+}
+
+// Pruned landmark labeling: components are processed in descending
+// (in + 1) * (out + 1) degree order; each one runs a forward and a backward
+// BFS that stops wherever the labels added so far already answer the query.
+// Ranks are appended in increasing order, so every list stays sorted.
+static void pll_label(const CompDAG* dag, RankList* out_labels, RankList* in_labels) {
+    int c_count = dag->count;
+    int c_alloc = c_count > 0 ? c_count : 1;
+    RankOrder* order = (RankOrder*)malloc(sizeof(RankOrder) * c_alloc);
+    for (int c = 0; c < c_count; c++) {
+        long long out_deg = dag->out_offsets[c + 1] - dag->out_offsets[c];
+        long long in_deg = dag->in_offsets[c + 1] - dag->in_offsets[c];
+        order[c].key = (out_deg + 1) * (in_deg + 1);
+        order[c].comp = c;
+    }
+    qsort(order, c_count, sizeof(RankOrder), compare_rank_order);
+
+    int* queue = (int*)malloc(sizeof(int) * c_alloc);
+    long long* seen = (long long*)malloc(sizeof(long long) * c_alloc);
+    for (int c = 0; c < c_count; c++) seen[c] = -1;
+
+    for (int r = 0; r < c_count; r++) {
+        int v = order[r].comp;
+        // Forward: v's landmark rank goes into in-labels of what it reaches
+        int head = 0, tail = 0;
+        queue[tail++] = v;
+        seen[v] = 2LL * r;
+        while (head < tail) {
+            int u = queue[head++];
+            if (u != v && ranks_intersect(out_labels[v].ranks, out_labels[v].count, in_labels[u].ranks, in_labels[u].count)) continue;
+            rank_push(&in_labels[u], r);
+            for (long long e = dag->out_offsets[u]; e < dag->out_offsets[u + 1]; e++) {
+                int w = dag->out_targets[e];
+                if (seen[w] == 2LL * r) continue;
+                seen[w] = 2LL * r;
+                queue[tail++] = w;
+            }
+        }
+        // Backward: ... and into out-labels of what reaches it
+        head = tail = 0;
+        queue[tail++] = v;
+        seen[v] = 2LL * r + 1;
+        while (head < tail) {
+            int u = queue[head++];
+            if (u != v && ranks_intersect(out_labels[u].ranks, out_labels[u].count, in_labels[v].ranks, in_labels[v].count)) continue;
+            rank_push(&out_labels[u], r);
+            for (long long e = dag->in_offsets[u]; e < dag->in_offsets[u + 1]; e++) {
+                int w = dag->in_sources[e];
+                if (seen[w] == 2LL * r + 1) continue;
+                seen[w] = 2LL * r + 1;
+                queue[tail++] = w;
+            }
+        }
+    }
+    free(order);
+    free(queue);
+    free(seen);
+}
+
+// Marks the spec current unless an edge write started or finished since
+// `generation` was read
+static int mark_current(GraphDB* gdb, const char* spec, unsigned long long generation) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    int current = gdb->edge_generation == generation && gdb->edges_in_flight == 0;
+    if (current) {
+        size_t key_len = 1 + strlen(spec);
+        char* key = (char*)malloc(key_len + 1);
+        sprintf(key, "R%s", spec);
+        char* err = NULL;
+        rocksdb_put(gdb->db, gdb->writeoptions, key, key_len, "", 0, &err);
+        if (err) {
+            fprintf(stderr, "Error marking reachability index: %s\n", err);
+            free(err);
+            current = 0;
+        }
+        free(key);
+    }
+    if (current) {
+        gdb->reach_types = (char**)realloc(gdb->reach_types, sizeof(char*) * (gdb->reach_type_count + 1));
+        gdb->reach_types[gdb->reach_type_count++] = strdup(spec);
+    }
+    pthread_mutex_unlock(&gdb->reach_mutex);
+    return current;
+}
+
+static int build_index(GraphDB* gdb, const char* spec, int threads) {
+    // Labels are rewritten in place, so stop answering from them first
+    graphdb_reach_unmark(gdb, spec);
+    pthread_mutex_lock(&gdb->reach_mutex);
+    unsigned long long generation = gdb->edge_generation;
+    pthread_mutex_unlock(&gdb->reach_mutex);
+
+    GraphCSR* csr = graphdb_csr_build(gdb, spec, threads);
+    if (!csr) return 0;
+    int n = csr->node_count;
+    int* comp = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int comp_count = scc_condense(csr, comp);
+    CompDAG dag;
+    dag_build(csr, comp, comp_count, &dag);
+    RankList* out_labels = (RankList*)calloc(comp_count > 0 ? comp_count : 1, sizeof(RankList));
+    RankList* in_labels = (RankList*)calloc(comp_count > 0 ? comp_count : 1, sizeof(RankList));
+    pll_label(&dag, out_labels, in_labels);
+
+    delete_labels(gdb, spec);
+    rocksdb_writebatch_t* batch = rocksdb_writebatch_create();
+    size_t spec_len = strlen(spec);
+    char* key = NULL;
+    size_t key_cap = 0;
+    char* value = NULL;
+    size_t value_cap = 0;
+    for (int v = 0; v < n; v++) {
+        // Isolated nodes only reach themselves; a missing label says so
+        if (csr->out_offsets[v + 1] == csr->out_offsets[v] && csr->in_offsets[v + 1] == csr->in_offsets[v]) continue;
+        size_t id_len = strlen(csr->ids[v]);
+        size_t key_len = 1 + spec_len + 1 + id_len;
+        if (key_len > key_cap) {
+            key_cap = key_len * 2;
+            key = (char*)realloc(key, key_cap);
+        }
+        key[0] = 'R';
+        memcpy(key + 1, spec, spec_len);
+        key[1 + spec_len] = ':';
+        memcpy(key + 2 + spec_len, csr->ids[v], id_len);
+        const RankList* lo = &out_labels[comp[v]];
+        const RankList* li = &in_labels[comp[v]];
+        size_t value_len = sizeof(int) * (2 + lo->count + li->count);
+        if (value_len > value_cap) {
+            value_cap = value_len * 2;
+            value = (char*)realloc(value, value_cap);
+        }
+        memcpy(value, &lo->count, sizeof(int));
+        memcpy(value + sizeof(int), &li->count, sizeof(int));
+        memcpy(value + 2 * sizeof(int), lo->ranks, sizeof(int) * lo->count);
+        memcpy(value + (2 + lo->count) * sizeof(int), li->ranks, sizeof(int) * li->count);
+        rocksdb_writebatch_put(batch, key, key_len, value, value_len);
+        if (rocksdb_writebatch_count(batch) >= REACH_WRITE_BATCH) batch_flush(gdb, batch);
+    }
+    if (rocksdb_writebatch_count(batch) > 0) batch_flush(gdb, batch);
+    rocksdb_writebatch_destroy(batch);
+    free(key);
+    free(value);
+
+    for (int c = 0; c < comp_count; c++) {
+        free(out_labels[c].ranks);
+        free(in_labels[c].ranks);
+    }
+    free(out_labels);
+    free(in_labels);
+    dag_free(&dag);
+    free(comp);
+    graphdb_csr_free(csr);
+    return mark_current(gdb, spec, generation);
+}
+
+/*******************************
+ * Background rebuilds
+ *******************************/
+
+static void reach_shutdown(GraphDB* gdb) {
+    ReachState* st = (ReachState*)gdb->reach_state;
+    ReachBuilder* b = st->builders;
+    while (b) {
+        ReachBuilder* next = b->next;
+        if (b->joinable) pthread_join(b->thread, NULL);
+        free(b->spec);
+        free(b);
+        b = next;
+    }
+    pthread_mutex_destroy(&st->mutex);
+    pthread_cond_destroy(&st->idle);
+    free(st);
+    gdb->reach_state = NULL;
+}
+
+static ReachState* reach_state(GraphDB* gdb) {
+    pthread_mutex_lock(&gdb->reach_mutex);
+    if (!gdb->reach_state) {
+        ReachState* st = (ReachState*)calloc(1, sizeof(ReachState));
+        pthread_mutex_init(&st->mutex, NULL);
+        pthread_cond_init(&st->idle, NULL);
+        gdb->reach_state = st;
+        gdb->reach_keep = keep_if_connected;
+        gdb->reach_shutdown = reach_shutdown;
+    }
+    pthread_mutex_unlock(&gdb->reach_mutex);
+    return (ReachState*)gdb->reach_state;
+}
+
+// Caller holds st->mutex
+static ReachBuilder* builder_for(ReachState* st, GraphDB* gdb, const char* spec, int create) {
+    for (ReachBuilder* b = st->builders; b; b = b->next) {
+        if (strcmp(b->spec, spec) == 0) return b;
+    }
+    if (!create) return NULL;
+    ReachBuilder* b = (ReachBuilder*)calloc(1, sizeof(ReachBuilder));
+    b->spec = strdup(spec);
+    b->gdb = gdb;
+    b->next = st->builders;
+    st->builders = b;
+    return b;
+}
+
+static void* builder_main(void* arg) {
+    ReachBuilder* b = (ReachBuilder*)arg;
+    build_index(b->gdb, b->spec, 0);
+    ReachState* st = (ReachState*)b->gdb->reach_state;
+    pthread_mutex_lock(&st->mutex);
+    b->running = 0;
+    pthread_cond_broadcast(&st->idle);
+    pthread_mutex_unlock(&st->mutex);
+    return NULL;
+}
+
+static void schedule_rebuild(GraphDB* gdb, ReachState* st, const char* spec) {
+    pthread_mutex_lock(&st->mutex);
+    ReachBuilder* b = builder_for(st, gdb, spec, 1);
+    b->indexed = 1;
+    if (!b->running) {
+        if (b->joinable) pthread_join(b->thread, NULL);
+        b->running = 1;
+        b->joinable = 1;
+        pthread_create(&b->thread, NULL, builder_main, b);
+    }
+    pthread_mutex_unlock(&st->mutex);
+}
+
+// Claims the spec's builder slot for a synchronous build or drop
+static ReachBuilder* claim_builder(GraphDB* gdb, ReachState* st, const char* spec) {
+    pthread_mutex_lock(&st->mutex);
+    ReachBuilder* b = builder_for(st, gdb, spec, 1);
+    while (b->running) pthread_cond_wait(&st->idle, &st->mutex);
+    b->running = 1;
+    pthread_mutex_unlock(&st->mutex);
+    return b;
+}
+
+static void release_builder(ReachState* st, ReachBuilder* b) {
+    pthread_mutex_lock(&st->mutex);
+    b->running = 0;
+    pthread_cond_broadcast(&st->idle);
+    pthread_mutex_unlock(&st->mutex);
+}
+
+/*******************************
+ * Public API
+ *******************************/
+
+int graphdb_reach_index_build(GraphDB* gdb, const char* type, int threads) {
+    if (!gdb) return 0;
+    const char* spec = type ? type : "";
+    ReachState* st = reach_state(gdb);
+    ReachBuilder* b = claim_builder(gdb, st, spec);
+    b->indexed = 1;
+    int current = build_index(gdb, spec, threads);
+    release_builder(st, b);
+    return current;
+}
+
+void graphdb_reach_index_drop(GraphDB* gdb, const char* type) {
+    if (!gdb) return;
+    const char* spec = type ? type : "";
+    ReachState* st = reach_state(gdb);
+    ReachBuilder* b = claim_builder(gdb, st, spec);
+    b->indexed = 0;
+    graphdb_reach_unmark(gdb, spec);
+    delete_labels(gdb, spec);
+    release_builder(st, b);
+}
+
+int graphdb_reach_index_current(GraphDB* gdb, const char* type) {
+    if (!gdb) return 0;
+    return spec_current(gdb, type ? type : "", NULL);
+}
+
+void graphdb_reach_index_wait(GraphDB* gdb, const char* type) {
+    if (!gdb) return;
+    ReachState* st = reach_state(gdb);
+    pthread_mutex_lock(&st->mutex);
+    ReachBuilder* b = builder_for(st, gdb, type ? type : "", 0);
+    while (b && b->running) pthread_cond_wait(&st->idle, &st->mutex);
+    pthread_mutex_unlock(&st->mutex);
+}
+
+typedef struct {
+    GraphDB* gdb;
+    StrMap* visited;
+    const char* spec;
+    const char* target;
+    size_t target_len;
+    int* queue;
+    int queue_count;
+    int queue_capacity;
+    int found;
+} ReachBFS;
+
+static int node_exists(GraphDB* gdb, const char* id) {
+    char* label = graphdb_get_node_label(gdb, id);
+    free(label);
+    return label != NULL;
+}
+
+static int reach_visit(void* ctx, const char* id, size_t id_len, const char* type, size_t type_len) {
+    ReachBFS* bfs = (ReachBFS*)ctx;
+    if (!graphdb_type_matches(bfs->spec, type, type_len)) return 0;
+    if (id_len == bfs->target_len && memcmp(id, bfs->target, id_len) == 0) {
+        bfs->found = 1;
+        return 1;
+    }
+    int inserted;
+    int idx = strmap_intern(bfs->visited, id, id_len, &inserted);
+    // Ids without a node record are left out, as in the index's snapshot
+    if (inserted && node_exists(bfs->gdb, bfs->visited->entries[idx].key)) {
+        if (bfs->queue_count >= bfs->queue_capacity) {
+            bfs->queue_capacity = bfs->queue_capacity ? bfs->queue_capacity * 2 : 64;
+            bfs->queue = (int*)realloc(bfs->queue, sizeof(int) * bfs->queue_capacity);
+        }
+        bfs->queue[bfs->queue_count++] = idx;
+    }
+    return 0;
+}
+
+static int bfs_reach(GraphDB* gdb, const char* a, const char* b, const char* spec) {
+    if (!node_exists(gdb, a) || !node_exists(gdb, b)) return 0;
+    ReachBFS bfs = {0};
+    bfs.gdb = gdb;
+    bfs.visited = strmap_create(256);
+    bfs.spec = spec;
+    bfs.target = b;
+    bfs.target_len = strlen(b);
+    // One relationship type can be filtered by the key prefix itself
+    const char* scan_type = *spec && !strchr(spec, '|') ? spec : NULL;
+    strmap_intern(bfs.visited, a, strlen(a), NULL);
+    bfs.queue = (int*)malloc(sizeof(int) * 64);
+    bfs.queue_capacity = 64;
+    bfs.queue[bfs.queue_count++] = 0;
+    for (int head = 0; head < bfs.queue_count && !bfs.found; head++) {
+        const char* node = bfs.visited->entries[bfs.queue[head]].key;
+        graphdb_foreach_neighbor(gdb, node, scan_type, GRAPHDB_DIR_OUT, reach_visit, &bfs);
+    }
+    free(bfs.queue);
+    strmap_destroy(bfs.visited);
+    return bfs.found;
+}
+
+int graphdb_reachable(GraphDB* gdb, const char* a, const char* b, const char* type) {
+    if (!gdb || !a || !b) return 0;
+    if (strcmp(a, b) == 0) return node_exists(gdb, a);
+    const char* spec = type ? type : "";
+    ReachState* st = reach_state(gdb);
+    unsigned long long epoch;
+    if (spec_current(gdb, spec, &epoch)) {
+        int reach = labels_reach(gdb, spec, a, b);
+        // A rebuild may have started rewriting the labels while we read them
+        pthread_mutex_lock(&gdb->reach_mutex);
+        int unchanged = gdb->reach_epoch == epoch;
+        pthread_mutex_unlock(&gdb->reach_mutex);
+        if (unchanged) return reach;
+    } else {
+        pthread_mutex_lock(&st->mutex);
+        ReachBuilder* known = builder_for(st, gdb, spec, 0);
+        int indexed = known && known->indexed;
+        pthread_mutex_unlock(&st->mutex);
+        // Labels left behind by an invalidated index mean it was built before
+        if (indexed || (!known && labels_exist(gdb, spec))) schedule_rebuild(gdb, st, spec);
+    }
+    return bfs_reach(gdb, a, b, spec);
+}
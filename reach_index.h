@@ -0,0 +1,32 @@
+#ifndef REACH_INDEX_H
+#define REACH_INDEX_H
+
+#include "graphdb.h"
+
+// Reachability index over the edges of `type`: one relationship type, or
+// several separated by '|' (e.g. "MEMBER_OF|GRANTS"); NULL or "" for all.
+//
+// Strongly connected components are condensed into a DAG, which is labeled
+// with pruned landmark labeling: every node stores the landmarks it reaches
+// (out) and the landmarks reaching it (in), and b is reachable from a iff
+// out(a) and in(b) intersect. Labels are persisted as `R<type>:<node_id>`
+// and marked current by an `R<type>` key. Any edge change of a covered type
+// drops the marker, except additions between already connected nodes.
+
+// Builds (or rebuilds) the index synchronously. Returns 1 if the index is
+// current when done, 0 if edges changed while it was being built.
+int graphdb_reach_index_build(GraphDB* gdb, const char* type, int threads);
+// Removes the index and its labels
+void graphdb_reach_index_drop(GraphDB* gdb, const char* type);
+int graphdb_reach_index_current(GraphDB* gdb, const char* type);
+// Blocks until no background rebuild of `type` is running
+void graphdb_reach_index_wait(GraphDB* gdb, const char* type);
+
+// 1 if `b` is reachable from `a` along outgoing edges of `type` (every node
+// reaches itself). Only nodes that exist take part: an edge to an id without
+// a node record leads nowhere. Answers from the labels when the index is current;
+// otherwise runs a BFS and, if an index was ever built for `type`, starts a
+// background rebuild.
+int graphdb_reachable(GraphDB* gdb, const char* a, const char* b, const char* type);
+
+#endif
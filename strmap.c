@@ -0,0 +1,160 @@
+// strmap.c
+#include "strmap.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRMAP_CHUNK_SIZE 65536
+
+struct StrMapChunk {
+    struct StrMapChunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+static char* chunk_copy(StrMap* map, const char* key, size_t len) {
+    StrMapChunk* chunk = map->chunks;
+    if (!chunk || chunk->used + len + 1 > chunk->size) {
+        size_t size = len + 1 > STRMAP_CHUNK_SIZE ? len + 1 : STRMAP_CHUNK_SIZE;
+        chunk = (StrMapChunk*)malloc(sizeof(StrMapChunk) + size);
+        chunk->next = map->chunks;
+        chunk->used = 0;
+        chunk->size = size;
+        map->chunks = chunk;
+    }
+    char* copy = chunk->data + chunk->used;
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    chunk->used += len + 1;
+    return copy;
+}
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// 64-bit finalizer from MurmurHash3: every input bit reaches the low bits
+// that pick a slot in the masked table
+static uint64_t fmix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Eight bytes per round, MurmurHash3-style, with the length and a finalizer
+// mixed in, so keys that differ only near the end or share long prefixes
+// (node ids, encoded rows) still spread over the table
+size_t strmap_hash(const char* key, size_t len) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t k;
+        memcpy(&k, key + i, 8);
+        h ^= rotl64(k * c1, 31) * c2;
+        h = rotl64(h, 27) * 5 + 0x52dce729;
+    }
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < len; j++) tail |= (uint64_t)(unsigned char)key[i + j] << (8 * j);
+    h ^= rotl64(tail * c1, 31) * c2;
+    return (size_t)fmix64(h ^ len);
+}
+
+static void table_alloc(StrMap* map, size_t size) {
+    map->table = (int*)malloc(sizeof(int) * size);
+    memset(map->table, 0xff, sizeof(int) * size);
+    map->mask = size - 1;
+}
+
+StrMap* strmap_create(int expected) {
+    StrMap* map = (StrMap*)calloc(1, sizeof(StrMap));
+    size_t size = 16;
+    while (size < (size_t)expected * 2) size *= 2;
+    table_alloc(map, size);
+    map->capacity = expected > 8 ? expected : 8;
+    map->entries = (StrMapEntry*)malloc(sizeof(StrMapEntry) * map->capacity);
+    return map;
+}
+
+void strmap_clear(StrMap* map) {
+    memset(map->table, 0xff, sizeof(int) * (map->mask + 1));
+    map->count = 0;
+    // Keep the newest chunk for reuse
+    StrMapChunk* chunk = map->chunks;
+    if (chunk) {
+        StrMapChunk* rest = chunk->next;
+        while (rest) {
+            StrMapChunk* next = rest->next;
+            free(rest);
+            rest = next;
+        }
+        chunk->next = NULL;
+        chunk->used = 0;
+    }
+}
+
+void strmap_destroy(StrMap* map) {
+    if (!map) return;
+    StrMapChunk* chunk = map->chunks;
+    while (chunk) {
+        StrMapChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(map->table);
+    free(map->entries);
+    free(map);
+}
+
+static void grow_table(StrMap* map) {
+    free(map->table);
+    table_alloc(map, (map->mask + 1) * 2);
+    for (int i = 0; i < map->count; i++) {
+        size_t slot = map->entries[i].hash & map->mask;
+        while (map->table[slot] != -1) slot = (slot + 1) & map->mask;
+        map->table[slot] = i;
+    }
+}
+
+int strmap_find(const StrMap* map, const char* key, size_t len) {
+    size_t hash = strmap_hash(key, len);
+    size_t slot = hash & map->mask;
+    while (map->table[slot] != -1) {
+        const StrMapEntry* e = &map->entries[map->table[slot]];
+        if (e->hash == hash && e->len == len && memcmp(e->key, key, len) == 0) return map->table[slot];
+        slot = (slot + 1) & map->mask;
+    }
+    return -1;
+}
+
+int strmap_intern(StrMap* map, const char* key, size_t len, int* inserted) {
+    size_t hash = strmap_hash(key, len);
+    size_t slot = hash & map->mask;
+    while (map->table[slot] != -1) {
+        const StrMapEntry* e = &map->entries[map->table[slot]];
+        if (e->hash == hash && e->len == len && memcmp(e->key, key, len) == 0) {
+            if (inserted) *inserted = 0;
+            return map->table[slot];
+        }
+        slot = (slot + 1) & map->mask;
+    }
+    if (map->count >= map->capacity) {
+        map->capacity *= 2;
+        map->entries = (StrMapEntry*)realloc(map->entries, sizeof(StrMapEntry) * map->capacity);
+    }
+    int idx = map->count++;
+    StrMapEntry* e = &map->entries[idx];
+    e->key = chunk_copy(map, key, len);
+    e->len = len;
+    e->hash = hash;
+    e->value = 0;
+    map->table[slot] = idx;
+    if ((size_t)map->count * 2 > map->mask + 1) grow_table(map);
+    if (inserted) *inserted = 1;
+    return idx;
+}
@@ -0,0 +1,36 @@
+#ifndef STRMAP_H
+#define STRMAP_H
+
+#include <stddef.h>
+
+// Insertion-ordered string -> index map. Keys are copied into chunked storage
+// that never moves, so key pointers stay valid until strmap_destroy. Entry
+// indices are dense (0..count-1) and double as interned ids.
+typedef struct {
+    const char* key; // NUL-terminated copy owned by the map
+    size_t len;
+    size_t hash;
+    long long value; // free for the caller
+} StrMapEntry;
+
+typedef struct StrMapChunk StrMapChunk;
+
+typedef struct {
+    StrMapEntry* entries;
+    int count;
+    int capacity;
+    int* table; // open addressing, -1 = empty
+    size_t mask;
+    StrMapChunk* chunks;
+} StrMap;
+
+StrMap* strmap_create(int expected);
+void strmap_destroy(StrMap* map);
+void strmap_clear(StrMap* map);
+size_t strmap_hash(const char* key, size_t len);
+// Returns the entry index for key, inserting it (value 0) if absent
+int strmap_intern(StrMap* map, const char* key, size_t len, int* inserted);
+// Returns the entry index for key or -1
+int strmap_find(const StrMap* map, const char* key, size_t len);
+
+#endif
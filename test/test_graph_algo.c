@@ -0,0 +1,560 @@
+#include "../graphdb.h"
+#include "../graph_algo.h"
+#include "unity/src/unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define TEST_DB_PATH "./testdb_temp"
+
+GraphDB* gdb;
+
+static void remove_directory(const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    struct dirent* entry;
+    char full_path[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
+        struct stat statbuf;
+        stat(full_path, &statbuf);
+        if (S_ISDIR(statbuf.st_mode)) {
+            remove_directory(full_path);
+        } else {
+            unlink(full_path);
+        }
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+void setUp(void) {
+    gdb = graphdb_open(TEST_DB_PATH);
+    TEST_ASSERT_NOT_NULL(gdb);
+}
+
+void tearDown(void) {
+    graphdb_close(gdb);
+    remove_directory(TEST_DB_PATH);
+}
+
+// Ring of `n` nodes named r0..r(n-1) plus a few chords
+static void add_ring(int n, const char* type) {
+    char from[32], to[32];
+    for (int i = 0; i < n; i++) {
+        sprintf(from, "r%d", i);
+        graphdb_add_node(gdb, from, "Node");
+    }
+    for (int i = 0; i < n; i++) {
+        sprintf(from, "r%d", i);
+        sprintf(to, "r%d", (i + 1) % n);
+        graphdb_add_edge(gdb, from, to, type);
+        if (i % 3 == 0) {
+            sprintf(to, "r%d", (i + 7) % n);
+            graphdb_add_edge(gdb, from, to, type);
+        }
+    }
+}
+
+void test_csr_build(void) {
+    graphdb_add_node(gdb, "a", "Person");
+    graphdb_add_node(gdb, "b", "Person");
+    graphdb_add_node(gdb, "c", "Person");
+    graphdb_add_edge(gdb, "a", "b", "FRIEND");
+    graphdb_add_edge(gdb, "a", "c", "FRIEND");
+    graphdb_add_edge(gdb, "c", "a", "UNCLE");
+    graphdb_add_edge(gdb, "a", "ghost", "FRIEND"); // no node record
+
+    GraphCSR* csr = graphdb_csr_build(gdb, "FRIEND", 2);
+    TEST_ASSERT_NOT_NULL(csr);
+    TEST_ASSERT_EQUAL_INT(3, csr->node_count);
+    TEST_ASSERT_EQUAL_INT(2, csr->edge_count);
+    int a = graphdb_csr_index_of(csr, "a");
+    int b = graphdb_csr_index_of(csr, "b");
+    TEST_ASSERT_EQUAL_STRING("a", csr->ids[a]);
+    TEST_ASSERT_EQUAL_INT(2, csr->out_offsets[a + 1] - csr->out_offsets[a]);
+    TEST_ASSERT_EQUAL_INT(1, csr->in_offsets[b + 1] - csr->in_offsets[b]);
+    TEST_ASSERT_EQUAL_INT(-1, graphdb_csr_index_of(csr, "ghost"));
+    graphdb_csr_free(csr);
+
+    csr = graphdb_csr_build(gdb, NULL, 1);
+    TEST_ASSERT_EQUAL_INT(3, csr->edge_count);
+    graphdb_csr_free(csr);
+}
+
+void test_pagerank_cycle_is_uniform(void) {
+    graphdb_add_node(gdb, "a", "Person");
+    graphdb_add_node(gdb, "b", "Person");
+    graphdb_add_node(gdb, "c", "Person");
+    graphdb_add_edge(gdb, "a", "b", "FRIEND");
+    graphdb_add_edge(gdb, "b", "c", "FRIEND");
+    graphdb_add_edge(gdb, "c", "a", "FRIEND");
+    GraphNodeScores* scores = graphdb_pagerank(gdb, "FRIEND", 30, 0.85, 2);
+    TEST_ASSERT_NOT_NULL(scores);
+    TEST_ASSERT_EQUAL_INT(3, scores->count);
+    for (int i = 0; i < scores->count; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-9, 1.0 / 3.0, scores->values[i]);
+    }
+    graphdb_free_node_scores(scores);
+}
+
+void test_pagerank_star_with_dangling_hub(void) {
+    graphdb_add_node(gdb, "hub", "Person");
+    graphdb_add_node(gdb, "x", "Person");
+    graphdb_add_node(gdb, "y", "Person");
+    graphdb_add_edge(gdb, "x", "hub", "FRIEND");
+    graphdb_add_edge(gdb, "y", "hub", "FRIEND");
+    GraphNodeScores* scores = graphdb_pagerank(gdb, "FRIEND", 100, 0.85, 1);
+    double sum = 0.0;
+    for (int i = 0; i < scores->count; i++) sum += scores->values[i];
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, 1.0, sum);
+    // Stationary solution: leaves get (1-d)/3 + d*hub/3, hub gets the rest
+    double hub = graphdb_node_score(scores, "hub");
+    double leaf = graphdb_node_score(scores, "x");
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, (1 - 0.85) / 3 + 0.85 * hub / 3, leaf);
+    TEST_ASSERT_TRUE(hub > leaf);
+    graphdb_free_node_scores(scores);
+}
+
+void test_pagerank_threads_agree(void) {
+    add_ring(50, "LINK");
+    GraphNodeScores* single = graphdb_pagerank(gdb, "LINK", 20, 0.85, 1);
+    GraphNodeScores* multi = graphdb_pagerank(gdb, "LINK", 20, 0.85, 4);
+    TEST_ASSERT_EQUAL_INT(single->count, multi->count);
+    for (int i = 0; i < single->count; i++) {
+        TEST_ASSERT_EQUAL_STRING(single->ids[i], multi->ids[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-12, single->values[i], multi->values[i]);
+    }
+    graphdb_free_node_scores(single);
+    graphdb_free_node_scores(multi);
+}
+
+void test_pagerank_write_back(void) {
+    graphdb_add_node(gdb, "a", "Person");
+    graphdb_add_node(gdb, "b", "Person");
+    graphdb_add_edge(gdb, "a", "b", "FRIEND");
+    graphdb_add_edge(gdb, "b", "a", "FRIEND");
+    GraphNodeScores* scores = graphdb_pagerank(gdb, "FRIEND", 10, 0.85, 0);
+    graphdb_write_node_scores(gdb, scores, "pagerank");
+    graphdb_free_node_scores(scores);
+    char* value = graphdb_get_node_property(gdb, "a", "pagerank");
+    TEST_ASSERT_NOT_NULL(value);
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, 0.5, atof(value));
+    free(value);
+}
+
+void test_connected_components(void) {
+    // Two chains joined only by a reversed edge, plus an isolated node and a FOLLOWS-only link
+    const char* nodes[] = {"a", "b", "c", "d", "e", "f", "lonely"};
+    for (int i = 0; i < 7; i++) graphdb_add_node(gdb, nodes[i], "Account");
+    graphdb_add_edge(gdb, "a", "b", "PAYS");
+    graphdb_add_edge(gdb, "c", "b", "PAYS");
+    graphdb_add_edge(gdb, "d", "e", "PAYS");
+    graphdb_add_edge(gdb, "e", "f", "PAYS");
+    graphdb_add_edge(gdb, "c", "d", "FOLLOWS");
+
+    GraphComponents* comps = graphdb_connected_components(gdb, "PAYS", 3);
+    TEST_ASSERT_NOT_NULL(comps);
+    TEST_ASSERT_EQUAL_INT(3, comps->component_count);
+    TEST_ASSERT_EQUAL_INT(3, comps->largest_component);
+    TEST_ASSERT_EQUAL_INT(1, comps->singleton_count);
+    TEST_ASSERT_EQUAL_STRING("a", graphdb_component_of(comps, "c"));
+    TEST_ASSERT_EQUAL_STRING("d", graphdb_component_of(comps, "f"));
+    TEST_ASSERT_EQUAL_STRING("lonely", graphdb_component_of(comps, "lonely"));
+    graphdb_free_components(comps);
+
+    comps = graphdb_connected_components(gdb, NULL, 2);
+    TEST_ASSERT_EQUAL_INT(2, comps->component_count);
+    TEST_ASSERT_EQUAL_INT(6, comps->largest_component);
+    TEST_ASSERT_EQUAL_STRING("a", graphdb_component_of(comps, "f"));
+    graphdb_free_components(comps);
+}
+
+void test_connected_components_threads_agree(void) {
+    char from[32], to[32];
+    for (int i = 0; i < 200; i++) {
+        sprintf(from, "n%03d", i);
+        graphdb_add_node(gdb, from, "Node");
+    }
+    // Components are the residues mod 5
+    for (int i = 0; i + 5 < 200; i++) {
+        sprintf(from, "n%03d", i + 5);
+        sprintf(to, "n%03d", i);
+        graphdb_add_edge(gdb, from, to, "LINK");
+    }
+    GraphComponents* single = graphdb_connected_components(gdb, "LINK", 1);
+    GraphComponents* multi = graphdb_connected_components(gdb, "LINK", 8);
+    TEST_ASSERT_EQUAL_INT(5, single->component_count);
+    TEST_ASSERT_EQUAL_INT(5, multi->component_count);
+    TEST_ASSERT_EQUAL_INT(40, multi->largest_component);
+    for (int i = 0; i < single->count; i++) {
+        TEST_ASSERT_EQUAL_INT(single->component[i], multi->component[i]);
+    }
+    graphdb_free_components(single);
+    graphdb_free_components(multi);
+}
+
+void test_triangle_count_clique(void) {
+    const char* nodes[] = {"a", "b", "c", "d", "tail"};
+    for (int i = 0; i < 5; i++) graphdb_add_node(gdb, nodes[i], "Person");
+    // K4 with mixed directions and a reciprocal pair, plus a pendant node
+    graphdb_add_edge(gdb, "a", "b", "FRIEND");
+    graphdb_add_edge(gdb, "b", "a", "FRIEND");
+    graphdb_add_edge(gdb, "c", "a", "FRIEND");
+    graphdb_add_edge(gdb, "a", "d", "FRIEND");
+    graphdb_add_edge(gdb, "b", "c", "FRIEND");
+    graphdb_add_edge(gdb, "d", "b", "FRIEND");
+    graphdb_add_edge(gdb, "c", "d", "FRIEND");
+    graphdb_add_edge(gdb, "d", "tail", "FRIEND");
+    graphdb_add_edge(gdb, "a", "a", "FRIEND");
+
+    GraphTriangles* tris = graphdb_triangle_count(gdb, "FRIEND", 2);
+    TEST_ASSERT_NOT_NULL(tris);
+    TEST_ASSERT_EQUAL_INT(4, tris->total_triangles);
+    int a = graphdb_csr_index_of(tris->graph, "a");
+    int d = graphdb_csr_index_of(tris->graph, "d");
+    int tail = graphdb_csr_index_of(tris->graph, "tail");
+    TEST_ASSERT_EQUAL_INT(3, tris->triangles[a]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-12, 1.0, tris->clustering[a]);
+    TEST_ASSERT_EQUAL_INT(3, tris->triangles[d]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-12, 0.5, tris->clustering[d]);
+    TEST_ASSERT_EQUAL_INT(0, tris->triangles[tail]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-12, 0.0, tris->clustering[tail]);
+    graphdb_free_triangles(tris);
+}
+
+void test_triangle_count_matches_brute_force(void) {
+    enum { N = 60 };
+    static int adj[N][N];
+    memset(adj, 0, sizeof(adj));
+    char from[32], to[32];
+    for (int i = 0; i < N; i++) {
+        sprintf(from, "v%02d", i);
+        graphdb_add_node(gdb, from, "Node");
+    }
+    unsigned int seed = 7;
+    for (int e = 0; e < 700; e++) {
+        seed = seed * 1103515245u + 12345u;
+        int u = (seed >> 8) % N;
+        seed = seed * 1103515245u + 12345u;
+        int v = (seed >> 8) % N;
+        sprintf(from, "v%02d", u);
+        sprintf(to, "v%02d", v);
+        graphdb_add_edge(gdb, from, to, "LINK");
+        if (u != v) adj[u][v] = adj[v][u] = 1;
+    }
+    long long expected_total = 0;
+    long long expected[N];
+    memset(expected, 0, sizeof(expected));
+    for (int i = 0; i < N; i++)
+        for (int j = i + 1; j < N; j++)
+            for (int k = j + 1; k < N; k++)
+                if (adj[i][j] && adj[j][k] && adj[i][k]) {
+                    expected_total++;
+                    expected[i]++;
+                    expected[j]++;
+                    expected[k]++;
+                }
+
+    GraphTriangles* single = graphdb_triangle_count(gdb, "LINK", 1);
+    GraphTriangles* multi = graphdb_triangle_count(gdb, "LINK", 6);
+    TEST_ASSERT_EQUAL_INT(expected_total, single->total_triangles);
+    TEST_ASSERT_EQUAL_INT(expected_total, multi->total_triangles);
+    for (int i = 0; i < N; i++) {
+        sprintf(from, "v%02d", i);
+        int v = graphdb_csr_index_of(multi->graph, from);
+        TEST_ASSERT_EQUAL_INT(expected[i], multi->triangles[v]);
+        TEST_ASSERT_EQUAL_INT(expected[i], single->triangles[v]);
+    }
+    graphdb_free_triangles(single);
+    graphdb_free_triangles(multi);
+}
+
+// Cliques c0..c(k-1) of `size` nodes named q<clique>_<i>, joined in a ring by single edges
+static void add_clique_ring(int cliques, int size) {
+    char from[32], to[32];
+    for (int c = 0; c < cliques; c++) {
+        for (int i = 0; i < size; i++) {
+            sprintf(from, "q%d_%d", c, i);
+            graphdb_add_node(gdb, from, "Node");
+        }
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                sprintf(from, "q%d_%d", c, i);
+                sprintf(to, "q%d_%d", c, j);
+                graphdb_add_edge(gdb, from, to, "KNOWS");
+            }
+        }
+        sprintf(from, "q%d_0", c);
+        sprintf(to, "q%d_1", (c + 1) % cliques);
+        graphdb_add_edge(gdb, from, to, "KNOWS");
+    }
+}
+
+void test_communities_label_propagation(void) {
+    add_clique_ring(2, 6);
+    graphdb_add_node(gdb, "loner", "Node");
+    GraphCommunities* comms = graphdb_communities(gdb, "KNOWS", 20, 0, 1);
+    TEST_ASSERT_NOT_NULL(comms);
+    TEST_ASSERT_EQUAL_INT(3, comms->community_count);
+    TEST_ASSERT_EQUAL_INT(graphdb_community_of(comms, "q0_2"), graphdb_community_of(comms, "q0_5"));
+    TEST_ASSERT_EQUAL_INT(graphdb_community_of(comms, "q1_0"), graphdb_community_of(comms, "q1_4"));
+    TEST_ASSERT_NOT_EQUAL(graphdb_community_of(comms, "q0_2"), graphdb_community_of(comms, "q1_2"));
+    TEST_ASSERT_TRUE(comms->modularity > 0.3);
+
+    GraphCommunities* parallel = graphdb_communities(gdb, "KNOWS", 20, 0, 4);
+    // Asynchronous updates may differ in order, not in the grouping here
+    TEST_ASSERT_EQUAL_INT(3, parallel->community_count);
+    TEST_ASSERT_EQUAL_INT(graphdb_community_of(parallel, "q0_0"), graphdb_community_of(parallel, "q0_5"));
+    TEST_ASSERT_NOT_EQUAL(graphdb_community_of(parallel, "q0_0"), graphdb_community_of(parallel, "q1_0"));
+
+    graphdb_write_communities(gdb, comms, "community");
+    char* stored = graphdb_get_node_property(gdb, "q1_3", "community");
+    char expected[16];
+    sprintf(expected, "%d", graphdb_community_of(comms, "q1_3"));
+    TEST_ASSERT_EQUAL_STRING(expected, stored);
+    free(stored);
+    graphdb_free_communities(parallel);
+    graphdb_free_communities(comms);
+}
+
+void test_communities_louvain_refine(void) {
+    add_clique_ring(6, 4);
+    GraphCommunities* lp = graphdb_communities(gdb, "KNOWS", 20, 0, 2);
+    GraphCommunities* refined = graphdb_communities(gdb, "KNOWS", 20, 1, 2);
+    TEST_ASSERT_NOT_NULL(refined);
+    TEST_ASSERT_TRUE(refined->modularity >= lp->modularity - 1e-9);
+    TEST_ASSERT_EQUAL_INT(6, refined->community_count);
+    for (int c = 0; c < 6; c++) {
+        char a[16], b[16];
+        sprintf(a, "q%d_0", c);
+        sprintf(b, "q%d_3", c);
+        TEST_ASSERT_EQUAL_INT(graphdb_community_of(refined, a), graphdb_community_of(refined, b));
+    }
+    TEST_ASSERT_TRUE(refined->modularity > 0.5);
+    graphdb_free_communities(lp);
+    graphdb_free_communities(refined);
+}
+
+void test_betweenness_exact(void) {
+    // Path a -> b -> c -> d -> e plus a diamond a -> x -> z, a -> y -> z
+    const char* path[] = {"a", "b", "c", "d", "e", "x", "y", "z"};
+    for (int i = 0; i < 8; i++) graphdb_add_node(gdb, path[i], "Node");
+    for (int i = 0; i < 4; i++) graphdb_add_edge(gdb, path[i], path[i + 1], "LINK");
+    graphdb_add_edge(gdb, "a", "x", "LINK");
+    graphdb_add_edge(gdb, "a", "y", "LINK");
+    graphdb_add_edge(gdb, "x", "z", "LINK");
+    graphdb_add_edge(gdb, "y", "z", "LINK");
+
+    GraphNodeScores* bc = graphdb_betweenness(gdb, "LINK", 0, 1);
+    TEST_ASSERT_NOT_NULL(bc);
+    TEST_ASSERT_TRUE(bc->error_bound == 0.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.0, graphdb_node_score(bc, "a"));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 3.0, graphdb_node_score(bc, "b"));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 4.0, graphdb_node_score(bc, "c"));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 3.0, graphdb_node_score(bc, "d"));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5, graphdb_node_score(bc, "x"));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5, graphdb_node_score(bc, "y"));
+
+    GraphNodeScores* parallel = graphdb_betweenness(gdb, "LINK", 0, 4);
+    for (int i = 0; i < bc->count; i++) TEST_ASSERT_DOUBLE_WITHIN(1e-9, bc->values[i], parallel->values[i]);
+    graphdb_free_node_scores(parallel);
+    graphdb_free_node_scores(bc);
+}
+
+// Mean absolute difference from the exact scores
+static double mean_abs_error(const GraphNodeScores* exact, const GraphNodeScores* estimate) {
+    double sum = 0.0;
+    for (int i = 0; i < exact->count; i++) {
+        double d = estimate->values[i] - exact->values[i];
+        sum += d < 0 ? -d : d;
+    }
+    return sum / exact->count;
+}
+
+void test_betweenness_sampled(void) {
+    // The ring with every edge both ways, so the bridges carry most paths
+    add_clique_ring(8, 4);
+    char from[32], to[32];
+    for (int c = 0; c < 8; c++) {
+        for (int i = 0; i < 4; i++) {
+            for (int j = i + 1; j < 4; j++) {
+                sprintf(from, "q%d_%d", c, j);
+                sprintf(to, "q%d_%d", c, i);
+                graphdb_add_edge(gdb, from, to, "KNOWS");
+            }
+        }
+        sprintf(from, "q%d_1", (c + 1) % 8);
+        sprintf(to, "q%d_0", c);
+        graphdb_add_edge(gdb, from, to, "KNOWS");
+    }
+    GraphNodeScores* exact = graphdb_betweenness(gdb, "KNOWS", 0, 2);
+    GraphNodeScores* few = graphdb_betweenness(gdb, "KNOWS", 8, 2);
+    GraphNodeScores* many = graphdb_betweenness(gdb, "KNOWS", 24, 3);
+    TEST_ASSERT_TRUE(few->error_bound > many->error_bound);
+    TEST_ASSERT_TRUE(many->error_bound > 0.0);
+    double mean = 0.0;
+    for (int i = 0; i < exact->count; i++) mean += exact->values[i];
+    mean /= exact->count;
+    TEST_ASSERT_TRUE(mean > 50.0);
+    // 8 of 32 sources land within a third of the mean score, 24 within 5%
+    double few_error = mean_abs_error(exact, few);
+    double many_error = mean_abs_error(exact, many);
+    TEST_ASSERT_TRUE(few_error < mean / 3);
+    TEST_ASSERT_TRUE(many_error < mean / 20);
+    TEST_ASSERT_TRUE(many_error < few_error);
+    // Same samples regardless of thread count
+    GraphNodeScores* again = graphdb_betweenness(gdb, "KNOWS", 8, 1);
+    for (int i = 0; i < few->count; i++) TEST_ASSERT_DOUBLE_WITHIN(1e-9, few->values[i], again->values[i]);
+    graphdb_free_node_scores(again);
+    graphdb_free_node_scores(exact);
+    graphdb_free_node_scores(few);
+    graphdb_free_node_scores(many);
+}
+
+static int csr_has_edge(const GraphCSR* csr, int u, int v) {
+    for (long long e = csr->out_offsets[u]; e < csr->out_offsets[u + 1]; e++) {
+        if (csr->out_targets[e] == v) return 1;
+    }
+    return 0;
+}
+
+void test_random_walks(void) {
+    add_ring(30, "NEXT");
+    graphdb_add_node(gdb, "sink", "Node");
+    graphdb_add_edge(gdb, "r0", "sink", "NEXT");
+    GraphCSR* csr = graphdb_csr_build(gdb, "NEXT", 0);
+    TEST_ASSERT_NOT_NULL(csr);
+
+    int walk_count = 200, walk_length = 12;
+    int* walks = (int*)malloc(sizeof(int) * walk_count * walk_length);
+    int* again = (int*)malloc(sizeof(int) * walk_count * walk_length);
+    TEST_ASSERT_EQUAL_INT(walk_count, graphdb_random_walks(csr, NULL, walk_count, walk_length, 1.0, 1.0, 42, 1, walks));
+    TEST_ASSERT_EQUAL_INT(walk_count, graphdb_random_walks(csr, NULL, walk_count, walk_length, 1.0, 1.0, 42, 4, again));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(walks, again, sizeof(int) * walk_count * walk_length));
+
+    int sink = graphdb_csr_index_of(csr, "sink");
+    for (int i = 0; i < walk_count; i++) {
+        int* row = walks + i * walk_length;
+        TEST_ASSERT_EQUAL_INT(i % csr->node_count, row[0]);
+        for (int s = 1; s < walk_length; s++) {
+            if (row[s - 1] == sink) {
+                TEST_ASSERT_EQUAL_INT(-1, row[s]); // dead end pads the rest
+            } else if (row[s - 1] >= 0) {
+                TEST_ASSERT_TRUE(csr_has_edge(csr, row[s - 1], row[s]));
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(-1, graphdb_random_walks(csr, NULL, 1, 0, 1.0, 1.0, 0, 1, walks));
+    free(walks);
+    free(again);
+    graphdb_csr_free(csr);
+}
+
+void test_random_walks_node2vec_bias(void) {
+    // Undirected path r0 - r1 - ... - r9: a walker can only go back or forward
+    char from[32], to[32];
+    for (int i = 0; i < 10; i++) {
+        sprintf(from, "r%d", i);
+        graphdb_add_node(gdb, from, "Node");
+    }
+    for (int i = 0; i + 1 < 10; i++) {
+        sprintf(from, "r%d", i);
+        sprintf(to, "r%d", i + 1);
+        graphdb_add_edge(gdb, from, to, "LINK");
+        graphdb_add_edge(gdb, to, from, "LINK");
+    }
+    GraphCSR* csr = graphdb_csr_build(gdb, "LINK", 0);
+    int starts[100];
+    for (int i = 0; i < 100; i++) starts[i] = graphdb_csr_index_of(csr, "r5");
+    int walk_length = 20;
+    int* walks = (int*)malloc(sizeof(int) * 100 * walk_length);
+
+    // Small p strongly favors returning to the previous node
+    graphdb_random_walks(csr, starts, 100, walk_length, 0.01, 1.0, 7, 0, walks);
+    int returns = 0, steps = 0;
+    for (int i = 0; i < 100; i++) {
+        int* row = walks + i * walk_length;
+        for (int s = 2; s < walk_length; s++) {
+            steps++;
+            if (row[s] == row[s - 2]) returns++;
+        }
+    }
+    TEST_ASSERT_TRUE(returns > steps * 9 / 10);
+
+    // Small q favors moving outward, so walks rarely backtrack
+    graphdb_random_walks(csr, starts, 100, walk_length, 1.0, 0.01, 7, 0, walks);
+    returns = 0;
+    for (int i = 0; i < 100; i++) {
+        int* row = walks + i * walk_length;
+        for (int s = 2; s < walk_length; s++) {
+            if (row[s] == row[s - 2]) returns++;
+        }
+    }
+    TEST_ASSERT_TRUE(returns < steps / 2);
+    free(walks);
+    graphdb_csr_free(csr);
+}
+
+void test_sample_neighbors(void) {
+    char to[32];
+    graphdb_add_node(gdb, "hub", "Node");
+    graphdb_add_node(gdb, "leaf", "Node");
+    for (int i = 0; i < 200; i++) {
+        sprintf(to, "n%03d", i);
+        graphdb_add_node(gdb, to, "Node");
+        graphdb_add_edge(gdb, "hub", to, "LINK");
+    }
+    graphdb_add_edge(gdb, "leaf", "hub", "LINK");
+    GraphCSR* csr = graphdb_csr_build(gdb, "LINK", 0);
+    int hub = graphdb_csr_index_of(csr, "hub");
+    int leaf = graphdb_csr_index_of(csr, "leaf");
+
+    int fanouts[] = {5, 20}; // Floyd's algorithm, then reservoir
+    for (int f = 0; f < 2; f++) {
+        int fanout = fanouts[f];
+        int nodes[3] = {hub, leaf, hub};
+        int* out = (int*)malloc(sizeof(int) * 3 * fanout);
+        int* again = (int*)malloc(sizeof(int) * 3 * fanout);
+        TEST_ASSERT_EQUAL_INT(3, graphdb_sample_neighbors(csr, nodes, 3, fanout, 99, 1, out));
+        TEST_ASSERT_EQUAL_INT(3, graphdb_sample_neighbors(csr, nodes, 3, fanout, 99, 3, again));
+        TEST_ASSERT_EQUAL_INT(0, memcmp(out, again, sizeof(int) * 3 * fanout));
+        for (int s = 0; s < fanout; s++) {
+            TEST_ASSERT_TRUE(csr_has_edge(csr, hub, out[s]));
+            for (int t = 0; t < s; t++) TEST_ASSERT_NOT_EQUAL(out[t], out[s]);
+        }
+        TEST_ASSERT_EQUAL_INT(hub, out[fanout]);
+        TEST_ASSERT_EQUAL_INT(-1, out[fanout + 1]);
+        // Rows are seeded independently, so the two hub rows differ
+        TEST_ASSERT_NOT_EQUAL(0, memcmp(out, out + 2 * fanout, sizeof(int) * fanout));
+        free(out);
+        free(again);
+    }
+    graphdb_csr_free(csr);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_csr_build);
+    RUN_TEST(test_pagerank_cycle_is_uniform);
+    RUN_TEST(test_pagerank_star_with_dangling_hub);
+    RUN_TEST(test_pagerank_threads_agree);
+    RUN_TEST(test_pagerank_write_back);
+    RUN_TEST(test_connected_components);
+    RUN_TEST(test_connected_components_threads_agree);
+    RUN_TEST(test_triangle_count_clique);
+    RUN_TEST(test_triangle_count_matches_brute_force);
+    RUN_TEST(test_communities_label_propagation);
+    RUN_TEST(test_communities_louvain_refine);
+    RUN_TEST(test_betweenness_exact);
+    RUN_TEST(test_betweenness_sampled);
+    RUN_TEST(test_random_walks);
+    RUN_TEST(test_random_walks_node2vec_bias);
+    RUN_TEST(test_sample_neighbors);
+    return UNITY_END();
+}
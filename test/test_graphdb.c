@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h> // for rmdir, etc.
 #include <rocksdb/c.h>
 #include <dirent.h>
@@ -135,6 +136,130 @@ void test_graphdb_delete_edge(void) {
     if (neighbors) free(neighbors);
 }
 
+void test_graphdb_node_properties(void) {
+    graphdb_add_node(gdb, "node1", "Person");
+    graphdb_add_node(gdb, "node2", "Person");
+    graphdb_set_node_property(gdb, "node1", "score", "0.5");
+    const char* ids[] = {"node1", "node2"};
+    const char* values[] = {"1", "2"};
+    graphdb_set_node_properties(gdb, "community", ids, values, 2);
+    char* value = graphdb_get_node_property(gdb, "node1", "score");
+    TEST_ASSERT_EQUAL_STRING("0.5", value);
+    free(value);
+    value = graphdb_get_node_property(gdb, "node2", "community");
+    TEST_ASSERT_EQUAL_STRING("2", value);
+    free(value);
+    TEST_ASSERT_NULL(graphdb_get_node_property(gdb, "node2", "score"));
+    graphdb_delete_node(gdb, "node1");
+    TEST_ASSERT_NULL(graphdb_get_node_property(gdb, "node1", "score"));
+}
+
+typedef struct {
+    int count;
+    int depths[16];
+    char ids[16][16];
+    int stop_after;
+} KHopCollect;
+
+static int collect_khop(void* ctx, const char* node_id, int depth) {
+    KHopCollect* c = (KHopCollect*)ctx;
+    snprintf(c->ids[c->count], sizeof(c->ids[0]), "%s", node_id);
+    c->depths[c->count++] = depth;
+    return c->stop_after > 0 && c->count >= c->stop_after;
+}
+
+void test_graphdb_khop(void) {
+    // Diamond a->{b,c}->d->e, plus a back edge and a differently typed edge
+    const char* nodes[] = {"a", "b", "c", "d", "e", "x"};
+    for (int i = 0; i < 6; i++) graphdb_add_node(gdb, nodes[i], "Person");
+    graphdb_add_edge(gdb, "a", "b", "FRIEND");
+    graphdb_add_edge(gdb, "a", "c", "FRIEND");
+    graphdb_add_edge(gdb, "b", "d", "FRIEND");
+    graphdb_add_edge(gdb, "c", "d", "FRIEND");
+    graphdb_add_edge(gdb, "d", "e", "FRIEND");
+    graphdb_add_edge(gdb, "d", "a", "FRIEND");
+    graphdb_add_edge(gdb, "a", "x", "WORKS_WITH");
+
+    KHopCollect c = {0};
+    TEST_ASSERT_EQUAL_INT(3, graphdb_khop(gdb, "a", "FRIEND", 2, GRAPHDB_DIR_OUT, collect_khop, &c));
+    TEST_ASSERT_EQUAL_INT(3, c.count);
+    TEST_ASSERT_EQUAL_STRING("b", c.ids[0]);
+    TEST_ASSERT_EQUAL_INT(1, c.depths[0]);
+    TEST_ASSERT_EQUAL_STRING("c", c.ids[1]);
+    TEST_ASSERT_EQUAL_STRING("d", c.ids[2]); // reached twice, reported once
+    TEST_ASSERT_EQUAL_INT(2, c.depths[2]);
+
+    // Count only; the cycle back to a does not count the start node
+    TEST_ASSERT_EQUAL_INT(4, graphdb_khop(gdb, "a", "FRIEND", 10, GRAPHDB_DIR_OUT, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(5, graphdb_khop(gdb, "a", NULL, 3, GRAPHDB_DIR_OUT, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(2, graphdb_khop(gdb, "d", "FRIEND", 1, GRAPHDB_DIR_IN, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(4, graphdb_khop(gdb, "d", "FRIEND", 1, GRAPHDB_DIR_BOTH, NULL, NULL));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_khop(gdb, "a", "FRIEND", 0, GRAPHDB_DIR_OUT, NULL, NULL));
+
+    // Early stop from the callback
+    KHopCollect first = {0};
+    first.stop_after = 1;
+    TEST_ASSERT_EQUAL_INT(1, graphdb_khop(gdb, "a", "FRIEND", 3, GRAPHDB_DIR_OUT, collect_khop, &first));
+    TEST_ASSERT_EQUAL_INT(1, first.count);
+}
+
+void test_graphdb_top_k_similar(void) {
+    const char* nodes[] = {"a", "b", "c", "d", "e", "x", "y", "z", "lonely"};
+    for (int i = 0; i < 9; i++) graphdb_add_node(gdb, nodes[i], "Person");
+    graphdb_add_edge(gdb, "a", "b", "FRIEND");
+    graphdb_add_edge(gdb, "a", "c", "FRIEND");
+    graphdb_add_edge(gdb, "a", "d", "FRIEND");
+    graphdb_add_edge(gdb, "b", "x", "FRIEND");
+    graphdb_add_edge(gdb, "b", "y", "FRIEND");
+    graphdb_add_edge(gdb, "b", "a", "FRIEND"); // back to the query node
+    graphdb_add_edge(gdb, "b", "c", "FRIEND"); // already a friend
+    graphdb_add_edge(gdb, "c", "x", "FRIEND");
+    graphdb_add_edge(gdb, "c", "y", "FRIEND");
+    graphdb_add_edge(gdb, "d", "x", "FRIEND");
+    graphdb_add_edge(gdb, "d", "z", "FRIEND");
+    graphdb_add_edge(gdb, "e", "y", "FRIEND");
+    graphdb_add_edge(gdb, "e", "z", "FRIEND");
+    graphdb_add_edge(gdb, "b", "x", "WORKS_WITH");
+
+    int count;
+    ScoredNode* top = graphdb_top_k_common_neighbors(gdb, "a", "FRIEND", 2, &count);
+    TEST_ASSERT_EQUAL_INT(2, count);
+    TEST_ASSERT_EQUAL_STRING("x", top[0].id);
+    TEST_ASSERT_EQUAL_INT(3, top[0].common);
+    TEST_ASSERT_EQUAL_STRING("y", top[1].id);
+    TEST_ASSERT_EQUAL_INT(2, top[1].common);
+    graphdb_free_scored_nodes(top, count);
+
+    // Parallel edges of another type do not count twice
+    top = graphdb_top_k_common_neighbors(gdb, "a", NULL, 10, &count);
+    TEST_ASSERT_EQUAL_INT(3, count);
+    TEST_ASSERT_EQUAL_INT(3, top[0].common);
+    TEST_ASSERT_EQUAL_STRING("z", top[2].id);
+    graphdb_free_scored_nodes(top, count);
+
+    top = graphdb_top_k_jaccard(gdb, "a", "FRIEND", 3, &count);
+    TEST_ASSERT_EQUAL_INT(3, count);
+    TEST_ASSERT_EQUAL_STRING("x", top[0].id);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0, top[0].score);
+    TEST_ASSERT_EQUAL_STRING("y", top[1].id);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.5, top[1].score);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 0.25, top[2].score);
+    graphdb_free_scored_nodes(top, count);
+
+    // b and c have 4 distinct neighbors, d has 3
+    top = graphdb_top_k_adamic_adar(gdb, "a", "FRIEND", 3, &count);
+    TEST_ASSERT_EQUAL_INT(3, count);
+    TEST_ASSERT_EQUAL_STRING("x", top[0].id);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.0 / log(4.0) + 1.0 / log(3.0), top[0].score);
+    TEST_ASSERT_EQUAL_STRING("y", top[1].id);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 2.0 / log(4.0), top[1].score);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1.0 / log(3.0), top[2].score);
+    graphdb_free_scored_nodes(top, count);
+
+    TEST_ASSERT_NULL(graphdb_top_k_common_neighbors(gdb, "lonely", "FRIEND", 5, &count));
+    TEST_ASSERT_EQUAL_INT(0, count);
+}
+
 void test_find_shortest_path(void) {
     graphdb_add_node(gdb, "node1", "Person");
     graphdb_add_node(gdb, "node2", "Person");
@@ -157,6 +282,9 @@ int main(void) {
     RUN_TEST(test_graphdb_get_all_nodes);
     RUN_TEST(test_graphdb_delete_node);
     RUN_TEST(test_graphdb_delete_edge);
+    RUN_TEST(test_graphdb_node_properties);
+    RUN_TEST(test_graphdb_khop);
+    RUN_TEST(test_graphdb_top_k_similar);
     RUN_TEST(test_find_shortest_path);
     return UNITY_END();
 } 
\ No newline at end of file
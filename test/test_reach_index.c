@@ -0,0 +1,234 @@
+#include "../graphdb.h"
+#include "../reach_index.h"
+#include "unity/src/unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define TEST_DB_PATH "./testdb_temp"
+
+GraphDB* gdb;
+
+static void remove_directory(const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir) return;
+    struct dirent* entry;
+    char full_path[1024];
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
+        struct stat statbuf;
+        stat(full_path, &statbuf);
+        if (S_ISDIR(statbuf.st_mode)) {
+            remove_directory(full_path);
+        } else {
+            unlink(full_path);
+        }
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+void setUp(void) {
+    gdb = graphdb_open(TEST_DB_PATH);
+    TEST_ASSERT_NOT_NULL(gdb);
+}
+
+void tearDown(void) {
+    graphdb_close(gdb);
+    remove_directory(TEST_DB_PATH);
+}
+
+#define GRAPH_NODES 40
+
+// Reference answer from a plain BFS over graphdb_get_outgoing
+static int expected_reach(int a, int b, const char* type) {
+    int seen[GRAPH_NODES] = {0};
+    int queue[GRAPH_NODES];
+    int head = 0, tail = 0;
+    queue[tail++] = a;
+    seen[a] = 1;
+    while (head < tail) {
+        int u = queue[head++];
+        if (u == b) return 1;
+        char id[16];
+        sprintf(id, "v%02d", u);
+        int count;
+        Neighbor* neighbors = graphdb_get_outgoing(gdb, id, type, &count);
+        for (int i = 0; i < count; i++) {
+            int w = atoi(neighbors[i].id + 1);
+            if (!seen[w]) {
+                seen[w] = 1;
+                queue[tail++] = w;
+            }
+            free(neighbors[i].id);
+            free(neighbors[i].type);
+        }
+        free(neighbors);
+    }
+    return 0;
+}
+
+static void add_random_graph(void) {
+    char from[16], to[16];
+    for (int i = 0; i < GRAPH_NODES; i++) {
+        sprintf(from, "v%02d", i);
+        graphdb_add_node(gdb, from, "Node");
+    }
+    srand(7);
+    for (int e = 0; e < 55; e++) {
+        sprintf(from, "v%02d", rand() % GRAPH_NODES);
+        sprintf(to, "v%02d", rand() % GRAPH_NODES);
+        graphdb_add_edge(gdb, from, to, e % 5 == 4 ? "OTHER" : "LINK");
+    }
+}
+
+static void assert_matches_bfs(const char* type) {
+    char a[16], b[16];
+    for (int i = 0; i < GRAPH_NODES; i++) {
+        for (int j = 0; j < GRAPH_NODES; j++) {
+            sprintf(a, "v%02d", i);
+            sprintf(b, "v%02d", j);
+            TEST_ASSERT_EQUAL_INT(expected_reach(i, j, type), graphdb_reachable(gdb, a, b, type));
+        }
+    }
+}
+
+void test_reach_index_matches_bfs(void) {
+    add_random_graph();
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    assert_matches_bfs("LINK"); // no index yet: BFS answers
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_build(gdb, "LINK", 2));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+    assert_matches_bfs("LINK");
+    // Unrelated edge types leave the index alone
+    graphdb_add_edge(gdb, "v00", "v01", "OTHER");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+}
+
+void test_reach_index_invalidation_and_rebuild(void) {
+    graphdb_add_node(gdb, "a", "Node");
+    graphdb_add_node(gdb, "b", "Node");
+    graphdb_add_node(gdb, "c", "Node");
+    graphdb_add_edge(gdb, "a", "b", "LINK");
+    graphdb_add_edge(gdb, "b", "c", "LINK");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_build(gdb, "LINK", 1));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "a", "c", "LINK"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "c", "a", "LINK"));
+
+    // a already reaches c, so the shortcut keeps the index current
+    graphdb_add_edge(gdb, "a", "c", "LINK");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+
+    // Closing the cycle changes reachability
+    graphdb_add_edge(gdb, "c", "a", "LINK");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "c", "b", "LINK")); // BFS, schedules a rebuild
+    graphdb_reach_index_wait(gdb, "LINK");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "c", "b", "LINK"));
+
+    graphdb_delete_edge(gdb, "c", "a", "LINK");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "c", "b", "LINK"));
+    graphdb_reach_index_wait(gdb, "LINK");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "c", "b", "LINK"));
+
+    graphdb_delete_node(gdb, "b");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "a", "c", "LINK"));
+    graphdb_reach_index_wait(gdb, "LINK");
+}
+
+void test_reach_index_persisted(void) {
+    add_random_graph();
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_build(gdb, "LINK", 0));
+    graphdb_close(gdb);
+    gdb = graphdb_open(TEST_DB_PATH);
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+    assert_matches_bfs("LINK");
+
+    // Edge writes drop the marker even before the index module is used again
+    graphdb_close(gdb);
+    gdb = graphdb_open(TEST_DB_PATH);
+    graphdb_add_edge(gdb, "v00", "v39", "LINK");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    graphdb_close(gdb);
+    gdb = graphdb_open(TEST_DB_PATH);
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "v00", "v39", "LINK"));
+    graphdb_reach_index_wait(gdb, "LINK");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+    assert_matches_bfs("LINK");
+}
+
+void test_reach_index_multiple_types(void) {
+    graphdb_add_node(gdb, "alice", "User");
+    graphdb_add_node(gdb, "eng", "Group");
+    graphdb_add_node(gdb, "repo", "Resource");
+    graphdb_add_node(gdb, "wiki", "Resource");
+    graphdb_add_edge(gdb, "alice", "eng", "MEMBER_OF");
+    graphdb_add_edge(gdb, "eng", "repo", "GRANTS");
+    graphdb_add_edge(gdb, "alice", "wiki", "LIKES");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_build(gdb, "MEMBER_OF|GRANTS", 0));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "alice", "repo", "MEMBER_OF|GRANTS"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "alice", "wiki", "MEMBER_OF|GRANTS"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "alice", "repo", "MEMBER_OF"));
+
+    graphdb_add_edge(gdb, "eng", "wiki", "GRANTS");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "MEMBER_OF|GRANTS"));
+    graphdb_reach_index_drop(gdb, "MEMBER_OF|GRANTS");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "alice", "wiki", "MEMBER_OF|GRANTS"));
+    graphdb_reach_index_wait(gdb, "MEMBER_OF|GRANTS");
+    // Dropped indexes are not rebuilt behind the caller's back
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "MEMBER_OF|GRANTS"));
+}
+
+void test_reach_index_dangling_edges(void) {
+    graphdb_add_node(gdb, "a", "Node");
+    graphdb_add_node(gdb, "c", "Node");
+    graphdb_add_edge(gdb, "a", "zz", "LINK"); // no node zz
+    graphdb_add_edge(gdb, "zz", "c", "LINK");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "a", "zz", "LINK"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "a", "c", "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "a", "a", "LINK"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "zz", "zz", "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_build(gdb, "LINK", 1));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "a", "zz", "LINK"));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "a", "c", "LINK"));
+}
+
+void test_reach_index_node_created_late(void) {
+    graphdb_add_node(gdb, "a", "Node");
+    graphdb_add_node(gdb, "c", "Node");
+    graphdb_add_edge(gdb, "a", "zz", "LINK");
+    graphdb_add_edge(gdb, "zz", "c", "LINK");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_build(gdb, "LINK", 1));
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reachable(gdb, "a", "c", "LINK"));
+
+    // The node record brings zz's edges into play
+    graphdb_add_node(gdb, "zz", "Node");
+    TEST_ASSERT_EQUAL_INT(0, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "a", "c", "LINK"));
+    graphdb_reach_index_wait(gdb, "LINK");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reachable(gdb, "a", "c", "LINK"));
+
+    // Relabeling an existing node changes nothing
+    graphdb_add_node(gdb, "zz", "Other");
+    TEST_ASSERT_EQUAL_INT(1, graphdb_reach_index_current(gdb, "LINK"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reach_index_matches_bfs);
+    RUN_TEST(test_reach_index_invalidation_and_rebuild);
+    RUN_TEST(test_reach_index_persisted);
+    RUN_TEST(test_reach_index_multiple_types);
+    RUN_TEST(test_reach_index_dangling_edges);
+    RUN_TEST(test_reach_index_node_created_late);
+    return UNITY_END();
+}